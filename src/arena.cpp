@@ -0,0 +1,123 @@
+/**
+ * DNS Arena
+ *
+ * Copyright (c) 2014 Michal Nezerka
+ * All rights reserved.
+ *
+ * Developed by: Michal Nezerka
+ *               https://github.com/mnezerka/
+ *               mailto:michal.nezerka@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal with the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimers.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimers in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Michal Nezerka, nor the names of its contributors
+ *    may be used to endorse or promote products derived from this Software
+ *    without specific prior written permission. 
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ */
+
+#include <new>
+#include <cstdlib>
+
+#include "arena.h"
+
+using namespace dns;
+using namespace std;
+
+/////////// Arena ///////////
+
+Arena::~Arena()
+{
+    while (mFirst)
+    {
+        Block* next = mFirst->next;
+        free(mFirst);
+        mFirst = next;
+    }
+}
+
+void* Arena::allocate(const size_t size)
+{
+    size_t alignedSize = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+
+    // look for block with enough space, blocks used before reset are reused
+    while (mCurrent == NULL || mPos + alignedSize > mCurrent->size)
+    {
+        Block* next = mCurrent ? mCurrent->next : mFirst;
+        if (next == NULL || alignedSize > next->size)
+        {
+            // allocate new block (insert it after current one)
+            size_t blockSize = alignedSize > mBlockSize ? alignedSize : mBlockSize;
+            Block* block = static_cast<Block*>(malloc(BLOCK_HDR + blockSize));
+            if (block == NULL)
+                throw std::bad_alloc();
+            block->size = blockSize;
+            block->next = next;
+            if (mCurrent)
+                mCurrent->next = block;
+            else
+                mFirst = block;
+            next = block;
+            mBlockCount++;
+        }
+        mCurrent = next;
+        mPos = 0;
+    }
+
+    void* result = reinterpret_cast<char*>(mCurrent) + BLOCK_HDR + mPos;
+    mPos += alignedSize;
+    mAllocationCount++;
+
+    return result;
+}
+
+/////////// ArenaObject ///////////
+
+void* ArenaObject::operator new(size_t size)
+{
+    return operator new(size, static_cast<Arena*>(NULL));
+}
+
+void* ArenaObject::operator new(size_t size, Arena* arena)
+{
+    char* ptr = static_cast<char*>(arena ? arena->allocate(OBJ_HDR + size) : ::operator new(OBJ_HDR + size));
+    // remember where object lives
+    *reinterpret_cast<Arena**>(ptr) = arena;
+
+    return ptr + OBJ_HDR;
+}
+
+void ArenaObject::operator delete(void* ptr)
+{
+    if (ptr == NULL)
+        return;
+
+    char* hdr = static_cast<char*>(ptr) - OBJ_HDR;
+    // memory of arena objects is released by reset of arena
+    if (*reinterpret_cast<Arena**>(hdr) == NULL)
+        ::operator delete(hdr);
+}
+
+void ArenaObject::operator delete(void* ptr, Arena*)
+{
+    operator delete(ptr);
+}
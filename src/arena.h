@@ -0,0 +1,125 @@
+/**
+ * DNS Arena
+ *
+ * Copyright (c) 2014 Michal Nezerka
+ * All rights reserved.
+ *
+ * Developed by: Michal Nezerka
+ *               https://github.com/mnezerka/
+ *               mailto:michal.nezerka@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal with the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimers.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimers in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Michal Nezerka, nor the names of its contributors
+ *    may be used to endorse or promote products derived from this Software
+ *    without specific prior written permission. 
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ */
+
+#ifndef _DNS_ARENA_H
+#define	_DNS_ARENA_H
+
+#include <cstddef>
+
+#include "dns.h"
+
+namespace dns {
+
+/**
+ * Bump allocator for objects of decoded messages
+ *
+ * Memory is carved from large blocks which are never returned to the system
+ * until arena is destroyed. All allocations are released at once by reset()
+ * which only rewinds to the first block, so blocks are reused by the next
+ * message and no memory is allocated in steady state.
+ */
+class Arena
+{
+    public:
+        // alignment of all allocations
+        static const uint ALIGNMENT = 16;
+
+        Arena(const uint blockSize = 16384) : mBlockSize(blockSize), mFirst(NULL), mCurrent(NULL), mPos(0), mBlockCount(0), mAllocationCount(0) { }
+        ~Arena();
+
+        // allocate size bytes (aligned to ALIGNMENT)
+        void* allocate(const size_t size);
+
+        // release all allocations (memory blocks are kept for next use)
+        void reset() { mCurrent = mFirst; mPos = 0; }
+
+        // number of memory blocks allocated from system
+        uint getBlockCount() const { return mBlockCount; }
+
+        // number of allocations served by arena
+        ulong getAllocationCount() const { return mAllocationCount; }
+
+    private:
+        struct Block
+        {
+            Block* next;
+            size_t size;
+        };
+
+        // size of block header (keeps data aligned)
+        static const size_t BLOCK_HDR = (sizeof(Block) + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+
+        // default size of memory block
+        const uint mBlockSize;
+        // list of blocks
+        Block* mFirst;
+        // block used for allocations
+        Block* mCurrent;
+        // first free byte in current block
+        size_t mPos;
+        // statistics
+        uint mBlockCount;
+        ulong mAllocationCount;
+
+        // disable copying
+        Arena(const Arena&);
+        Arena& operator=(const Arena&);
+};
+
+/**
+ * Base class for objects which could be allocated from arena
+ *
+ * Objects are created by new (&arena) Class() or by plain new (heap). Every
+ * object is prefixed by a small header identifying its arena, so delete works
+ * for both kinds. Delete of arena object only calls destructor, the memory
+ * is released by reset of arena.
+ */
+class ArenaObject
+{
+    public:
+        static void* operator new(size_t size);
+        static void* operator new(size_t size, Arena* arena);
+        static void operator delete(void* ptr);
+        static void operator delete(void* ptr, Arena* arena);
+
+    private:
+        // size of header which precedes every object
+        static const size_t OBJ_HDR = Arena::ALIGNMENT;
+};
+
+} // namespace
+#endif	/* _DNS_ARENA_H */
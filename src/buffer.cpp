@@ -127,7 +127,6 @@
 #include <iostream>
 #include <string>
 #include <iomanip>
-#include <algorithm>
 #include <string.h>
 
 #include "buffer.h"
@@ -136,10 +135,159 @@
 using namespace dns;
 using namespace std;
 
+/////////// CompressionDict ///////////
+
+void CompressionDict::clear()
+{
+    memset(mBuckets, 0xFF, sizeof(mBuckets));
+    mMoreEntries.clear();
+    mLargeBuckets.clear();
+    mCount = 0;
+    mReady = true;
+}
+
+uint CompressionDict::hash(const uint parent, const char* label)
+{
+    // FNV-1a over parent entry, label length and lower cased label characters
+    uint h = 2166136261u;
+    h = (h ^ (parent & 0xFF)) * 16777619u;
+    h = (h ^ (parent >> 8)) * 16777619u;
+    uint labelLen = static_cast<uchar>(label[0]);
+    for (uint i = 0; i <= labelLen; i++)
+        h = (h ^ lowerChar(label[i])) * 16777619u;
+
+    return h;
+}
+
+uint CompressionDict::find(const char* buffer, const uint bufferLen, const uint parent, const char* label)
+{
+    if (!mReady)
+        return NONE;
+
+    uint labelLen = static_cast<uchar>(label[0]);
+    uint entry = getBucket(hash(parent, label));
+    while (entry != NONE)
+    {
+        const Entry &e = getEntry(entry);
+        // check that label is still present in buffer (buffer position could be moved back)
+        if (e.parent == parent && e.offset + labelLen + 1 < bufferLen && static_cast<uchar>(buffer[e.offset]) == labelLen)
+        {
+            uint i = 1;
+            while (i <= labelLen && lowerChar(buffer[e.offset + i]) == lowerChar(label[i]))
+                i++;
+            if (i > labelLen)
+                return entry;
+        }
+        entry = e.next;
+    }
+
+    return NONE;
+}
+
+uint CompressionDict::add(const char* buffer, const uint parent, const uint offset)
+{
+    if (!mReady)
+        clear();
+
+    // labels occupy at least two octets, so entries of all targets fit under NONE
+    if (offset > MAX_OFFSET)
+        return NONE;
+
+    if (mCount == INLINE_ENTRIES && mLargeBuckets.empty())
+        enlarge(buffer);
+    if (mCount >= INLINE_ENTRIES)
+        mMoreEntries.resize(mCount - INLINE_ENTRIES + 1);
+
+    unsigned short &bucket = getBucket(hash(parent, buffer + offset));
+    Entry &e = getEntry(mCount);
+    e.offset = offset;
+    e.parent = parent;
+    e.next = bucket;
+    bucket = mCount;
+
+    return mCount++;
+}
+
+void CompressionDict::enlarge(const char* buffer)
+{
+    mLargeBuckets.assign(LARGE_BUCKETS, NONE);
+    for (uint i = 0; i < mCount; i++)
+    {
+        Entry &e = getEntry(i);
+        unsigned short &bucket = getBucket(hash(e.parent, buffer + e.offset));
+        e.next = bucket;
+        bucket = i;
+    }
+}
+
+void CompressionDict::truncate(const char* buffer, const uint pos)
+{
+    if (!mReady)
+        return;
+
+    // buffer is rewound only to start of name (or record), names are written one
+    // after another and labels of each name are added right after it is written,
+    // so entries of labels at pos or behind it are the last ones and each of them
+    // is the head of its bucket chain
+    while (mCount > 0 && getEntry(mCount - 1).offset >= pos)
+    {
+        mCount--;
+        const Entry &e = getEntry(mCount);
+        getBucket(hash(e.parent, buffer + e.offset)) = e.next;
+    }
+    if (mCount < INLINE_ENTRIES)
+        mMoreEntries.clear();
+    else
+        mMoreEntries.resize(mCount - INLINE_ENTRIES);
+}
+
+/////////// Buffer ///////////
+
+Buffer::Buffer(std::vector<char>& storage, const uint maxSize)
+    : mStorage(&storage), mMaxSize(maxSize), mReserved(0), mLinkLog(NULL), mThrowing(true), mError(DECODE_OK), mErrorPos(0)
+{
+    // use whole allocated capacity, it is enlarged only when it is not sufficient
+    uint initialSize = storage.capacity() > MAX_MSG_LEN ? storage.capacity() : MAX_MSG_LEN;
+    if (initialSize > maxSize)
+        initialSize = maxSize;
+    storage.resize(initialSize);
+    mBuffer = mBufferPtr = storage.data();
+    mBufferSize = initialSize;
+}
+
+bool Buffer::grow(const uint size)
+{
+    if (mStorage == NULL || size > mMaxSize)
+        return false;
+
+    uint pos = getPos();
+    uint newSize = mBufferSize * 2 > size ? mBufferSize * 2 : size;
+    if (newSize > mMaxSize)
+        newSize = mMaxSize;
+    mStorage->resize(newSize);
+    mBuffer = mStorage->data();
+    mBufferPtr = mBuffer + pos;
+    mBufferSize = newSize;
+
+    return true;
+}
+
+void Buffer::rewind(const uint pos)
+{
+    if (pos > getPos())
+        return;
+
+    mDict.truncate(mBuffer, pos);
+    mBufferPtr = mBuffer + pos;
+    mError = DECODE_OK;
+    mErrorPos = 0;
+}
+
 uchar Buffer::get8bits()
 {
     // check if we are inside buffer
-    checkAvailableSpace(1);
+    if (!checkAvailableSpace(1))
+        return 0;
     uchar value = static_cast<uchar> (mBufferPtr[0]);
     mBufferPtr += 1;
 
@@ -149,7 +297,8 @@ uchar Buffer::get8bits()
 void Buffer::put8bits(const uchar value)
 {
     // check if we are inside buffer
-    checkAvailableSpace(1);
+    if (!checkAvailableSpace(1))
+        return;
     *mBufferPtr = value & 0xFF;
     mBufferPtr++;
 }
@@ -157,7 +306,8 @@ void Buffer::put8bits(const uchar value)
 dns::uint Buffer::get16bits()
 {
     // check if we are inside buffer
-    checkAvailableSpace(2);
+    if (!checkAvailableSpace(2))
+        return 0;
     uint value = static_cast<uchar> (mBufferPtr[0]);
     value = value << 8;
     value += static_cast<uchar> (mBufferPtr[1]);
@@ -169,7 +319,8 @@ dns::uint Buffer::get16bits()
 void Buffer::put16bits(const uint value)
 {
     // check if we are inside buffer
-    checkAvailableSpace(2);
+    if (!checkAvailableSpace(2))
+        return;
     *mBufferPtr = (value & 0xFF00) >> 8;
     mBufferPtr++;
     *mBufferPtr = value & 0xFF;
@@ -179,7 +330,8 @@ void Buffer::put16bits(const uint value)
 dns::uint Buffer::get32bits()
 {
     // check if we are inside buffer
-    checkAvailableSpace(4);
+    if (!checkAvailableSpace(4))
+        return 0;
     uint value = 0;
     value += (static_cast<uchar> (mBufferPtr[0])) << 24;
     value += (static_cast<uchar> (mBufferPtr[1])) << 16;
@@ -193,7 +345,8 @@ dns::uint Buffer::get32bits()
 void Buffer::put32bits(const uint value)
 {
     // check if we are inside buffer
-    checkAvailableSpace(4);
+    if (!checkAvailableSpace(4))
+        return;
     *mBufferPtr = (value & 0xFF000000) >> 24;
     mBufferPtr++;
     *mBufferPtr = (value & 0x00FF0000) >> 16;
@@ -206,15 +359,19 @@ void Buffer::put32bits(const uint value)
 
 void Buffer::setPos(const uint pos)
 {
-    // check if we are inside buffer
-    if (pos >= mBufferSize)
-        throw(Exception("Try to set pos behind buffer"));
+    // check if we are inside buffer (position behind the last byte is valid for writing)
+    if (pos > mBufferSize)
+    {
+        setError(DECODE_TRUNCATED);
+        return;
+    }
     mBufferPtr = mBuffer + pos;
 }
 
 char* Buffer::getBytes(const uint count)
 {
-    checkAvailableSpace(count);
+    if (!checkAvailableSpace(count))
+        return NULL;
     char *result = mBufferPtr;
     mBufferPtr += count;
 
@@ -227,7 +384,8 @@ void Buffer::putBytes(const char* data, const uint count)
         return;
 
     // check if we are inside buffer
-    checkAvailableSpace(count);
+    if (!checkAvailableSpace(count))
+        return;
     memcpy(mBufferPtr, data, sizeof(char) * count);
     mBufferPtr += count;
 }
@@ -239,7 +397,11 @@ std::string Buffer::getDnsCharacterString()
     // read first octet (byte) to know length of string
     uint stringLen = get8bits();
     if (stringLen > 0)
-        result.append(getBytes(stringLen), stringLen); // read label
+    {
+        const char* data = getBytes(stringLen);
+        if (data)
+            result.append(data, stringLen); // read label
+    }
 
     return result;
 }
@@ -252,25 +414,43 @@ void Buffer::putDnsCharacterString(const std::string& value)
 
 std::string Buffer::getDnsDomainName(const bool compressionAllowed)
 {
-    std::string domain;
+    char name[MAX_DOMAIN_LEN];
+    char text[MAX_DOMAIN_LEN];
 
-    // store current position to avoid of endless recursion for "bad link addresses"
-    if (std::find(mLinkPos.begin(), mLinkPos.end(), getPos()) == mLinkPos.end())
-        mLinkPos.push_back(getPos());
-    else
-    {
-        mLinkPos.clear();
-        throw (Exception("Decoding of domain failed because labels compression contains endless loop of links"));
-    }
+    if (getDnsDomainName(name, compressionAllowed) == 0)
+        return std::string();
 
-    // read domain name from buffer
+    return std::string(text, domainNameToText(name, text));
+}
+
+uint Buffer::getDnsDomainName(char* name, const bool compressionAllowed)
+{
+    const char* end = mBuffer + mBufferSize;
+    // start of currently read sequence of labels, links must point before it
+    const char* segment = mBufferPtr;
+    // position behind the first link, reading of buffer continues there
+    char* next = NULL;
+    char* ptr = mBufferPtr;
+    uint nameLen = 0;
+    uint hops = 0;
+    eDecodeError error = DECODE_OK;
+
+    // read domain name from buffer, links are followed by moving ptr
     while (true)
     {
+        if (ptr >= end)
+        {
+            error = DECODE_TRUNCATED;
+            break;
+        }
+
         // get first byte to decide if we are reading link, empty string or string of nonzero length
-        uint ctrlCode = get8bits();
+        uint ctrlCode = static_cast<uchar>(*ptr);
         // if we are on the end of the string
         if (ctrlCode == 0)
         {
+            name[nameLen++] = 0;
+            ptr++;
             break;
         }
         // if we are on the link
@@ -278,175 +458,172 @@ std::string Buffer::getDnsDomainName(const bool compressionAllowed)
         {
             // check if compression is allowed
             if (!compressionAllowed)
-                throw(Exception("Decoding of domain failed because compression link found where links are not allowed"));
-
-            // read second byte and get link address
-            uint ctrlCode2 = get8bits();
-            uint linkAddr = ((ctrlCode & 63) << 8) + ctrlCode2;
-            // change buffer position
-            uint saveBuffPos = getPos();
-            setPos(linkAddr);
-            std::string linkDomain = getDnsDomainName();
-            setPos(saveBuffPos);
-            if (domain.size() > 0)
-                domain.append(".");
-            domain.append(linkDomain);
-            // link always terminates the domain name (no zero at the end in this case)
-            break;
+            {
+                error = DECODE_POINTER_NOT_ALLOWED;
+                break;
+            }
+            if (ptr + 1 >= end)
+            {
+                error = DECODE_TRUNCATED;
+                break;
+            }
+            uint linkAddr = ((ctrlCode & 63) << 8) + static_cast<uchar>(ptr[1]);
+            if (next == NULL)
+                next = ptr + 2;
+            if (linkAddr >= mBufferSize)
+            {
+                error = DECODE_BAD_POINTER;
+                break;
+            }
+            // link must point to prior occurence of name (before the labels read so far),
+            // so links can't form an endless loop, number of links is limited as well
+            if (mBuffer + linkAddr >= segment || ++hops > MAX_LINK_HOPS)
+            {
+                error = DECODE_POINTER_LOOP;
+                break;
+            }
+            segment = ptr = mBuffer + linkAddr;
         }
         // we are reading label
         else
         {
             if (ctrlCode > MAX_LABEL_LEN)
-                throw(Exception("Decoding failed because of too long domain label (max length is 63 characters)"));
-
-            if (domain.size() > 0)
-                domain.append(".");
-
-            domain.append(getBytes(ctrlCode), ctrlCode); // read label
+            {
+                error = DECODE_LABEL_TOO_LONG;
+                break;
+            }
+            if (ptr + ctrlCode + 1 > end)
+            {
+                error = DECODE_TRUNCATED;
+                break;
+            }
+            // one octet is reserved for terminating zero
+            if (nameLen + ctrlCode + 1 >= MAX_DOMAIN_LEN)
+            {
+                error = DECODE_NAME_TOO_LONG;
+                break;
+            }
+            memcpy(name + nameLen, ptr, ctrlCode + 1);
+            nameLen += ctrlCode + 1;
+            ptr += ctrlCode + 1;
         }
     }
 
-    // check if domain contains only [A-Za-z0-9-] characters
-    /*
-    for (uint i = 0; i < domain.length(); i++)
+    if (error != DECODE_OK)
     {
-        if (!((domain[i] >= 'a' && domain[i] <= 'z') ||
-              (domain[i] >= 'A' && domain[i] <= 'Z') ||
-              (domain[i] >= '0' && domain[i] <= '9') ||
-              (domain[i] == '0') || (domain[i] == '.')))
-        {
-            cout << "Invalid char: " << domain[i] << endl;
-            throw (Exception("Decoding failed because domain name contains invalid characters (only [A-Za-z0-9-] are allowed)."));
-        }
+        mBufferPtr = ptr < end ? ptr : mBuffer + mBufferSize;
+        setError(error);
+        return 0;
     }
-    */
-    mLinkPos.pop_back();
 
-    if (domain.length() > MAX_DOMAIN_LEN)
-        throw(Exception("Decoding of domain name failed - domain name is too long."));
+    mBufferPtr = next ? next : ptr;
 
-    return domain;
+    return nameLen;
 }
 
-void Buffer::putDnsDomainName(const std::string& value, const bool compressionAllowed)
+uint Buffer::domainNameToText(const char* name, char* text)
 {
-    char domain[MAX_DOMAIN_LEN + 1]; // one additional byte for teminating zero byte
-    uint domainLabelIndexes[MAX_DOMAIN_LEN + 1]; // one additional byte for teminating zero byte
+    // |4|b|l|u|e|3|i|m|s|2|c|z|0| -> blue.ims.cz
+    uint textLen = 0;
+    uint labelLen = static_cast<uchar>(*name);
+    while (labelLen > 0)
+    {
+        if (textLen > 0)
+            text[textLen++] = '.';
+        memcpy(text + textLen, name + 1, labelLen);
+        textLen += labelLen;
+        name += labelLen + 1;
+        labelLen = static_cast<uchar>(*name);
+    }
+    text[textLen] = 0;
 
-    if (value.length() > MAX_DOMAIN_LEN)
-        throw(Exception("Domain name too long to be stored in dns message"));
+    return textLen;
+}
 
-    // write empty domain
-    if (value.length() == 0)
+bool Buffer::getDnsDomainName(DomainName& name, const bool compressionAllowed)
+{
+    char wire[MAX_DOMAIN_LEN];
+
+    if (getDnsDomainName(wire, compressionAllowed) == 0)
     {
-        put8bits(0);
-        return;
+        name = DomainName();
+        return false;
     }
+    name.fromWire(wire);
 
-    // convert value to <domain> without links as defined in RFC
+    return true;
+}
+
+void Buffer::putDnsDomainName(const DomainName& name, const bool compressionAllowed)
+{
+    // name is already in wire format without links
     // blue.ims.cz -> |4|b|l|u|e|3|i|m|s|2|c|z|0|
-    uint labelLen = 0;
-    uint labelLenPos = 0;
-    uint domainPos = 1;
-    uint ix = 0;
-    uint domainLabelIndexesCount = 0;
-    while (true)
+    const char* domain = name.getWire();
+    uint labelCount = name.getLabelCount();
+
+    // look for the longest suffix of domain which is already written to buffer,
+    // dictionary is searched from the last label towards the first one
+    uint suffixEntry = CompressionDict::NONE;
+    uint suffixIx = labelCount;
+    while (suffixIx > 0)
     {
-        if (value[ix] == '.' || ix == value.length())
-        {
-            if (labelLen > MAX_LABEL_LEN)
-                throw(Exception("Encoding failed because of too long domain label (max length is 63 characters)"));
-            domain[labelLenPos] = labelLen;
-            domainLabelIndexes[domainLabelIndexesCount++] = labelLenPos;
-
-            // ignore dot at the end since we do not want to encode
-            // empty label (which will produce one extra 0x00 byte)
-            if (value[ix] == '.' && ix == value.length() - 1)
-            {
-                break;
-            }
-
-            // finish at the end of the string value
-            if (ix == value.length())
-            {
-                // terminating zero byte
-                domain[domainPos] = 0;
-                domainPos++;
-                break;
-            }
-
-            labelLenPos = domainPos;
-            labelLen = 0;
-        }
-        else
-        {
-            labelLen++;
-            domain[domainPos] = value[ix];
-        }
-        domainPos++;
-        ix++;
+        uint entry = mDict.find(mBuffer, getPos(), suffixEntry, domain + name.getLabelOffset(suffixIx - 1));
+        if (entry == CompressionDict::NONE)
+            break;
+        suffixEntry = entry;
+        suffixIx--;
     }
 
-    if (compressionAllowed)
+    uint domainStartPos = getPos();
+    if (compressionAllowed && suffixIx < labelCount)
     {
-        // look for domain name parts in buffer and look for fragments for compression
-        // loop over all domain labels
-        bool compressionTipFound = false;
-        uint compressionTipPos = 0;
-        for (uint i = 0; i < domainLabelIndexesCount; i++)
-        {
-            // position of current label in domain buffer
-            uint domainLabelPos = (uint)domainLabelIndexes[i];
-            // pointer to subdomain (including initial byte for first label length)
-            char* subDomain = domain + domainLabelPos;
-            // length of subdomain (e.g. |3|i|m|s|2|c|z|0| for blue.ims.cz)
-            uint subDomainLen = domainPos - domainLabelPos;
-
-            // find buffer range that makes sense to search in
-            uint buffLen = mBufferPtr - mBuffer;
-            // search if buffer is large enough for searching
-            if (buffLen > subDomainLen)
-            {
-                // modify buffer length
-                buffLen -= subDomainLen;
-                // go through buffer from beginning and try to find occurence of compression tip
-                for (uint buffPos = 0; buffPos < buffLen ; buffPos++)
-                {
-                    // compare compression tip and content at current position in buffer
-                    compressionTipFound = (memcmp(mBuffer + buffPos, subDomain, subDomainLen) == 0);
-                    if (compressionTipFound)
-                    {
-                        compressionTipPos = buffPos;
-                        break;
-                    }
-                }
-            }
+        // write labels which are not in buffer yet followed by link to the known suffix
+        putBytes(domain, suffixIx > 0 ? name.getLabelOffset(suffixIx) : 0);
+        // link starts with value bin(1100000000000000)
+        if (mLinkLog)
+            mLinkLog->push_back(getPos());
+        put16bits(0xc000 + mDict.getOffset(suffixEntry));
+    }
+    else
+    {
+        // compression is disabled or no suffix is known, domain is written as it is
+        putBytes(domain, name.getWireLen());
+    }
 
-            if (compressionTipFound)
-            {
-                // link starts with value bin(1100000000000000)
-                uint linkValue = 0xc000;
-                linkValue += compressionTipPos;
-                put16bits(linkValue);
-                break;
-            }
-            else
-            {
-                // write label
-                uint labelLen = subDomain[0];
-                putBytes(subDomain, labelLen + 1);
-            }
-        }
+    // remember new labels (and suffixes they start) for later compression, labels are
+    // added from the last one since each entry refers to entry of its suffix
+    while (suffixIx > 0)
+    {
+        suffixIx--;
+        uint labelPos = name.getLabelOffset(suffixIx);
+        suffixEntry = mDict.add(mBuffer, suffixEntry, domainStartPos + labelPos);
+        if (suffixEntry == CompressionDict::NONE)
+            break;
+    }
+}
 
-        // write terminating zero if no compression tip was found and all labels are writtten to buffer
-        if (!compressionTipFound)
-            put8bits(0);
+void Buffer::registerDnsDomainName(const uint pos)
+{
+    uint labels[DomainName::MAX_LABELS];
+    uint labelCount = 0;
+    uint labelPos = pos;
+    while (labelPos < mBufferSize && labelCount < DomainName::MAX_LABELS)
+    {
+        uint labelLen = static_cast<uchar>(mBuffer[labelPos]);
+        if (labelLen == 0 || labelLen > MAX_LABEL_LEN || labelPos + labelLen >= mBufferSize)
+            break;
+        labels[labelCount++] = labelPos;
+        labelPos += labelLen + 1;
     }
-    else
+
+    // labels are added from the last one since each entry refers to entry of its suffix
+    uint entry = CompressionDict::NONE;
+    while (labelCount > 0)
     {
-        // compression is disabled, domain is written as it is
-        putBytes(domain, domainPos);
+        labelCount--;
+        entry = mDict.add(mBuffer, entry, labels[labelCount]);
+        if (entry == CompressionDict::NONE)
+            break;
     }
 }
 
@@ -469,18 +646,64 @@ void Buffer::dump(const uint count)
     cout << "---------------------------------" << endl;
 }
 
-void Buffer::checkAvailableSpace(const uint additionalSpace)
+bool Buffer::checkAvailableSpace(const uint additionalSpace)
 {
-    // check if buffer pointer is valid
-    if (mBufferPtr < mBuffer)
-        throw(Exception("Buffer pointer is invalid"));
-
     // get position in buffer
     uint bufferPos = (mBufferPtr - mBuffer);
 
-    // check if we are inside buffer
-    if ((bufferPos + additionalSpace) > mBufferSize)
-        throw(Exception("Try to read behind buffer"));
+    // check if we are inside buffer (growable buffer is enlarged if possible)
+    uint requiredSize = bufferPos + additionalSpace + mReserved;
+    if (requiredSize > mBufferSize && !grow(requiredSize))
+    {
+        setError(DECODE_TRUNCATED);
+        return false;
+    }
+
+    return true;
 }
 
+void Buffer::setError(const eDecodeError error)
+{
+    if (mThrowing)
+        throw(Exception(getDecodeErrorText(error)));
+
+    // keep the first error, later errors are usually consequence of it
+    if (mError == DECODE_OK)
+    {
+        mError = error;
+        mErrorPos = getPos();
+    }
+}
 
+const char* dns::getDecodeErrorText(const eDecodeError error)
+{
+    switch (error)
+    {
+        case DECODE_OK:
+            return "No error";
+        case DECODE_TRUNCATED:
+            return "Try to read behind buffer";
+        case DECODE_BAD_POINTER:
+            return "Decoding of domain failed because compression link points behind buffer";
+        case DECODE_POINTER_LOOP:
+            return "Decoding of domain failed because labels compression contains endless loop of links";
+        case DECODE_LABEL_TOO_LONG:
+            return "Decoding failed because of too long domain label (max length is 63 characters)";
+        case DECODE_NAME_TOO_LONG:
+            return "Decoding of domain name failed - domain name is too long.";
+        case DECODE_POINTER_NOT_ALLOWED:
+            return "Decoding of domain failed because compression link found where links are not allowed";
+        case DECODE_BAD_RDATA_LENGTH:
+            return "Number of decoded bytes are different than expected size";
+        case DECODE_MESSAGE_TOO_LONG:
+            return "Aborting parse of message which exceedes maximal DNS message length.";
+        case DECODE_TRAILING_BYTES:
+            return "Message buffer not empty after parsing";
+        case DECODE_BAD_OPT:
+            return "Duplicated or malformed OPT record";
+        case DECODE_NOT_QUERY:
+            return "Message is not a standard query with one question";
+        default:
+            return "Unknown error";
+    }
+}
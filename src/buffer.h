@@ -42,9 +42,95 @@
 #include <vector>
 
 #include "dns.h"
+#include "name.h"
 
 namespace dns
 {
+/**
+ * Dictionary of domain names written to buffer (used for name compression)
+ *
+ * Each entry describes one label stored in the buffer together with the
+ * entry of the suffix that follows it (parent), so every name and all its
+ * suffixes are known by their offsets. Lookup of a name is a walk from the
+ * last label (top level domain) towards the first one with one hashed probe
+ * per label. Labels are compared case-insensitively.
+ *
+ * The first entries are kept inline, so the dictionary is cheap for small
+ * messages. Large messages (EDNS, TCP) move it to a larger heap table, every
+ * label which can be a compression target (offset up to 0x3FFF) gets an entry.
+ */
+class CompressionDict
+{
+    public:
+        // value used for "no entry" (also parent of top level labels)
+        static const uint NONE = 0xFFFF;
+
+        CompressionDict() : mCount(0), mReady(false) { }
+
+        // remove all entries
+        void clear();
+
+        // find entry for label (length octet followed by label characters) followed by
+        // suffix represented by parent entry, buffer content is used to verify candidates
+        uint find(const char* buffer, const uint bufferLen, const uint parent, const char* label);
+
+        // add entry for label stored at offset in buffer, returns index of new entry
+        // or NONE if offset can't be used as compression target
+        uint add(const char* buffer, const uint parent, const uint offset);
+
+        // offset of label represented by entry
+        uint getOffset(const uint entry) const { return getEntry(entry).offset; }
+
+        // number of entries
+        uint getCount() const { return mReady ? mCount : 0; }
+
+        // remove entries of labels stored at offset pos or behind it
+        void truncate(const char* buffer, const uint pos);
+
+    private:
+        static const uint BUCKETS = 256;
+        static const uint INLINE_ENTRIES = 512;
+        static const uint LARGE_BUCKETS = 4096;
+        // maximal offset which could be stored in compression link
+        static const uint MAX_OFFSET = 0x3FFF;
+
+        struct Entry
+        {
+            // offset of label length octet in buffer
+            unsigned short offset;
+            // entry of the suffix that follows the label
+            unsigned short parent;
+            // next entry in the same bucket
+            unsigned short next;
+        };
+
+        // heads of bucket chains (used until mLargeBuckets is filled)
+        unsigned short mBuckets[BUCKETS];
+        // entries (only first mCount items are valid)
+        Entry mEntries[INLINE_ENTRIES];
+        // entries behind inline ones
+        std::vector<Entry> mMoreEntries;
+        // heads of bucket chains of large dictionary (empty for small one)
+        std::vector<unsigned short> mLargeBuckets;
+        // number of used entries
+        uint mCount;
+        // buckets are initialized on first use to keep construction cheap
+        bool mReady;
+
+        Entry& getEntry(const uint entry) { return entry < INLINE_ENTRIES ? mEntries[entry] : mMoreEntries[entry - INLINE_ENTRIES]; }
+        const Entry& getEntry(const uint entry) const { return entry < INLINE_ENTRIES ? mEntries[entry] : mMoreEntries[entry - INLINE_ENTRIES]; }
+
+        unsigned short& getBucket(const uint hash) { return mLargeBuckets.empty() ? mBuckets[hash & (BUCKETS - 1)] : mLargeBuckets[hash & (LARGE_BUCKETS - 1)]; }
+
+        // move entries to buckets of large dictionary
+        void enlarge(const char* buffer);
+
+        static uint hash(const uint parent, const char* label);
+};
+
+// Get text description of decoding error
+const char* getDecodeErrorText(const eDecodeError error);
+
 /**
  * Buffer for DNS protocol parsing and serialization
  *
@@ -59,7 +145,11 @@ namespace dns
 class Buffer
 {
     public:
-        Buffer(char* buffer, uint bufferSize) : mBuffer(buffer), mBufferSize(bufferSize), mBufferPtr(buffer) { }
+        Buffer(char* buffer, uint bufferSize) : mBuffer(buffer), mBufferSize(bufferSize), mBufferPtr(buffer), mStorage(NULL), mMaxSize(bufferSize), mReserved(0), mLinkLog(NULL), mThrowing(true), mError(DECODE_OK), mErrorPos(0) { }
+
+        // Constructor of growable buffer (used for encoding), storage is enlarged
+        // on demand up to maxSize bytes, its current allocation is reused
+        Buffer(std::vector<char>& storage, const uint maxSize);
 
         // get current position in buffer
         uint getPos() { return mBufferPtr - mBuffer; }
@@ -70,6 +160,9 @@ class Buffer
         // get buffer size in bytes
         uint getSize() { return mBufferSize; }
 
+        // get buffer content (pointer is invalidated when growable buffer is enlarged)
+        const char* getData() const { return mBuffer; }
+
         // Helper function that get 8  bits from the buffer and keeps it an int.
         uchar get8bits();
         void put8bits(const uchar value);
@@ -83,6 +176,7 @@ class Buffer
         void put32bits(const uint value);
 
         // Helper function that gets number of bytes from the buffer
+        // (returns NULL if there are not enough bytes and exceptions are disabled)
         char* getBytes(uint count);
         void putBytes(const char* data, uint count);
 
@@ -93,24 +187,85 @@ class Buffer
         // Helper function that gets <domain> (according to RFC 1035) from buffer
         std::string getDnsDomainName(const bool compressionAllowed = true);
 
+        // Helper function that gets <domain> (according to RFC 1035) from buffer in wire format
+        // (sequence of labels terminated by zero octet, compression links are resolved)
+        // @param name - buffer for name (at least MAX_DOMAIN_LEN bytes)
+        // @return length of name in wire format (0 if name couldn't be decoded)
+        uint getDnsDomainName(char* name, const bool compressionAllowed);
+
+        // Helper function that gets <domain> (according to RFC 1035) from buffer to name value
+        // @return false if name couldn't be decoded (name is set to root domain)
+        bool getDnsDomainName(DomainName& name, const bool compressionAllowed = true);
+
+        // Convert name in wire format to text form (labels separated by dots)
+        // @param text - buffer for zero terminated text (at least MAX_DOMAIN_LEN bytes)
+        // @return length of text
+        static uint domainNameToText(const char* name, char* text);
+
+        // Remember domain name which is already stored in buffer at pos as target
+        // for compression of names written later (name must not contain links)
+        void registerDnsDomainName(const uint pos);
+
         // Helper function that puts <domain> (according to RFC 1035) to buffer
-        void putDnsDomainName(const std::string& value, const bool compressionAllowed = true);
+        // (text is converted to DomainName implicitly, exception is thrown if it is not valid)
+        void putDnsDomainName(const DomainName& name, const bool compressionAllowed = true);
+
+        // Check if there is enough space in buffer (error is reported if not)
+        bool checkAvailableSpace(const uint additionalSpace);
+
+        // Keep number of bytes at the end of buffer unavailable for writing
+        // (space for data which must be written at the end, e.g. OPT record)
+        void setReserved(const uint reserved) { mReserved = reserved; }
+
+        // Set list for positions of compression links written by putDnsDomainName (NULL disables logging)
+        void setLinkLog(std::vector<uint>* links) { mLinkLog = links; }
+
+        // Move position back to pos, forget names written behind it and clear
+        // error state (used to drop partially written data)
+        void rewind(const uint pos);
 
-        // Check if there is enough space in buffer
-        void checkAvailableSpace(const uint additionalSpace);
+        // Switch between reporting of errors by exceptions (default) and by error state.
+        // In error state reads return zero values and getBytes returns NULL.
+        void setThrowing(const bool throwing) { mThrowing = throwing; }
+
+        // Report error - exception is thrown or error is stored (only the first one)
+        void setError(const eDecodeError error);
+
+        // Get first reported error and position where it was detected
+        eDecodeError getError() const { return mError; }
+        uint getErrorPos() const { return mErrorPos; }
 
         // Function that dumps the whole buffer
         void dump(const uint count = 0);
 
     private:
+        // maximal number of compression links followed when decoding one domain name
+        static const uint MAX_LINK_HOPS = 64;
+
         // buffer content
         char* mBuffer;
         // buffer content size
-        const uint mBufferSize;
+        uint mBufferSize;
         // current position in buffer
         char* mBufferPtr;
-        // list of link positions visited when decoding domain name
-        std::vector<uint> mLinkPos;
+        // storage of growable buffer (NULL if buffer has fixed size)
+        std::vector<char>* mStorage;
+        // maximal size of growable buffer
+        uint mMaxSize;
+        // bytes at the end of buffer which are not available for writing
+        uint mReserved;
+        // positions of written compression links (optional)
+        std::vector<uint>* mLinkLog;
+        // names written to buffer (targets for compression links)
+        CompressionDict mDict;
+        // errors are reported by exceptions
+        bool mThrowing;
+        // first error and its position
+        eDecodeError mError;
+        uint mErrorPos;
+
+        // enlarge growable buffer to hold at least size bytes
+        bool grow(const uint size);
 };
 
 } // namespace
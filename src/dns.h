@@ -49,6 +49,14 @@ typedef unsigned char byte;
 const uint MAX_MSG_LEN = 512;
 const uint MAX_LABEL_LEN = 63;
 const uint MAX_DOMAIN_LEN = 255;
+// default UDP payload size advertised by EDNS0 (RFC 6891)
+const uint EDNS_UDP_PAYLOAD_SIZE = 4096;
+
+// convert ascii character to lower case (domain names are case insensitive)
+inline uchar lowerChar(const uchar c)
+{
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
 
 // CLASS types
 enum eClass {
@@ -59,7 +67,9 @@ enum eClass {
     // the CHAOS class
     CLASS_CH,
     // Hesiod
-    CLASS_HS
+    CLASS_HS,
+    // maximal value of 16 bit field (values of all fields are representable)
+    CLASS_MAX = 0xFFFF
 };
 
 
@@ -74,7 +84,9 @@ enum eQClass {
     // Hesiod
     QCLASS_HS,
     // Any class - *
-    QCLASS_ASTERISK = 255
+    QCLASS_ASTERISK = 255,
+    // maximal value of 16 bit field (values of all fields are representable)
+    QCLASS_MAX = 0xFFFF
 };
 
 // RData types
@@ -119,7 +131,62 @@ enum eRDataType {
     RDATA_NAPTR = 35,
     RDATA_A6 = 0x0026,
     RDATA_OPT = 0x0029,
-    RDATA_ANY = 0x00ff
+    RDATA_ANY = 0x00ff,
+    // maximal value of 16 bit field (values of all fields are representable)
+    RDATA_MAX = 0xFFFF
+};
+
+// Sections of message with resource records
+enum eSection {
+    SECTION_ANSWER = 0,
+    SECTION_AUTHORITY,
+    SECTION_ADDITIONAL
+};
+
+// Response codes (RCODE field of header)
+enum eRCode {
+    // no error condition
+    RCODE_NOERROR = 0,
+    // name server was unable to interpret the query
+    RCODE_FORMERR,
+    // name server was unable to process the query
+    RCODE_SERVFAIL,
+    // domain name referenced in the query does not exist
+    RCODE_NXDOMAIN,
+    // name server does not support the requested kind of query
+    RCODE_NOTIMP,
+    // name server refuses to perform the specified operation
+    RCODE_REFUSED
+};
+
+// Errors detected when decoding wire data
+enum eDecodeError {
+    // no error
+    DECODE_OK = 0,
+    // data is shorter than expected (read behind buffer)
+    DECODE_TRUNCATED,
+    // compression link points outside of message
+    DECODE_BAD_POINTER,
+    // compression links form an endless loop
+    DECODE_POINTER_LOOP,
+    // domain label is longer than 63 characters
+    DECODE_LABEL_TOO_LONG,
+    // domain name is longer than 255 characters
+    DECODE_NAME_TOO_LONG,
+    // compression link found where links are not allowed
+    DECODE_POINTER_NOT_ALLOWED,
+    // rdata length doesn't match size of decoded rdata
+    DECODE_BAD_RDATA_LENGTH,
+    // message exceeds maximal DNS message length
+    DECODE_MESSAGE_TOO_LONG,
+    // data left in buffer after last record
+    DECODE_TRAILING_BYTES,
+    // OPT pseudo record is duplicated or it is not owned by root domain
+    DECODE_BAD_OPT,
+    // message is not a standard query with one question
+    DECODE_NOT_QUERY,
+    // number of error codes (not an error)
+    DECODE_ERROR_COUNT
 };
 
 } // namespace
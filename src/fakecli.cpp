@@ -74,7 +74,7 @@ int main(int argc, char** argv)
     dns::QuerySection *qs = new dns::QuerySection("biloxi.ims");
     qs->setType(dns::RDATA_NAPTR);
     qs->setClass(dns::QCLASS_IN);
-    m.addQuery(qs);
+    m.addQuery(dns::QuerySectionPtr(qs));
 
     sockfd = socket(AF_INET,SOCK_DGRAM, 0);
     bzero(&servaddr, sizeof(servaddr));
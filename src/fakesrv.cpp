@@ -34,6 +34,7 @@
 
 #include <iostream>
 #include <sstream>
+#include <vector>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -41,14 +42,39 @@
 #include <strings.h>
 #include <string.h>
 #include <getopt.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <thread>
+#include <memory>
+#include <chrono>
+#include <sys/uio.h>
+#include <netinet/udp.h>
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
 
 #include "exception.h"
 #include "message.h"
 #include "rr.h"
+#include "stream.h"
+#include "response.h"
+#include "policy.h"
 
 using namespace std;
 
-#define MAX_MSG 2000
+#define MAX_MSG dns::EDNS_UDP_PAYLOAD_SIZE
+#define MAX_TCP_CLIENTS 64
+#define MAX_WORKERS 256
+
+// buffer for datagram coalesced by UDP GRO
+#define GRO_BUFFER_SIZE 65536
+// limits of responses coalesced into one send by UDP GSO (segment must fit
+// into ethernet MTU, older kernels accept at most 64 segments)
+#define GSO_MAX_SEGMENT_SIZE 1472
+#define GSO_MAX_SEGMENTS 64
+#define GSO_MAX_SIZE 65000
 
 #define VERSION_MAJOR 1
 #define VERSION_MINOR 1
@@ -57,20 +83,1059 @@ using namespace std;
 #define VERBOSITY_BASIC "basic"
 #define VERBOSITY_ALL "all"
 
+enum eVerbosityLevel { verbosityNone = 0, verbosityBasic, verbosityAll};
+
+// response prepared in slot of UDP batch
+struct UdpResponse
+{
+    // slot with query (address of client)
+    unsigned int slot;
+    char *data;
+    unsigned int size;
+};
+
+// slab of buffers for batched UDP I/O (recvmmsg/sendmmsg)
+struct UdpBatch
+{
+    // maximal number of datagrams in batch (1 disables batching)
+    unsigned int size;
+    // how long answered queries wait for batch to fill (microseconds)
+    unsigned int flushTimeout;
+    // datagrams are received with UDP_GRO and responses sent with UDP_SEGMENT
+    bool gso;
+    // size of one slot of slab
+    unsigned int slotSize;
+    // buffers of received datagrams, responses replace queries
+    std::vector<char> slab;
+    std::vector<sockaddr_in> addrs;
+    std::vector<iovec> iovs;
+    std::vector<mmsghdr> msgs;
+    // control data of received datagrams (GRO segment size)
+    std::vector<char> controls;
+    // copy of datagram coalesced by GRO
+    std::vector<char> scratch;
+    // prepared responses and headers for sending them
+    std::vector<UdpResponse> responses;
+    std::vector<iovec> sendIovs;
+    std::vector<mmsghdr> sendMsgs;
+    std::vector<char> sendControls;
+    // number of used slots (answered queries waiting for flush)
+    unsigned int pending;
+    // time when the first pending query was answered
+    std::chrono::steady_clock::time_point pendingSince;
+};
+
+// state shared by UDP and TCP transports (one per worker thread, nothing is
+// shared between workers)
+struct ServerContext
+{
+    eVerbosityLevel verbosityLevel;
+    // index of worker (-1 if server runs single worker)
+    int worker;
+    // UDP socket and TCP listening socket (-1 if TCP is not available)
+    int sockfd;
+    int tcpfd;
+    // message is reused for all packets, its records are allocated from arena
+    dns::Arena arena;
+    dns::Message m;
+    // number of malformed packets per error class
+    unsigned long decodeErrors[dns::DECODE_ERROR_COUNT];
+    // number of responses
+    unsigned int i;
+    // pre-encoded responses (without and with EDNS0)
+    dns::ResponseTemplate response;
+    dns::ResponseTemplate responseEdns;
+    // answer policy shared by all workers (NULL if built-in answer is used)
+    const dns::Policy *policy;
+    // buffer for responses rendered by policy for TCP clients
+    std::vector<char> tcpResponse;
+    // batched UDP I/O
+    UdpBatch batch;
+};
+
+// TCP client connection
+struct TcpClient
+{
+    int fd;
+    // received data (queries could be split between reads or pipelined)
+    dns::StreamDecoder decoder;
+    // responses which were not written yet
+    dns::StreamEncoder encoder;
+};
+
 void displayUsage(void)
 {
     cout << "Fake DNS server" << endl;
-    cout << "usage: fakesrv [-l ip ] [-p port] [-e level] [-h]" << endl;
+    cout << "usage: fakesrv [-l ip ] [-p port] [-r rules] [-t threads] [-a] [-b size] [-f usec] [-g] [-u] [-e level] [-h]" << endl;
     cout << " -l ip      ip address for listening (default is '127.0.0.1')" << endl;
-    cout << " -p port    port for listening ((default is '53')" << endl;
+    cout << " -p port    port for listening (UDP and TCP, default is '53')" << endl;
+    cout << " -r rules   answer queries by rules from file instead of the built-in NAPTR answer (unmatched queries are refused)" << endl;
+    cout << " -t threads number of worker threads, each with own sockets bound by SO_REUSEPORT (default is 1)" << endl;
+    cout << " -a         pin worker threads to CPUs (worker i runs on CPU i modulo number of CPUs)" << endl;
+    cout << " -b size    number of UDP datagrams received and sent by one syscall (default is 1)" << endl;
+    cout << " -f usec    time answered queries wait for batch to fill (default is 0 - answers are sent after each receive)" << endl;
+    cout << " -g         receive datagrams coalesced by UDP GRO and send responses to the same client by UDP GSO (with -b)" << endl;
+    cout << " -u         use io_uring event loop (multishot receive, provided buffers, not with -b, -f and -g)" << endl;
     cout << " -e level   output verbosity level - 'all', 'basic', 'none' (default is 'all')" << endl;
     cout << " -h         show usage" << endl;
     cout << " -v         get version info" << endl;
 }
 
+// add answers to response (records are allocated from arena or heap if arena is NULL)
+void addAnswers(dns::Message &m, dns::Arena *arena)
+{
+    // add NAPTR answer
+    dns::ResourceRecord *rr = new (arena) dns::ResourceRecord();
+    if (m.getQdCount() > 0)
+        rr->setName(m.getQueries()[0]->getName());
+    rr->setType(dns::RDATA_NAPTR);
+    rr->setClass(dns::CLASS_IN);
+    rr->setTtl(1);
+    dns::RDataNAPTR *rdata = new (arena) dns::RDataNAPTR();
+    rdata->setOrder(1);
+    rdata->setPreference(1);
+    rdata->setFlags("u");
+    rdata->setServices("SIP+E2U");
+    rdata->setRegExp("!.*!domena.cz!");
+    rdata->setReplacement("");
+    rr->setRData(rdata);
+    m.addAnswer(dns::ResourceRecordPtr(rr));
+
+
+    /*
+    // add A answer
+    dns::ResourceRecord *rrA = new dns::ResourceRecord();
+    rrA->setType(dns::RDATA_A);
+    rrA->setClass(dns::CLASS_IN);
+    rrA->setTtl(60);
+    dns::RDataA *rdataA = new dns::RDataA();
+    dns::uchar ip4[4] = {'\x01', '\x02', '\x03', '\x04' };
+    rdataA->setAddress(ip4);
+    rrA->setRData(rdataA);
+    m.addAnswer(dns::ResourceRecordPtr(rrA));
+    */
+}
+
+// decode query to message of context
+// @return false if query is malformed
+bool decodeQuery(ServerContext &ctx, const char* mesg, const unsigned int n)
+{
+    dns::Message &m = ctx.m;
+
+    if (ctx.verbosityLevel >= verbosityBasic)
+        cout << "Received DNS packet (" << ctx.i << ") of size " << n << " bytes" << endl;
+
+    unsigned int errorOffset;
+    dns::eDecodeError error = m.decode(mesg, n, errorOffset);
+    if (error != dns::DECODE_OK)
+    {
+        ctx.decodeErrors[error]++;
+        if (ctx.verbosityLevel >= verbosityBasic)
+            cout << "DNS error occured when parsing incoming data at offset " << errorOffset << ": " << dns::getDecodeErrorText(error) << endl;
+        return false;
+    }
+
+    if (ctx.verbosityLevel >= verbosityAll)
+    {
+        cout << "-------------------------------------------------------" << endl;
+        cout << m.asString() << endl;
+        cout << "-------------------------------------------------------" << endl;
+    }
+
+    return true;
+}
+
+// decode query and turn message to response
+// @return false if query is malformed
+bool processQuery(ServerContext &ctx, const char* mesg, const unsigned int n)
+{
+    if (!decodeQuery(ctx, mesg, n))
+        return false;
+
+    dns::Message &m = ctx.m;
+
+    // change type of message to response
+    m.setQr(dns::Message::typeResponse);
+
+    // EDNS0 is used in response only if it was used in query (options are not echoed)
+    m.getEdnsOptions().clearOptions();
+
+    addAnswers(m, &ctx.arena);
+
+    return true;
+}
+
+// log sent response and print statistics
+void responseSent(ServerContext &ctx, const unsigned int mesgSize)
+{
+    if (ctx.verbosityLevel >= verbosityBasic)
+        cout << "Sending DNS packet (" << ctx.i << ") of size " << mesgSize << " bytes" << endl;
+
+    if (ctx.verbosityLevel >= verbosityAll)
+    {
+        cout << "-------------------------------------------------------" << endl;
+        cout << ctx.m.asString() << endl;
+        cout << "-------------------------------------------------------" << endl;
+    }
+
+    if (ctx.verbosityLevel >= verbosityNone)
+    {
+        if (ctx.i % 10000 == 0)
+        {
+            cout << "iterations: " << ctx.i;
+            if (ctx.worker >= 0)
+                cout << " (worker " << ctx.worker << ")";
+            cout << endl;
+            for (unsigned int e = dns::DECODE_OK + 1; e < dns::DECODE_ERROR_COUNT; e++)
+                if (ctx.decodeErrors[e] > 0)
+                    cout << "  malformed packets (" << dns::getDecodeErrorText(static_cast<dns::eDecodeError>(e)) << "): " << ctx.decodeErrors[e] << endl;
+        }
+    }
+    ctx.i++;
+}
+
+// fill header fields and question of decoded query (see dns::peekQuestion)
+// @param mesg - wire data of query (flags are taken from its header as they are)
+// @return false if query isn't standard query with exactly one question
+bool peekMessage(dns::Message &m, const char* mesg, dns::QueryPeek &query)
+{
+    // the same checks as dns::peekQuestion (QR and OPCODE must be 0)
+    uint flags = (static_cast<dns::uchar>(mesg[2]) << 8) | static_cast<dns::uchar>(mesg[3]);
+    if ((flags & 0xF800) != 0 || m.getQueries().size() != 1)
+        return false;
+
+    const dns::QuerySection &qs = *m.getQueries()[0];
+    query.id = m.getId();
+    query.flags = flags;
+    query.qname = qs.getName().getWire();
+    query.qnameSize = qs.getName().getWireLen();
+    query.qnameHash = qs.getName().hash();
+    query.qtype = qs.getType();
+    query.qclass = qs.getClass();
+    query.edns = m.hasEdns();
+    query.udpPayloadSize = m.getUdpPayloadSize();
+
+    return true;
+}
+
+// write ID and question of query to buffer (response is rendered behind them)
+void writeQuestion(const dns::QueryPeek &query, char* buffer)
+{
+    buffer[0] = query.id >> 8;
+    buffer[1] = query.id & 0xFF;
+    memcpy(buffer + 12, query.qname, query.qnameSize);
+    char *p = buffer + 12 + query.qnameSize;
+    p[0] = query.qtype >> 8;
+    p[1] = query.qtype & 0xFF;
+    p[2] = query.qclass >> 8;
+    p[3] = query.qclass & 0xFF;
+}
+
+// answer query by rules of policy
+// @param response - buffer for response (it could be the buffer with query)
+// @param maxSize - maximal size of response (0 for UDP - size is limited by payload
+//                  size advertised by query and response is truncated if it doesn't fit)
+// @return size of response (0 if query is not answered)
+unsigned int answerByPolicy(ServerContext &ctx, const char* mesg, const unsigned int n, char* response, const unsigned int maxSize)
+{
+    // query is decoded only if it should be printed or it can't be peeked
+    dns::QueryPeek query;
+    bool peeked = ctx.verbosityLevel < verbosityAll && dns::peekQuestion(mesg, n, query) == dns::DECODE_OK;
+    if (peeked)
+    {
+        if (ctx.verbosityLevel >= verbosityBasic)
+            cout << "Received DNS packet (" << ctx.i << ") of size " << n << " bytes" << endl;
+    }
+    else if (!decodeQuery(ctx, mesg, n) || !peekMessage(ctx.m, mesg, query))
+        return 0;
+
+    const dns::ResponseTemplate *tpl = ctx.policy->find(query);
+    if (tpl == NULL)
+        return 0;
+
+    if (!peeked || response != mesg)
+        writeQuestion(query, response);
+
+    uint mesgSize;
+    if (maxSize > 0)
+        mesgSize = tpl->render(response, maxSize, query);
+    else
+    {
+        mesgSize = tpl->render(response, query.getMaxUdpSize() < MAX_MSG ? query.getMaxUdpSize() : MAX_MSG, query);
+        if (mesgSize == 0)
+        {
+            // empty response with TC flag, client should retry over TCP
+            uint flags = 0x8200 | (query.flags & 0x7910);
+            response[2] = flags >> 8;
+            response[3] = flags & 0xFF;
+            response[4] = 0;
+            response[5] = 1;
+            memset(response + 6, 0, 6);
+            mesgSize = 12 + query.qnameSize + 4;
+        }
+    }
+    if (mesgSize == 0)
+        return 0;
+
+    // rendered response is decoded to be printed
+    if (ctx.verbosityLevel >= verbosityAll)
+    {
+        unsigned int errorOffset;
+        ctx.m.decode(response, mesgSize, errorOffset);
+    }
+    responseSent(ctx, mesgSize);
+
+    return mesgSize;
+}
+
+// answer UDP query (response is written to buffer with query)
+// @return size of response (0 if query is not answered)
+unsigned int answerUdp(ServerContext &ctx, char* mesg, const unsigned int n)
+{
+    if (ctx.policy != NULL)
+        return answerByPolicy(ctx, mesg, n, mesg, 0);
+
+    // response is rendered from template directly to buffer with query unless it should be printed
+    dns::QueryPeek query;
+    if (ctx.verbosityLevel < verbosityAll && dns::peekQuestion(mesg, n, query) == dns::DECODE_OK)
+    {
+        if (ctx.verbosityLevel >= verbosityBasic)
+            cout << "Received DNS packet (" << ctx.i << ") of size " << n << " bytes" << endl;
+        const dns::ResponseTemplate &response = query.edns ? ctx.responseEdns : ctx.response;
+        // response is limited by payload size advertised by client and by size of buffer
+        uint mesgSize = response.render(mesg, query.getMaxUdpSize() < MAX_MSG ? query.getMaxUdpSize() : MAX_MSG, query);
+        if (mesgSize > 0)
+        {
+            responseSent(ctx, mesgSize);
+            return mesgSize;
+        }
+    }
+
+    if (!processQuery(ctx, mesg, n))
+        return 0;
+
+    // response size is limited by payload size advertised by client
+    uint maxResponseSize = ctx.m.getMaxUdpSize() < MAX_MSG ? ctx.m.getMaxUdpSize() : MAX_MSG;
+    ctx.m.setUdpPayloadSize(MAX_MSG);
+
+    // response is truncated (TC flag) if it doesn't fit into UDP datagram
+    uint mesgSize;
+    ctx.m.encodeTruncated(mesg, maxResponseSize, mesgSize);
+    responseSent(ctx, mesgSize);
+
+    return mesgSize;
+}
+
+// receive UDP query and send response
+void serveUdp(ServerContext &ctx, int sockfd, char* mesg)
+{
+    struct sockaddr_in cliaddr;
+    socklen_t len = sizeof(cliaddr);
+    int n = recvfrom(sockfd, mesg, MAX_MSG, MSG_DONTWAIT, (struct sockaddr *)&cliaddr, &len);
+    if (n < 0)
+        return;
+
+    unsigned int mesgSize = answerUdp(ctx, mesg, n);
+    if (mesgSize > 0)
+        sendto(sockfd, mesg, mesgSize, 0, (struct sockaddr *)&cliaddr,sizeof(cliaddr));
+}
+
+// allocate slab for batched UDP I/O
+void initUdpBatch(UdpBatch &batch, const unsigned int size, const unsigned int flushTimeout, const bool gso)
+{
+    batch.size = size;
+    batch.flushTimeout = flushTimeout;
+    batch.gso = gso;
+    batch.slotSize = gso ? GRO_BUFFER_SIZE : MAX_MSG;
+    batch.slab.resize(size * batch.slotSize);
+    batch.addrs.resize(size);
+    batch.iovs.resize(size);
+    batch.msgs.resize(size);
+    batch.controls.resize(size * CMSG_SPACE(sizeof(int)));
+    if (gso)
+        batch.scratch.resize(GRO_BUFFER_SIZE);
+    batch.pending = 0;
+}
+
+// enable receiving of datagrams coalesced by UDP GRO
+// @return false if kernel doesn't support it
+bool enableUdpGro(const int sockfd)
+{
+    int enable = 1;
+    if (setsockopt(sockfd, SOL_UDP, UDP_GRO, &enable, sizeof(enable)) == -1)
+    {
+        cout << "Warning: UDP GRO is not available (" << strerror(errno) << ")" << endl;
+        return false;
+    }
+
+    return true;
+}
+
+// check if responses are sent to the same client
+bool sameClient(const UdpBatch &batch, const UdpResponse &a, const UdpResponse &b)
+{
+    const sockaddr_in &addrA = batch.addrs[a.slot];
+    const sockaddr_in &addrB = batch.addrs[b.slot];
+    return addrA.sin_addr.s_addr == addrB.sin_addr.s_addr && addrA.sin_port == addrB.sin_port;
+}
+
+// send all prepared responses by sendmmsg, consecutive responses of equal size
+// for the same client are coalesced into one message segmented by kernel (GSO)
+void flushUdpBatch(ServerContext &ctx)
+{
+    UdpBatch &batch = ctx.batch;
+    unsigned int count = batch.responses.size();
+    batch.sendIovs.resize(count);
+    batch.sendMsgs.resize(count);
+    batch.sendControls.resize(count * CMSG_SPACE(sizeof(uint16_t)));
+
+    unsigned int messages = 0;
+    for (unsigned int first = 0; first < count; )
+    {
+        const UdpResponse &response = batch.responses[first];
+        unsigned int end = first + 1;
+        unsigned int total = response.size;
+        // only the last segment could be shorter than segment size
+        if (batch.gso && response.size <= GSO_MAX_SEGMENT_SIZE)
+        {
+            while (end < count
+                && end - first < GSO_MAX_SEGMENTS
+                && batch.responses[end - 1].size == response.size
+                && batch.responses[end].size <= response.size
+                && total + batch.responses[end].size <= GSO_MAX_SIZE
+                && sameClient(batch, response, batch.responses[end]))
+            {
+                total += batch.responses[end].size;
+                end++;
+            }
+        }
+
+        for (unsigned int i = first; i < end; i++)
+        {
+            batch.sendIovs[i].iov_base = batch.responses[i].data;
+            batch.sendIovs[i].iov_len = batch.responses[i].size;
+        }
+
+        msghdr &hdr = batch.sendMsgs[messages].msg_hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.msg_name = &batch.addrs[response.slot];
+        hdr.msg_namelen = sizeof(sockaddr_in);
+        hdr.msg_iov = &batch.sendIovs[first];
+        hdr.msg_iovlen = end - first;
+        if (end - first > 1)
+        {
+            hdr.msg_control = &batch.sendControls[messages * CMSG_SPACE(sizeof(uint16_t))];
+            hdr.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+            cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr);
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            uint16_t segmentSize = response.size;
+            memcpy(CMSG_DATA(cmsg), &segmentSize, sizeof(segmentSize));
+        }
+        messages++;
+        first = end;
+    }
+
+    unsigned int sent = 0;
+    while (sent < messages)
+    {
+        int n = sendmmsg(ctx.sockfd, &batch.sendMsgs[sent], messages - sent, 0);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            // message which failed is dropped
+            n = 1;
+        }
+        sent += n;
+    }
+
+    batch.responses.clear();
+    batch.pending = 0;
+}
+
+// get segment size of datagram coalesced by GRO (0 if datagram is not coalesced)
+unsigned int getGroSegmentSize(msghdr &hdr)
+{
+    for (cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr); cmsg != NULL; cmsg = CMSG_NXTHDR(&hdr, cmsg))
+    {
+        if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+        {
+            int segmentSize;
+            memcpy(&segmentSize, CMSG_DATA(cmsg), sizeof(segmentSize));
+            return segmentSize;
+        }
+    }
+
+    return 0;
+}
+
+// answer queries of one slot (datagram coalesced by GRO carries several queries
+// of one client, their responses are packed one after another in slot)
+void answerUdpSlot(ServerContext &ctx, const unsigned int slot, const unsigned int n)
+{
+    UdpBatch &batch = ctx.batch;
+    char *base = &batch.slab[slot * batch.slotSize];
+    unsigned int segmentSize = batch.gso ? getGroSegmentSize(batch.msgs[slot].msg_hdr) : 0;
+    if (segmentSize == 0 || segmentSize >= n)
+    {
+        UdpResponse response = { slot, base, answerUdp(ctx, base, n) };
+        if (response.size > 0)
+            batch.responses.push_back(response);
+        return;
+    }
+
+    memcpy(&batch.scratch[0], base, n);
+    unsigned int offset = 0;
+    for (unsigned int pos = 0; pos < n; pos += segmentSize)
+    {
+        // queries without space for response are dropped
+        if (offset + MAX_MSG > batch.slotSize)
+            break;
+        unsigned int size = n - pos < segmentSize ? n - pos : segmentSize;
+        UdpResponse response = { slot, base + offset, 0 };
+        memcpy(response.data, &batch.scratch[pos], size);
+        response.size = answerUdp(ctx, response.data, size);
+        if (response.size > 0)
+            batch.responses.push_back(response);
+        offset += response.size;
+    }
+}
+
+// receive UDP queries into free slots of batch by one recvmmsg and answer them,
+// responses are sent when batch is full or flush timeout is zero
+void serveUdpBatch(ServerContext &ctx)
+{
+    UdpBatch &batch = ctx.batch;
+    unsigned int first = batch.pending;
+    for (unsigned int i = first; i < batch.size; i++)
+    {
+        batch.iovs[i].iov_base = &batch.slab[i * batch.slotSize];
+        batch.iovs[i].iov_len = batch.slotSize;
+        msghdr &hdr = batch.msgs[i].msg_hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.msg_name = &batch.addrs[i];
+        hdr.msg_namelen = sizeof(batch.addrs[i]);
+        hdr.msg_iov = &batch.iovs[i];
+        hdr.msg_iovlen = 1;
+        if (batch.gso)
+        {
+            hdr.msg_control = &batch.controls[i * CMSG_SPACE(sizeof(int))];
+            hdr.msg_controllen = CMSG_SPACE(sizeof(int));
+        }
+    }
+
+    int n = recvmmsg(ctx.sockfd, &batch.msgs[first], batch.size - first, MSG_DONTWAIT, NULL);
+    if (n <= 0)
+        return;
+
+    if (first == 0)
+        batch.pendingSince = std::chrono::steady_clock::now();
+    for (unsigned int i = first; i < first + n; i++)
+        answerUdpSlot(ctx, i, batch.msgs[i].msg_len);
+    batch.pending += n;
+
+    if (batch.pending == batch.size || batch.flushTimeout == 0)
+        flushUdpBatch(ctx);
+}
+
+// write queued responses to TCP client
+// @return false if connection failed
+bool writeTcp(TcpClient &client)
+{
+    while (client.encoder.getSize() > 0)
+    {
+        int n = send(client.fd, client.encoder.getData(), client.encoder.getSize(), MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0)
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        client.encoder.consume(n);
+    }
+
+    return true;
+}
+
+// answer all complete queries received from TCP client (responses are queued in encoder)
+void answerTcp(ServerContext &ctx, TcpClient &client)
+{
+    const char* mesg;
+    unsigned int mesgSize;
+    while (client.decoder.next(mesg, mesgSize))
+    {
+        if (ctx.policy != NULL)
+        {
+            uint size = answerByPolicy(ctx, mesg, mesgSize, ctx.tcpResponse.data(), ctx.tcpResponse.size());
+            if (size > 0)
+                client.encoder.add(ctx.tcpResponse.data(), size);
+            continue;
+        }
+
+        if (!processQuery(ctx, mesg, mesgSize))
+            continue;
+        ctx.m.setUdpPayloadSize(MAX_MSG);
+        uint size = client.encoder.getSize();
+        client.encoder.add(ctx.m);
+        responseSent(ctx, client.encoder.getSize() - size);
+    }
+}
+
+// read data from TCP client and answer all complete queries by one write
+// @return false if connection was closed or failed
+bool serveTcp(ServerContext &ctx, TcpClient &client)
+{
+    int n = recv(client.fd, client.decoder.prepare(MAX_MSG), MAX_MSG, MSG_DONTWAIT);
+    if (n < 0)
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    if (n == 0)
+        return false;
+    client.decoder.commit(n);
+    answerTcp(ctx, client);
+
+    return writeTcp(client);
+}
+
+// create socket bound to local address and port
+// @param reusePort - socket shares port with sockets of other workers (SO_REUSEPORT)
+int createSocket(const int type, const in_addr &listenAddress, const unsigned int listenPort, const bool reusePort, const eVerbosityLevel verbosityLevel)
+{
+    struct sockaddr_in servaddr;
+    int sockfd = socket(AF_INET, type, 0);
+    if (sockfd == -1)
+    {
+        cout << "Error creating file descriptor" << endl;
+        return -1;
+    }
+    if (verbosityLevel >= verbosityBasic)
+        cout << "socket created (" << sockfd << ")" << endl;
+
+    int reuse = 1;
+    if (type == SOCK_STREAM)
+        setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    // kernel distributes datagrams and connections among sockets of workers
+    if (reusePort && setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) == -1)
+    {
+        cout << "Error setting SO_REUSEPORT (" << strerror(errno) << ")" << endl;
+        close(sockfd);
+        return -1;
+    }
+
+    // bind socket to local address and port
+    bzero(&servaddr,sizeof(servaddr));
+    servaddr.sin_family = AF_INET;
+    servaddr.sin_addr=listenAddress;
+    servaddr.sin_port=htons(listenPort);
+    if (bind(sockfd,(struct sockaddr *)&servaddr,sizeof(servaddr)) == -1)
+    {
+        cout  << "Error binding socket, addr: " << inet_ntoa(servaddr.sin_addr) << ":" << listenPort << ", fd:" << sockfd << " (" << strerror(errno) << ")" << endl;
+        close(sockfd);
+        return -1;
+    }
+    if (verbosityLevel >= verbosityBasic)
+        cout << "socket binded (port " << listenPort << ")" << endl;
+
+    return sockfd;
+}
+
+// serve UDP and TCP queries of one worker
+void runWorker(ServerContext &ctx)
+{
+    // message buffer
+    char mesg[MAX_MSG];
+
+    std::vector<TcpClient*> clients;
+    std::vector<pollfd> fds;
+    for (;;)
+    {
+        // UDP socket, TCP listening socket and TCP clients
+        fds.clear();
+        pollfd pfd = { ctx.sockfd, POLLIN, 0 };
+        fds.push_back(pfd);
+        pfd.fd = ctx.tcpfd;
+        fds.push_back(pfd);
+        for (std::vector<TcpClient*>::iterator it = clients.begin(); it != clients.end(); ++it)
+        {
+            pfd.fd = (*it)->fd;
+            pfd.events = POLLIN | ((*it)->encoder.getSize() > 0 ? POLLOUT : 0);
+            fds.push_back(pfd);
+        }
+
+        // wait for more queries only until pending responses should be flushed
+        timespec timeout;
+        timespec *waitTime = NULL;
+        if (ctx.batch.pending > 0)
+        {
+            std::chrono::microseconds waited = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - ctx.batch.pendingSince);
+            long remaining = static_cast<long>(ctx.batch.flushTimeout) - waited.count();
+            if (remaining < 0)
+                remaining = 0;
+            timeout.tv_sec = remaining / 1000000;
+            timeout.tv_nsec = (remaining % 1000000) * 1000;
+            waitTime = &timeout;
+        }
+
+        if (ppoll(fds.data(), fds.size(), waitTime, NULL) == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            cout << "Error waiting for data (" << strerror(errno) << ")" << endl;
+            return;
+        }
+
+        if (fds[0].revents & POLLIN)
+        {
+            if (ctx.batch.size > 1)
+                serveUdpBatch(ctx);
+            else
+                serveUdp(ctx, ctx.sockfd, mesg);
+        }
+
+        if (ctx.batch.pending > 0 && std::chrono::steady_clock::now() - ctx.batch.pendingSince >= std::chrono::microseconds(ctx.batch.flushTimeout))
+            flushUdpBatch(ctx);
+
+        // serve clients before accepting new ones (fds are paired with clients by index)
+        for (unsigned int c = clients.size(); c > 0; c--)
+        {
+            TcpClient *client = clients[c - 1];
+            short revents = fds[c + 1].revents;
+            bool ok = true;
+            if (revents & POLLIN)
+                ok = serveTcp(ctx, *client);
+            else if (revents & (POLLERR | POLLHUP | POLLNVAL))
+                ok = false;
+            if (ok && (revents & POLLOUT))
+                ok = writeTcp(*client);
+            if (!ok)
+            {
+                close(client->fd);
+                delete client;
+                clients.erase(clients.begin() + c - 1);
+            }
+        }
+
+        if (fds[1].revents & POLLIN)
+        {
+            int fd = accept(ctx.tcpfd, NULL, NULL);
+            if (fd != -1 && clients.size() >= MAX_TCP_CLIENTS)
+            {
+                close(fd);
+                fd = -1;
+            }
+            if (fd != -1)
+            {
+                TcpClient *client = new TcpClient();
+                client->fd = fd;
+                clients.push_back(client);
+            }
+        }
+    }
+}
+
+#ifdef HAVE_LIBURING
+// number of provided buffers for UDP datagrams (power of two)
+#define URING_BUFFERS 256
+// buffer group of provided buffers
+#define URING_BUFFER_GROUP 1
+// size of provided buffer (recvmsg header, source address and datagram)
+#define URING_BUFFER_SIZE (sizeof(io_uring_recvmsg_out) + sizeof(sockaddr_in) + MAX_MSG)
+// delay of accept restarted after error (e.g. EMFILE), it is restarted sooner if client is closed
+#define URING_ACCEPT_DELAY_MS 100
+
+// operation of submission, stored in low bits of user data together with
+// buffer id (UDP) or pointer to client (TCP)
+enum eUringOp { uringUdpRecv = 0, uringUdpSend, uringAccept, uringAcceptDelay, uringTcpRecv, uringTcpSend };
+
+#define URING_OP_MASK 7
+
+// state of io_uring event loop of one worker
+struct UringLoop
+{
+    io_uring ring;
+    io_uring_buf_ring *bufferRing;
+    std::vector<char> buffers;
+    // template of multishot recvmsg (sizes of name and control data)
+    msghdr recvHdr;
+    // headers of sends, indexed by id of buffer with response
+    msghdr sendHdrs[URING_BUFFERS];
+    iovec sendIovs[URING_BUFFERS];
+    // multishot receive is active
+    bool udpArmed;
+    // multishot accept is active, it could be restarted (it is stopped after error until delay expires or client is closed)
+    bool acceptArmed;
+    bool acceptReady;
+    __kernel_timespec acceptDelay;
+    // number of provided buffers owned by kernel
+    unsigned int buffersInRing;
+    std::vector<TcpClient*> clients;
+};
+
+// get submission entry, queue is submitted if it is full
+io_uring_sqe* getSqe(UringLoop &loop, const unsigned long long data)
+{
+    io_uring_sqe *sqe = io_uring_get_sqe(&loop.ring);
+    while (sqe == NULL)
+    {
+        io_uring_submit(&loop.ring);
+        sqe = io_uring_get_sqe(&loop.ring);
+    }
+    io_uring_sqe_set_data64(sqe, data);
+
+    return sqe;
+}
+
+// give buffer back to kernel for receiving
+void recycleUringBuffer(UringLoop &loop, const unsigned int bid)
+{
+    io_uring_buf_ring_add(loop.bufferRing, &loop.buffers[bid * URING_BUFFER_SIZE], URING_BUFFER_SIZE, bid, io_uring_buf_ring_mask(URING_BUFFERS), 0);
+    io_uring_buf_ring_advance(loop.bufferRing, 1);
+    loop.buffersInRing++;
+}
+
+void armUdpRecv(ServerContext &ctx, UringLoop &loop)
+{
+    io_uring_sqe *sqe = getSqe(loop, uringUdpRecv);
+    io_uring_prep_recvmsg_multishot(sqe, ctx.sockfd, &loop.recvHdr, 0);
+    sqe->flags |= IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUFFER_GROUP;
+    loop.udpArmed = true;
+}
+
+void armAccept(ServerContext &ctx, UringLoop &loop)
+{
+    io_uring_prep_multishot_accept(getSqe(loop, uringAccept), ctx.tcpfd, NULL, NULL, 0);
+    loop.acceptArmed = true;
+}
+
+void armTcpRecv(UringLoop &loop, TcpClient *client)
+{
+    io_uring_sqe *sqe = getSqe(loop, reinterpret_cast<uintptr_t>(client) | uringTcpRecv);
+    io_uring_prep_recv(sqe, client->fd, client->decoder.prepare(MAX_MSG), MAX_MSG, 0);
+}
+
+void armTcpSend(UringLoop &loop, TcpClient *client)
+{
+    io_uring_sqe *sqe = getSqe(loop, reinterpret_cast<uintptr_t>(client) | uringTcpSend);
+    io_uring_prep_send(sqe, client->fd, client->encoder.getData(), client->encoder.getSize(), MSG_NOSIGNAL);
+}
+
+void closeUringClient(UringLoop &loop, TcpClient *client)
+{
+    close(client->fd);
+    // descriptor is free, stopped accept could succeed now
+    loop.acceptReady = true;
+    for (std::vector<TcpClient*>::iterator it = loop.clients.begin(); it != loop.clients.end(); ++it)
+    {
+        if (*it == client)
+        {
+            loop.clients.erase(it);
+            break;
+        }
+    }
+    delete client;
+}
+
+// accept completed, accept stopped by error is not restarted immediately (error would repeat at once)
+void uringAccepted(UringLoop &loop, const io_uring_cqe *cqe)
+{
+    if (cqe->res >= 0 && loop.clients.size() < MAX_TCP_CLIENTS)
+    {
+        TcpClient *client = new TcpClient();
+        client->fd = cqe->res;
+        loop.clients.push_back(client);
+        armTcpRecv(loop, client);
+    }
+    else if (cqe->res >= 0)
+        close(cqe->res);
+
+    if (cqe->flags & IORING_CQE_F_MORE)
+        return;
+    loop.acceptArmed = false;
+    loop.acceptReady = cqe->res >= 0;
+    if (!loop.acceptReady)
+        io_uring_prep_timeout(getSqe(loop, uringAcceptDelay), &loop.acceptDelay, 0, 0);
+}
+
+// answer datagram received to provided buffer, response is sent from the same buffer
+void uringUdpReceived(ServerContext &ctx, UringLoop &loop, const io_uring_cqe *cqe)
+{
+    if (!(cqe->flags & IORING_CQE_F_MORE))
+        loop.udpArmed = false;
+    if (!(cqe->flags & IORING_CQE_F_BUFFER))
+        return;
+
+    unsigned int bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+    loop.buffersInRing--;
+    char *buffer = &loop.buffers[bid * URING_BUFFER_SIZE];
+    io_uring_recvmsg_out *out = cqe->res > 0 ? io_uring_recvmsg_validate(buffer, cqe->res, &loop.recvHdr) : NULL;
+    if (out == NULL || (out->flags & MSG_TRUNC) || out->namelen > sizeof(sockaddr_in))
+    {
+        recycleUringBuffer(loop, bid);
+        return;
+    }
+
+    char *mesg = static_cast<char*>(io_uring_recvmsg_payload(out, &loop.recvHdr));
+    unsigned int n = io_uring_recvmsg_payload_length(out, cqe->res, &loop.recvHdr);
+    unsigned int mesgSize = answerUdp(ctx, mesg, n);
+    if (mesgSize == 0)
+    {
+        recycleUringBuffer(loop, bid);
+        return;
+    }
+
+    msghdr &hdr = loop.sendHdrs[bid];
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.msg_name = io_uring_recvmsg_name(out);
+    hdr.msg_namelen = out->namelen;
+    loop.sendIovs[bid].iov_base = mesg;
+    loop.sendIovs[bid].iov_len = mesgSize;
+    hdr.msg_iov = &loop.sendIovs[bid];
+    hdr.msg_iovlen = 1;
+    io_uring_prep_sendmsg(getSqe(loop, (static_cast<unsigned long long>(bid) << 3) | uringUdpSend), ctx.sockfd, &hdr, 0);
+}
+
+// answer queries received from TCP client, the next read is submitted when all
+// responses are written (buffers of client don't move while kernel uses them)
+void uringTcpReceived(ServerContext &ctx, UringLoop &loop, TcpClient *client, const int res)
+{
+    if (res <= 0)
+    {
+        closeUringClient(loop, client);
+        return;
+    }
+
+    client->decoder.commit(res);
+    answerTcp(ctx, *client);
+    if (client->encoder.getSize() > 0)
+        armTcpSend(loop, client);
+    else
+        armTcpRecv(loop, client);
+}
+
+void uringTcpSent(UringLoop &loop, TcpClient *client, const int res)
+{
+    if (res < 0)
+    {
+        closeUringClient(loop, client);
+        return;
+    }
+
+    client->encoder.consume(res);
+    if (client->encoder.getSize() > 0)
+        armTcpSend(loop, client);
+    else
+        armTcpRecv(loop, client);
+}
+
+// serve UDP and TCP queries of one worker by io_uring event loop
+void runUringWorker(ServerContext &ctx)
+{
+    UringLoop loop;
+    int error = io_uring_queue_init(2 * URING_BUFFERS, &loop.ring, 0);
+    if (error < 0)
+    {
+        cout << "Error initializing io_uring (" << strerror(-error) << ")" << endl;
+        return;
+    }
+
+    loop.bufferRing = io_uring_setup_buf_ring(&loop.ring, URING_BUFFERS, URING_BUFFER_GROUP, 0, &error);
+    if (loop.bufferRing == NULL)
+    {
+        cout << "Error registering buffer ring (" << strerror(-error) << ")" << endl;
+        io_uring_queue_exit(&loop.ring);
+        return;
+    }
+    loop.buffers.resize(URING_BUFFERS * URING_BUFFER_SIZE);
+    loop.buffersInRing = 0;
+    for (unsigned int bid = 0; bid < URING_BUFFERS; bid++)
+        recycleUringBuffer(loop, bid);
+
+    memset(&loop.recvHdr, 0, sizeof(loop.recvHdr));
+    loop.recvHdr.msg_namelen = sizeof(sockaddr_in);
+    armUdpRecv(ctx, loop);
+
+    loop.acceptArmed = false;
+    loop.acceptReady = false;
+    loop.acceptDelay.tv_sec = 0;
+    loop.acceptDelay.tv_nsec = URING_ACCEPT_DELAY_MS * 1000000LL;
+    if (ctx.tcpfd != -1)
+        armAccept(ctx, loop);
+
+    for (;;)
+    {
+        // all queued submissions are passed to kernel by one syscall
+        error = io_uring_submit_and_wait(&loop.ring, 1);
+        if (error < 0 && error != -EINTR)
+        {
+            cout << "Error waiting for completions (" << strerror(-error) << ")" << endl;
+            break;
+        }
+
+        unsigned int head;
+        unsigned int count = 0;
+        io_uring_cqe *cqe;
+        io_uring_for_each_cqe(&loop.ring, head, cqe)
+        {
+            count++;
+            unsigned long long data = io_uring_cqe_get_data64(cqe);
+            TcpClient *client = reinterpret_cast<TcpClient*>(data & ~static_cast<unsigned long long>(URING_OP_MASK));
+            switch (data & URING_OP_MASK)
+            {
+                case uringUdpRecv:
+                    uringUdpReceived(ctx, loop, cqe);
+                    break;
+                case uringUdpSend:
+                    recycleUringBuffer(loop, data >> 3);
+                    break;
+                case uringAccept:
+                    uringAccepted(loop, cqe);
+                    break;
+                case uringAcceptDelay:
+                    loop.acceptReady = true;
+                    break;
+                case uringTcpRecv:
+                    uringTcpReceived(ctx, loop, client, cqe->res);
+                    break;
+                case uringTcpSend:
+                    uringTcpSent(loop, client, cqe->res);
+                    break;
+            }
+        }
+        io_uring_cq_advance(&loop.ring, count);
+
+        // receive stops when kernel runs out of buffers, it is restarted once some are returned
+        if (!loop.udpArmed && loop.buffersInRing > 0)
+            armUdpRecv(ctx, loop);
+        if (ctx.tcpfd != -1 && !loop.acceptArmed && loop.acceptReady)
+            armAccept(ctx, loop);
+    }
+
+    for (std::vector<TcpClient*>::iterator it = loop.clients.begin(); it != loop.clients.end(); ++it)
+    {
+        close((*it)->fd);
+        delete *it;
+    }
+    io_uring_free_buf_ring(&loop.ring, loop.bufferRing, URING_BUFFERS, URING_BUFFER_GROUP);
+    io_uring_queue_exit(&loop.ring);
+}
+#endif
+
+// pin calling thread to CPU (index is wrapped by number of CPUs)
+void pinThread(unsigned int cpu)
+{
+    unsigned int cpuCount = std::thread::hardware_concurrency();
+    if (cpuCount > 0)
+        cpu %= cpuCount;
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    int error = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    if (error != 0)
+        cout << "Warning: Can't pin worker to CPU " << cpu << " (" << strerror(error) << ")" << endl;
+}
+
 int main(int argc, char** argv)
 {
-    enum eVerbosityLevel { verbosityNone = 0, verbosityBasic, verbosityAll} verbosityLevel = verbosityAll;
+    eVerbosityLevel verbosityLevel = verbosityAll;
 
     // ip address for listening
     std::string listenIp = "127.0.0.1";
@@ -78,11 +1143,28 @@ int main(int argc, char** argv)
     // port for listening
     unsigned int listenPort = 53;
 
-    // message buffer
-    char mesg[MAX_MSG];
+    // number of worker threads
+    unsigned int workerCount = 1;
+
+    // pin workers to CPUs
+    bool pinWorkers = false;
+
+    // number of UDP datagrams per syscall and flush timeout of batch
+    unsigned int batchSize = 1;
+    unsigned int flushTimeout = 0;
+
+    // coalescing of datagrams by UDP GRO/GSO
+    bool gso = false;
+
+    // event loop of workers
+    void (*run)(ServerContext&) = runWorker;
+
+    // answer policy
+    dns::Policy policy;
+    bool usePolicy = false;
 
     // parse cli arguments
-    static const char *optString = "l:p:e:hv";
+    static const char *optString = "l:p:r:t:ab:f:gue:hv";
     int opt = getopt(argc, argv, optString);
     while(opt != -1) {
         switch(opt) {
@@ -107,6 +1189,57 @@ int main(int argc, char** argv)
                     std::istringstream(optarg) >> listenPort;
                     break;
                 }
+            case 'r':
+                try
+                {
+                    policy.load(optarg);
+                }
+                catch (dns::Exception &e)
+                {
+                    cout << "Can't load rules: " << e.what() << endl;
+                    return 1;
+                }
+                usePolicy = true;
+                break;
+            case 't':
+                {
+                    std::istringstream(optarg) >> workerCount;
+                    if (workerCount < 1 || workerCount > MAX_WORKERS)
+                    {
+                        cout << "Number of threads must be between 1 and " << MAX_WORKERS << endl;
+                        return 1;
+                    }
+                    break;
+                }
+            case 'a':
+                pinWorkers = true;
+                break;
+            case 'b':
+                {
+                    std::istringstream(optarg) >> batchSize;
+                    if (batchSize < 1 || batchSize > UIO_MAXIOV)
+                    {
+                        cout << "Batch size must be between 1 and " << UIO_MAXIOV << endl;
+                        return 1;
+                    }
+                    break;
+                }
+            case 'f':
+                {
+                    std::istringstream(optarg) >> flushTimeout;
+                    break;
+                }
+            case 'g':
+                gso = true;
+                break;
+            case 'u':
+#ifdef HAVE_LIBURING
+                run = runUringWorker;
+                break;
+#else
+                cout << "fakesrv was built without io_uring support (liburing 2.4 or newer was not found)" << endl;
+                return 1;
+#endif
             case 'h':
                 displayUsage();
                 return 0;
@@ -127,111 +1260,83 @@ int main(int argc, char** argv)
         listenAddress.s_addr = htonl(INADDR_ANY);
     }
 
-    // create socket descriptor
-    int sockfd;
-    struct sockaddr_in servaddr,cliaddr;
-    socklen_t len;
-    sockfd = socket(AF_INET,SOCK_DGRAM,0);
-    if (sockfd == -1)
-    {
-        cout << "Error creating file descriptor" << endl;
-        return 1;
-    }
-    if (verbosityLevel >= verbosityBasic)
-        cout << "socket created (" << sockfd << ")" << endl;
+    // responses are encoded once (answer is the same for all queries)
+    dns::ResponseTemplate response;
+    dns::ResponseTemplate responseEdns;
+    dns::Message tpl;
+    tpl.setQr(dns::Message::typeResponse);
+    tpl.addQuery(dns::QuerySectionPtr(new dns::QuerySection()));
+    addAnswers(tpl, NULL);
+    response.build(tpl);
+    tpl.setEdns(true);
+    tpl.setUdpPayloadSize(MAX_MSG);
+    responseEdns.build(tpl);
 
-    // bind socket to local address and port
-    bzero(&servaddr,sizeof(servaddr));
-    servaddr.sin_family = AF_INET;
-    servaddr.sin_addr=listenAddress;
-    servaddr.sin_port=htons(listenPort);
-    if (bind(sockfd,(struct sockaddr *)&servaddr,sizeof(servaddr)) == -1)
+    if (run != runWorker && (batchSize > 1 || flushTimeout > 0 || gso))
     {
-        cout  << "Error binding socket, addr: " << inet_ntoa(servaddr.sin_addr) << ":" << listenPort << ", fd:" << sockfd << " (" << strerror(errno) << ")" << endl;
+        cout << "Batched I/O (-b, -f) and UDP GRO/GSO (-g) can't be used with io_uring event loop (-u)" << endl;
         return 1;
     }
-    if (verbosityLevel >= verbosityBasic)
-        cout << "socket binded (port " << listenPort << ")" << endl;
+    if (gso && batchSize == 1)
+        cout << "Warning: UDP GRO/GSO is used only with batched I/O (-b)" << endl;
 
-    unsigned int i = 0;
-    for (;;)
+    // each worker gets own sockets, message and copy of templates
+    bool reusePort = workerCount > 1;
+    std::vector<std::unique_ptr<ServerContext> > workers;
+    for (unsigned int w = 0; w < workerCount; w++)
     {
-        len = sizeof(cliaddr);
-        int n = recvfrom(sockfd, mesg, MAX_MSG, 0, (struct sockaddr *)&cliaddr, &len);
-        if (verbosityLevel >= verbosityBasic)
-            cout << "Received DNS packet (" << i << ") of size " << n << " bytes" << endl;
-
-        dns::Message m;
-        try
-        {
-            m.decode(mesg, n);
-        }
-        catch (dns::Exception& e)
-        {
-            cout << "DNS exception occured when parsing incoming data: " << e.what() << endl;
-            continue;
-        }
-
-        if (verbosityLevel >= verbosityAll)
-        {
-            cout << "-------------------------------------------------------" << endl;
-            cout << m.asString() << endl;
-            cout << "-------------------------------------------------------" << endl;
-        }
-
-        // change type of message to response
-        m.setQr(dns::Message::typeResponse);
+        std::unique_ptr<ServerContext> ctx(new ServerContext());
+        ctx->verbosityLevel = verbosityLevel;
+        ctx->worker = workerCount > 1 ? w : -1;
+        ctx->m.setArena(&ctx->arena);
+        for (unsigned int e = 0; e < dns::DECODE_ERROR_COUNT; e++)
+            ctx->decodeErrors[e] = 0;
+        ctx->i = 0;
+        ctx->response = response;
+        ctx->responseEdns = responseEdns;
+        ctx->policy = usePolicy ? &policy : NULL;
+        if (usePolicy)
+            ctx->tcpResponse.resize(dns::Message::MAX_ENCODED_LEN);
 
-        // add NAPTR answer
-        dns::ResourceRecord *rr = new dns::ResourceRecord();
-        rr->setType(dns::RDATA_NAPTR);
-        rr->setClass(dns::CLASS_IN);
-        rr->setTtl(1);
-        dns::RDataNAPTR *rdata = new dns::RDataNAPTR();
-        rdata->setOrder(1);
-        rdata->setPreference(1);
-        rdata->setFlags("u");
-        rdata->setServices("SIP+E2U");
-        rdata->setRegExp("!.*!domena.cz!");
-        rdata->setReplacement("");
-        rr->setRData(rdata);
-        m.addAnswer(rr);
+        // create UDP socket
+        ctx->sockfd = createSocket(SOCK_DGRAM, listenAddress, listenPort, reusePort, verbosityLevel);
+        if (ctx->sockfd == -1)
+            return 1;
 
+        // GRO/GSO is used only by batched loop
+        bool batchGso = gso && batchSize > 1 && enableUdpGro(ctx->sockfd);
+        initUdpBatch(ctx->batch, batchSize, flushTimeout, batchGso);
 
-        /*
-        // add A answer
-        dns::ResourceRecord *rrA = new dns::ResourceRecord();
-        rrA->setType(dns::RDATA_A);
-        rrA->setClass(dns::CLASS_IN);
-        rrA->setTtl(60);
-        dns::RDataA *rdataA = new dns::RDataA();
-        dns::uchar ip4[4] = {'\x01', '\x02', '\x03', '\x04' };
-        rdataA->setAddress(ip4);
-        rrA->setRData(rdataA);
-        m.addAnswer(rrA);
-        */
-
-        uint mesgSize;
-        m.encode(mesg, MAX_MSG, mesgSize);
-
-        if (verbosityLevel >= verbosityBasic)
-            cout << "Sending DNS packet (" << i << ") of size " << mesgSize << " bytes" << endl;
-
-        if (verbosityLevel >= verbosityAll)
+        // create TCP socket (server works without TCP if it is not available)
+        ctx->tcpfd = createSocket(SOCK_STREAM, listenAddress, listenPort, reusePort, verbosityLevel);
+        if (ctx->tcpfd != -1 && listen(ctx->tcpfd, MAX_TCP_CLIENTS) == -1)
         {
-            cout << "-------------------------------------------------------" << endl;
-            cout << m.asString() << endl;
-            cout << "-------------------------------------------------------" << endl;
+            close(ctx->tcpfd);
+            ctx->tcpfd = -1;
         }
+        if (ctx->tcpfd == -1 && w == 0)
+            cout << "Warning: TCP is not available, only UDP queries will be served" << endl;
 
-        sendto(sockfd, mesg, mesgSize, 0, (struct sockaddr *)&cliaddr,sizeof(cliaddr));
+        workers.push_back(std::move(ctx));
+    }
 
-        if (verbosityLevel >= verbosityNone)
-        {
-            if (i % 10000 == 0)
-                cout << "iterations: " << i << endl;
-        }
-        i++;
+    // the first worker runs in main thread
+    std::vector<std::thread> threads;
+    for (unsigned int w = 1; w < workerCount; w++)
+    {
+        ServerContext *ctx = workers[w].get();
+        threads.push_back(std::thread([ctx, w, pinWorkers, run]() {
+            if (pinWorkers)
+                pinThread(w);
+            run(*ctx);
+        }));
     }
-    return 0;
+    if (pinWorkers)
+        pinThread(0);
+    run(*workers[0]);
+
+    for (std::vector<std::thread>::iterator it = threads.begin(); it != threads.end(); ++it)
+        it->join();
+
+    return 1;
 }
@@ -0,0 +1,200 @@
+/**
+ * Tree of Domain Names
+ *
+ * Copyright (c) 2014 Michal Nezerka
+ * All rights reserved.
+ *
+ * Developed by: Michal Nezerka
+ *               https://github.com/mnezerka/
+ *               mailto:michal.nezerka@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal with the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimers.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimers in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Michal Nezerka, nor the names of its contributors
+ *    may be used to endorse or promote products derived from this Software
+ *    without specific prior written permission. 
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ */
+
+#ifndef _DNS_LABELTREE_H
+#define	_DNS_LABELTREE_H
+
+#include <vector>
+
+#include "dns.h"
+
+namespace dns {
+
+/**
+ * Tree of domain names keyed by labels
+ *
+ * Each node represents one name and its children are names with one more
+ * label on the left, so path from root to node reads labels of name in
+ * reversed order (top level label first). Labels are stored lower cased in one
+ * byte pool shared by all nodes and child is found by one probe of open
+ * addressing table, so name is located in time proportional to its length.
+ * Nodes are kept in vector and referred by indexes (root has index 0), so
+ * indexes stay valid when tree grows.
+ */
+template<class T>
+class LabelTree
+{
+    public:
+        LabelTree() { clear(); }
+
+        // remove all nodes except root
+        void clear();
+
+        // number of nodes (including root)
+        uint getSize() const { return mNodes.size(); }
+
+        T& operator[](const uint node) { return mNodes[node].value; }
+        const T& operator[](const uint node) const { return mNodes[node].value; }
+
+        // parent of node (root is parent of itself)
+        uint getParent(const uint node) const { return mNodes[node].parent; }
+
+        // label of node (length octet followed by lower cased characters, valid until tree grows)
+        const char* getLabel(const uint node) const { return mLabels.data() + mNodes[node].label; }
+
+        // labels of all nodes stored one after another in order of nodes
+        const char* getLabels() const { return mLabels.data(); }
+        uint getLabelsSize() const { return mLabels.size(); }
+
+        // Find child of node (label is compared case-insensitively)
+        // @param label - length octet followed by characters
+        // @return index of child or 0 if it doesn't exist (root is never a child)
+        uint findChild(const uint parent, const char* label) const;
+
+        // Get child of node, it is created if it doesn't exist
+        uint addChild(const uint parent, const char* label);
+
+    private:
+        struct Node
+        {
+            // offset of label in mLabels
+            uint label;
+            uint parent;
+            T value;
+        };
+
+        std::vector<Node> mNodes;
+        std::vector<char> mLabels;
+        // open addressing table of children (index of node, 0 is free slot), at most half full
+        std::vector<uint> mSlots;
+        uint mSlotMask;
+
+        static uint childHash(const uint parent, const char* label);
+
+        // double size of table of children
+        void grow();
+};
+
+template<class T>
+void LabelTree<T>::clear()
+{
+    mNodes.clear();
+    mNodes.push_back(Node());
+    mNodes[0].label = 0;
+    mNodes[0].parent = 0;
+    mLabels.assign(1, 0);
+    mSlots.assign(16, 0);
+    mSlotMask = 15;
+}
+
+template<class T>
+uint LabelTree<T>::findChild(const uint parent, const char* label) const
+{
+    uint len = static_cast<uchar>(label[0]) + 1;
+    for (uint slot = childHash(parent, label) & mSlotMask; mSlots[slot] != 0; slot = (slot + 1) & mSlotMask)
+    {
+        const Node &node = mNodes[mSlots[slot]];
+        if (node.parent != parent)
+            continue;
+        const char* childLabel = mLabels.data() + node.label;
+        uint i = 0;
+        while (i < len && childLabel[i] == static_cast<char>(lowerChar(label[i])))
+            i++;
+        if (i == len)
+            return mSlots[slot];
+    }
+
+    return 0;
+}
+
+template<class T>
+uint LabelTree<T>::addChild(const uint parent, const char* label)
+{
+    uint child = findChild(parent, label);
+    if (child != 0)
+        return child;
+
+    child = mNodes.size();
+    mNodes.push_back(Node());
+    Node &node = mNodes.back();
+    node.label = mLabels.size();
+    node.parent = parent;
+    mLabels.push_back(label[0]);
+    for (uint i = 1; i <= static_cast<uchar>(label[0]); i++)
+        mLabels.push_back(lowerChar(label[i]));
+
+    if (mNodes.size() * 2 > mSlots.size())
+        grow();
+    else
+    {
+        uint slot = childHash(parent, label) & mSlotMask;
+        while (mSlots[slot] != 0)
+            slot = (slot + 1) & mSlotMask;
+        mSlots[slot] = child;
+    }
+
+    return child;
+}
+
+template<class T>
+void LabelTree<T>::grow()
+{
+    mSlots.assign(mSlots.size() * 2, 0);
+    mSlotMask = mSlots.size() - 1;
+    for (uint child = 1; child < mNodes.size(); child++)
+    {
+        uint slot = childHash(mNodes[child].parent, getLabel(child)) & mSlotMask;
+        while (mSlots[slot] != 0)
+            slot = (slot + 1) & mSlotMask;
+        mSlots[slot] = child;
+    }
+}
+
+template<class T>
+uint LabelTree<T>::childHash(const uint parent, const char* label)
+{
+    // FNV-1a of lower cased label (including length octet) mixed with parent
+    uint h = 2166136261u;
+    uint len = static_cast<uchar>(label[0]) + 1;
+    for (uint i = 0; i < len; i++)
+        h = (h ^ lowerChar(label[i])) * 16777619u;
+
+    return h ^ (parent * 2654435761u);
+}
+
+} // namespace
+#endif	/* _DNS_LABELTREE_H */
@@ -0,0 +1,1017 @@
+/**
+ * DNS Master File Parser
+ *
+ * Copyright (c) 2014 Michal Nezerka
+ * All rights reserved.
+ *
+ * Developed by: Michal Nezerka
+ *               https://github.com/mnezerka/
+ *               mailto:michal.nezerka@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal with the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimers.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimers in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Michal Nezerka, nor the names of its contributors
+ *    may be used to endorse or promote products derived from this Software
+ *    without specific prior written permission. 
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ */
+
+#include <cstring>
+#include <cctype>
+#include <charconv>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <deque>
+#include <strings.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+
+#include "master.h"
+#include "exception.h"
+
+using namespace dns;
+using namespace std;
+
+namespace {
+
+// nesting of $INCLUDE directives
+const uint MAX_INCLUDE_DEPTH = 16;
+
+// TTL which is not known yet (TTLs are limited to 31 bits)
+const uint UNKNOWN_TTL = 0xFFFFFFFF;
+
+struct TypeName
+{
+    const char* name;
+    uint type;
+};
+
+const TypeName typeNames[] = {
+    { "A", RDATA_A }, { "NS", RDATA_NS }, { "MD", RDATA_MD }, { "MF", RDATA_MF },
+    { "CNAME", RDATA_CNAME }, { "SOA", RDATA_SOA }, { "MB", RDATA_MB }, { "MG", RDATA_MG },
+    { "MR", RDATA_MR }, { "NULL", RDATA_NULL }, { "WKS", RDATA_WKS }, { "PTR", RDATA_PTR },
+    { "HINFO", RDATA_HINFO }, { "MINFO", RDATA_MINFO }, { "MX", RDATA_MX }, { "TXT", RDATA_TXT },
+    { "AAAA", RDATA_AAAA }, { "SRV", RDATA_SRV }, { "NAPTR", RDATA_NAPTR }, { "A6", RDATA_A6 }
+};
+
+const TypeName classNames[] = {
+    { "IN", CLASS_IN }, { "CS", CLASS_CS }, { "CH", CLASS_CH }, { "HS", CLASS_HS }
+};
+
+/**
+ * Master file mapped to memory
+ */
+class MappedFile
+{
+    public:
+        MappedFile(const string& fileName);
+        ~MappedFile();
+
+        const char* getData() const { return mData; }
+        size_t getSize() const { return mSize; }
+
+    private:
+        const char* mData;
+        size_t mSize;
+
+        MappedFile(const MappedFile&);
+        MappedFile& operator=(const MappedFile&);
+};
+
+MappedFile::MappedFile(const string& fileName) : mData(NULL), mSize(0)
+{
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd == -1)
+        throw(Exception("Can't open master file '" + fileName + "': " + strerror(errno)));
+
+    struct stat st;
+    if (fstat(fd, &st) == -1)
+    {
+        close(fd);
+        throw(Exception("Can't read master file '" + fileName + "': " + strerror(errno)));
+    }
+
+    mSize = st.st_size;
+    if (mSize > 0)
+    {
+        void *data = mmap(NULL, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            close(fd);
+            throw(Exception("Can't map master file '" + fileName + "': " + strerror(errno)));
+        }
+        madvise(data, mSize, MADV_SEQUENTIAL);
+        mData = static_cast<const char*>(data);
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (mData != NULL)
+        munmap(const_cast<char*>(mData), mSize);
+}
+
+struct Token
+{
+    const char* data;
+    uint size;
+    bool quoted;
+
+    bool is(const char* text) const { return !quoted && size == strlen(text) && strncasecmp(data, text, size) == 0; }
+    string asString() const { return string(data, size); }
+};
+
+/**
+ * Splitter of master file text to tokens of entries
+ *
+ * Entry ends at the end of line which is not inside of parentheses. Quoted
+ * strings are returned without quotes, escapes are kept in tokens.
+ */
+class Lexer
+{
+    public:
+        Lexer(const char* data, const char* end, const uint line) : mPos(data), mEnd(end), mLine(line), mEntryLine(line), mDepth(0), mEntryEnd(false) { }
+
+        // Find the first token of next entry (blank lines and comments are skipped)
+        // @param ownerOmitted - entry starts with blank (owner of previous entry is used)
+        // @return false at the end of data
+        bool startEntry(Token& token, bool& ownerOmitted);
+
+        // Get next token of entry
+        // @return false at the end of entry
+        bool next(Token& token);
+
+        // Get next token which must exist
+        Token need();
+
+        // Check that there is no token left in entry
+        void finish();
+
+        // line where current entry starts
+        uint getEntryLine() const { return mEntryLine; }
+
+    private:
+        const char* mPos;
+        const char* mEnd;
+        uint mLine;
+        uint mEntryLine;
+        // nesting of parentheses
+        uint mDepth;
+        // end of current entry was reached
+        bool mEntryEnd;
+};
+
+bool Lexer::startEntry(Token& token, bool& ownerOmitted)
+{
+    while (mPos < mEnd)
+    {
+        ownerOmitted = *mPos == ' ' || *mPos == '\t';
+        mEntryLine = mLine;
+        mEntryEnd = false;
+        if (next(token))
+            return true;
+    }
+
+    return false;
+}
+
+bool Lexer::next(Token& token)
+{
+    if (mEntryEnd)
+        return false;
+
+    while (mPos < mEnd)
+    {
+        char c = *mPos;
+        switch (c)
+        {
+            case ' ':
+            case '\t':
+            case '\r':
+                mPos++;
+                continue;
+            case ';':
+            {
+                const char* eol = static_cast<const char*>(memchr(mPos, '\n', mEnd - mPos));
+                mPos = eol != NULL ? eol : mEnd;
+                continue;
+            }
+            case '\n':
+                mPos++;
+                mLine++;
+                if (mDepth == 0)
+                {
+                    mEntryEnd = true;
+                    return false;
+                }
+                continue;
+            case '(':
+                mDepth++;
+                mPos++;
+                continue;
+            case ')':
+                if (mDepth == 0)
+                    throw(Exception("Unbalanced parentheses"));
+                mDepth--;
+                mPos++;
+                continue;
+            case '"':
+            {
+                token.data = ++mPos;
+                token.quoted = true;
+                while (mPos < mEnd && *mPos != '"')
+                {
+                    if (*mPos == '\\' && mPos + 1 < mEnd)
+                        mPos++;
+                    if (*mPos == '\n')
+                        mLine++;
+                    mPos++;
+                }
+                if (mPos == mEnd)
+                    throw(Exception("Missing closing quote"));
+                token.size = mPos - token.data;
+                mPos++;
+                return true;
+            }
+            default:
+            {
+                token.data = mPos;
+                token.quoted = false;
+                while (mPos < mEnd)
+                {
+                    c = *mPos;
+                    if (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == ';' || c == '(' || c == ')' || c == '"')
+                        break;
+                    if (c == '\\' && mPos + 1 < mEnd)
+                        mPos++;
+                    mPos++;
+                }
+                token.size = mPos - token.data;
+                return true;
+            }
+        }
+    }
+
+    if (mDepth > 0)
+        throw(Exception("Unbalanced parentheses"));
+
+    mEntryEnd = true;
+    return false;
+}
+
+Token Lexer::need()
+{
+    Token token;
+    if (!next(token))
+        throw(Exception("Missing RDATA field"));
+
+    return token;
+}
+
+void Lexer::finish()
+{
+    Token token;
+    if (next(token))
+        throw(Exception("Unexpected text '" + token.asString() + "'"));
+}
+
+// parse unsigned decimal number
+uint parseNumber(const Token& token, const uint max)
+{
+    unsigned long value = 0;
+    from_chars_result result = from_chars(token.data, token.data + token.size, value);
+    if (token.size == 0 || result.ec != errc() || result.ptr != token.data + token.size || value > max)
+        throw(Exception("Invalid number '" + token.asString() + "'"));
+
+    return value;
+}
+
+// parse TTL (number of seconds or numbers with units, e.g. 1h30m)
+uint parseTtl(const Token& token)
+{
+    const char* p = token.data;
+    const char* end = token.data + token.size;
+    unsigned long ttl = 0;
+    do
+    {
+        unsigned long value = 0;
+        from_chars_result result = from_chars(p, end, value);
+        if (result.ec != errc())
+            throw(Exception("Invalid TTL '" + token.asString() + "'"));
+        p = result.ptr;
+        if (p < end)
+        {
+            switch (lowerChar(*p++))
+            {
+                case 's': break;
+                case 'm': value *= 60; break;
+                case 'h': value *= 3600; break;
+                case 'd': value *= 86400; break;
+                case 'w': value *= 604800; break;
+                default:
+                    throw(Exception("Invalid TTL '" + token.asString() + "'"));
+            }
+        }
+        ttl += value;
+        if (ttl > 0x7FFFFFFF)
+            throw(Exception("TTL '" + token.asString() + "' is too big"));
+    } while (p < end);
+
+    return ttl;
+}
+
+// parse class mnemonic or generic form CLASSnnn
+// @return false if token is not a class
+bool parseClass(const Token& token, uint& rrClass)
+{
+    if (token.quoted)
+        return false;
+    for (uint i = 0; i < sizeof(classNames) / sizeof(classNames[0]); i++)
+    {
+        if (token.is(classNames[i].name))
+        {
+            rrClass = classNames[i].type;
+            return true;
+        }
+    }
+    if (token.size > 5 && strncasecmp(token.data, "CLASS", 5) == 0)
+    {
+        Token number = { token.data + 5, token.size - 5, false };
+        rrClass = parseNumber(number, 0xFFFF);
+        return true;
+    }
+
+    return false;
+}
+
+// read one character of token, escapes \X and \DDD are decoded
+// @param i - position in token, moved behind character
+// @param escaped - character was escaped (e.g. escaped dot is not label separator)
+uchar readChar(const Token& token, uint& i, bool& escaped)
+{
+    escaped = token.data[i] == '\\' && i + 1 < token.size;
+    if (!escaped)
+        return token.data[i++];
+
+    i++;
+    if (i + 2 < token.size && isdigit(static_cast<uchar>(token.data[i])) && isdigit(static_cast<uchar>(token.data[i + 1])) && isdigit(static_cast<uchar>(token.data[i + 2])))
+    {
+        uint value = (token.data[i] - '0') * 100 + (token.data[i + 1] - '0') * 10 + (token.data[i + 2] - '0');
+        if (value > 255)
+            throw(Exception("Invalid escape in '" + token.asString() + "'"));
+        i += 3;
+        return value;
+    }
+
+    return token.data[i++];
+}
+
+// parse domain name, relative names are completed by origin
+// @param wire - buffer for name in wire format (at least MAX_DOMAIN_LEN bytes)
+// @return length of name in wire format
+uint parseName(const Token& token, const DomainName& origin, char* wire)
+{
+    if (token.is("@"))
+    {
+        memcpy(wire, origin.getWire(), origin.getWireLen());
+        return origin.getWireLen();
+    }
+    if (token.is("."))
+    {
+        wire[0] = 0;
+        return 1;
+    }
+
+    uint pos = 1;
+    uint labelPos = 0;
+    bool absolute = false;
+    uint i = 0;
+    while (i < token.size)
+    {
+        bool escaped;
+        uchar c = readChar(token, i, escaped);
+        if (c == '.' && !escaped)
+        {
+            uint labelLen = pos - labelPos - 1;
+            if (labelLen == 0)
+                throw(Exception("Empty label in name '" + token.asString() + "'"));
+            wire[labelPos] = labelLen;
+            labelPos = pos++;
+            absolute = i == token.size;
+            continue;
+        }
+        if (pos - labelPos > MAX_LABEL_LEN || pos >= MAX_DOMAIN_LEN - 1)
+            throw(Exception("Name '" + token.asString() + "' is too long"));
+        wire[pos++] = c;
+    }
+
+    if (absolute)
+    {
+        wire[labelPos] = 0;
+        return pos;
+    }
+
+    uint labelLen = pos - labelPos - 1;
+    if (labelLen == 0)
+        throw(Exception("Empty label in name '" + token.asString() + "'"));
+    wire[labelPos] = labelLen;
+    if (pos + origin.getWireLen() > MAX_DOMAIN_LEN)
+        throw(Exception("Name '" + token.asString() + "' is too long"));
+    memcpy(wire + pos, origin.getWire(), origin.getWireLen());
+
+    return pos + origin.getWireLen();
+}
+
+void put16bits(vector<char>& out, const uint value)
+{
+    out.push_back((value >> 8) & 0xFF);
+    out.push_back(value & 0xFF);
+}
+
+void put32bits(vector<char>& out, const uint value)
+{
+    out.push_back((value >> 24) & 0xFF);
+    out.push_back((value >> 16) & 0xFF);
+    out.push_back((value >> 8) & 0xFF);
+    out.push_back(value & 0xFF);
+}
+
+void putName(vector<char>& out, const Token& token, const DomainName& origin)
+{
+    char wire[MAX_DOMAIN_LEN];
+    uint len = parseName(token, origin, wire);
+    out.insert(out.end(), wire, wire + len);
+}
+
+// write <character-string>
+void putString(vector<char>& out, const Token& token)
+{
+    size_t lenPos = out.size();
+    out.push_back(0);
+    uint i = 0;
+    while (i < token.size)
+    {
+        bool escaped;
+        out.push_back(readChar(token, i, escaped));
+    }
+    uint len = out.size() - lenPos - 1;
+    if (len > 255)
+        throw(Exception("Character string is longer than 255 characters"));
+    out[lenPos] = len;
+}
+
+void putAddress(vector<char>& out, const Token& token, const int family)
+{
+    char text[64];
+    uchar addr[16];
+    if (token.size >= sizeof(text))
+        throw(Exception("Invalid address '" + token.asString() + "'"));
+    memcpy(text, token.data, token.size);
+    text[token.size] = 0;
+    if (inet_pton(family, text, addr) != 1)
+        throw(Exception("Invalid address '" + token.asString() + "'"));
+    out.insert(out.end(), addr, addr + (family == AF_INET ? 4 : 16));
+}
+
+int hexValue(const char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (lowerChar(c) >= 'a' && lowerChar(c) <= 'f')
+        return lowerChar(c) - 'a' + 10;
+
+    return -1;
+}
+
+// RDATA in generic form (RFC 3597): \# length hex
+void putGenericRData(vector<char>& out, Lexer& lexer)
+{
+    uint length = parseNumber(lexer.need(), 0xFFFF);
+    size_t start = out.size();
+    int high = -1;
+    Token token;
+    while (lexer.next(token))
+    {
+        for (uint i = 0; i < token.size; i++)
+        {
+            int value = hexValue(token.data[i]);
+            if (value < 0)
+                throw(Exception("Invalid hex data '" + token.asString() + "'"));
+            if (high < 0)
+                high = value;
+            else
+            {
+                out.push_back((high << 4) | value);
+                high = -1;
+            }
+        }
+    }
+    if (high >= 0 || out.size() - start != length)
+        throw(Exception("Length of generic RDATA doesn't match its data"));
+}
+
+// WKS: address, protocol and services given by port numbers (RFC 1035, section 3.4.2)
+void putWks(vector<char>& out, const Token& address, Lexer& lexer)
+{
+    putAddress(out, address, AF_INET);
+    Token protocol = lexer.need();
+    if (protocol.is("tcp"))
+        out.push_back(6);
+    else if (protocol.is("udp"))
+        out.push_back(17);
+    else
+        out.push_back(parseNumber(protocol, 255));
+
+    size_t bitmap = out.size();
+    Token token;
+    while (lexer.next(token))
+    {
+        uint port = parseNumber(token, 0xFFFF);
+        if (out.size() < bitmap + port / 8 + 1)
+            out.resize(bitmap + port / 8 + 1, 0);
+        out[bitmap + port / 8] |= 0x80 >> (port % 8);
+    }
+}
+
+// parse RDATA of record, the rest of entry is consumed
+void putRData(vector<char>& out, Lexer& lexer, const uint type, const DomainName& origin)
+{
+    Token token = lexer.need();
+    if (token.is("\\#"))
+    {
+        putGenericRData(out, lexer);
+        return;
+    }
+
+    switch (type)
+    {
+        case RDATA_A:
+            putAddress(out, token, AF_INET);
+            break;
+        case RDATA_AAAA:
+            putAddress(out, token, AF_INET6);
+            break;
+        case RDATA_NS:
+        case RDATA_MD:
+        case RDATA_MF:
+        case RDATA_CNAME:
+        case RDATA_MB:
+        case RDATA_MG:
+        case RDATA_MR:
+        case RDATA_PTR:
+            putName(out, token, origin);
+            break;
+        case RDATA_MINFO:
+            putName(out, token, origin);
+            putName(out, lexer.need(), origin);
+            break;
+        case RDATA_SOA:
+            putName(out, token, origin);
+            putName(out, lexer.need(), origin);
+            put32bits(out, parseNumber(lexer.need(), 0xFFFFFFFF));
+            for (uint i = 0; i < 4; i++)
+                put32bits(out, parseTtl(lexer.need()));
+            break;
+        case RDATA_MX:
+            put16bits(out, parseNumber(token, 0xFFFF));
+            putName(out, lexer.need(), origin);
+            break;
+        case RDATA_HINFO:
+            putString(out, token);
+            putString(out, lexer.need());
+            break;
+        case RDATA_TXT:
+            putString(out, token);
+            while (lexer.next(token))
+                putString(out, token);
+            break;
+        case RDATA_WKS:
+            putWks(out, token, lexer);
+            break;
+        case RDATA_SRV:
+            put16bits(out, parseNumber(token, 0xFFFF));
+            put16bits(out, parseNumber(lexer.need(), 0xFFFF));
+            put16bits(out, parseNumber(lexer.need(), 0xFFFF));
+            putName(out, lexer.need(), origin);
+            break;
+        case RDATA_NAPTR:
+            put16bits(out, parseNumber(token, 0xFFFF));
+            put16bits(out, parseNumber(lexer.need(), 0xFFFF));
+            putString(out, lexer.need());
+            putString(out, lexer.need());
+            putString(out, lexer.need());
+            putName(out, lexer.need(), origin);
+            break;
+        default:
+            throw(Exception("RDATA of this type must be written in generic form (\\# length hex)"));
+    }
+    lexer.finish();
+}
+
+// part of master file parsed by one worker
+struct Task
+{
+    const char* data;
+    size_t size;
+    // name of file used in error messages
+    const string* source;
+    // line of the first entry
+    uint line;
+    // $ORIGIN and $TTL at start of task (UNKNOWN_TTL if $TTL wasn't used yet)
+    DomainName origin;
+    uint defaultTtl;
+
+    // parsed records
+    vector<char> records;
+    size_t count;
+    // positions of TTLs of records which inherit TTL of previous task
+    vector<size_t> pendingTtls;
+    uint pendingLine;
+    // the last explicit TTL (UNKNOWN_TTL if task has no record with TTL)
+    uint lastTtl;
+    // error found in task
+    string error;
+
+    Task(const char* taskData, const string* taskSource, const uint taskLine, const DomainName& taskOrigin, const uint taskTtl)
+        : data(taskData), size(0), source(taskSource), line(taskLine), origin(taskOrigin), defaultTtl(taskTtl),
+          count(0), pendingLine(0), lastTtl(UNKNOWN_TTL) { }
+};
+
+/**
+ * Splitter of master files to tasks
+ *
+ * Entries are skipped by one pass which tracks lines, parentheses, quotes and
+ * comments. Task is closed at line starting with owner when it is big enough.
+ * Directives $ORIGIN and $TTL are evaluated to know state at start of each
+ * task, included files are split to their own tasks.
+ */
+class Splitter
+{
+    public:
+        Splitter(const size_t chunkSize) : mChunkSize(chunkSize) { }
+
+        // split text of file to tasks
+        void split(const char* data, const size_t size, const string& source, const string& directory, const DomainName& origin, const uint defaultTtl, const uint depth);
+
+        vector<unique_ptr<Task> >& getTasks() { return mTasks; }
+
+    private:
+        size_t mChunkSize;
+        vector<unique_ptr<Task> > mTasks;
+        // included files (mapped until tasks are parsed)
+        vector<unique_ptr<MappedFile> > mFiles;
+        // names of files (referred by tasks)
+        deque<string> mSources;
+
+        void closeTask(const char* end) { mTasks.back()->size = end - mTasks.back()->data; }
+};
+
+void Splitter::split(const char* data, const size_t size, const string& source, const string& directory, const DomainName& origin, const uint defaultTtl, const uint depth)
+{
+    mSources.push_back(source);
+    const string* name = &mSources.back();
+    DomainName currentOrigin = origin;
+    uint currentTtl = defaultTtl;
+
+    const char* p = data;
+    const char* end = data + size;
+    uint line = 1;
+    mTasks.push_back(unique_ptr<Task>(new Task(p, name, line, currentOrigin, currentTtl)));
+    while (p < end)
+    {
+        // directives are single line entries
+        if (*p == '$')
+        {
+            const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+            eol = eol != NULL ? eol + 1 : end;
+            try
+            {
+                Lexer lexer(p, eol, line);
+                Token directive;
+                lexer.next(directive);
+                if (directive.is("$ORIGIN"))
+                {
+                    char wire[MAX_DOMAIN_LEN];
+                    parseName(lexer.need(), currentOrigin, wire);
+                    currentOrigin.fromWire(wire);
+                    lexer.finish();
+                }
+                else if (directive.is("$TTL"))
+                {
+                    currentTtl = parseTtl(lexer.need());
+                    lexer.finish();
+                }
+                else if (directive.is("$INCLUDE"))
+                {
+                    Token file = lexer.need();
+                    DomainName includeOrigin = currentOrigin;
+                    Token token;
+                    if (lexer.next(token))
+                    {
+                        char wire[MAX_DOMAIN_LEN];
+                        parseName(token, currentOrigin, wire);
+                        includeOrigin.fromWire(wire);
+                        lexer.finish();
+                    }
+                    if (depth >= MAX_INCLUDE_DEPTH)
+                        throw(Exception("Too many nested $INCLUDE directives"));
+
+                    // relative paths are relative to directory of including file
+                    string fileName = file.asString();
+                    if (fileName[0] != '/')
+                        fileName = directory + fileName;
+                    mFiles.push_back(unique_ptr<MappedFile>(new MappedFile(fileName)));
+                    const MappedFile &included = *mFiles.back();
+
+                    closeTask(p);
+                    size_t slash = fileName.rfind('/');
+                    split(included.getData(), included.getSize(), fileName, slash != string::npos ? fileName.substr(0, slash + 1) : "", includeOrigin, currentTtl, depth + 1);
+                    mTasks.push_back(unique_ptr<Task>(new Task(eol, name, line + 1, currentOrigin, currentTtl)));
+                }
+                else
+                    throw(Exception("Unknown directive '" + directive.asString() + "'"));
+            }
+            catch (Exception &e)
+            {
+                throw(Exception(source + ":" + to_string(line) + ": " + e.what()));
+            }
+            p = eol;
+            line++;
+            continue;
+        }
+
+        // task is closed in front of entry with owner
+        if (*p != ' ' && *p != '\t' && *p != '\n' && *p != '\r' && *p != ';' && static_cast<size_t>(p - mTasks.back()->data) >= mChunkSize)
+        {
+            closeTask(p);
+            mTasks.push_back(unique_ptr<Task>(new Task(p, name, line, currentOrigin, currentTtl)));
+        }
+
+        // skip entry (errors are reported by parser of task)
+        uint parentheses = 0;
+        while (p < end)
+        {
+            char c = *p++;
+            if (c == '\n')
+            {
+                line++;
+                if (parentheses == 0)
+                    break;
+            }
+            else if (c == '"')
+            {
+                while (p < end && *p != '"')
+                {
+                    if (*p == '\\')
+                        p++;
+                    else if (*p == '\n')
+                        line++;
+                    p++;
+                }
+                p++;
+            }
+            else if (c == ';')
+            {
+                const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+                p = eol != NULL ? eol : end;
+            }
+            else if (c == '\\')
+                p++;
+            else if (c == '(')
+                parentheses++;
+            else if (c == ')' && parentheses > 0)
+                parentheses--;
+        }
+    }
+    closeTask(p < end ? p : end);
+}
+
+// parse records of task to wire format
+void parseTask(Task& task, const uint rrClass)
+{
+    Lexer lexer(task.data, task.data + task.size, task.line);
+    DomainName origin = task.origin;
+    uint defaultTtl = task.defaultTtl;
+    char owner[MAX_DOMAIN_LEN];
+    uint ownerLen = 0;
+    vector<char>& out = task.records;
+    out.reserve(task.size);
+
+    try
+    {
+        Token token;
+        bool ownerOmitted;
+        while (lexer.startEntry(token, ownerOmitted))
+        {
+            if (!ownerOmitted && !token.quoted && token.data[0] == '$')
+            {
+                // $INCLUDE is resolved by splitter
+                if (token.is("$ORIGIN"))
+                {
+                    char wire[MAX_DOMAIN_LEN];
+                    parseName(lexer.need(), origin, wire);
+                    origin.fromWire(wire);
+                }
+                else if (token.is("$TTL"))
+                    defaultTtl = parseTtl(lexer.need());
+                lexer.finish();
+                continue;
+            }
+
+            if (!ownerOmitted)
+            {
+                ownerLen = parseName(token, origin, owner);
+                if (!lexer.next(token))
+                    throw(Exception("Missing type of record"));
+            }
+            else if (ownerLen == 0)
+                throw(Exception("Missing owner of record"));
+
+            // TTL and class could be in any order
+            uint ttl = UNKNOWN_TTL;
+            bool classFound = false;
+            for (;;)
+            {
+                uint entryClass;
+                if (ttl == UNKNOWN_TTL && !token.quoted && token.size > 0 && isdigit(static_cast<uchar>(token.data[0])))
+                    ttl = parseTtl(token);
+                else if (!classFound && parseClass(token, entryClass))
+                {
+                    if (entryClass != rrClass)
+                        throw(Exception("Class of record differs from class of zone"));
+                    classFound = true;
+                }
+                else
+                    break;
+                if (!lexer.next(token))
+                    throw(Exception("Missing type of record"));
+            }
+            if (token.quoted)
+                throw(Exception("Missing type of record"));
+            uint type = parseType(token.data, token.size);
+
+            out.insert(out.end(), owner, owner + ownerLen);
+            put16bits(out, type);
+            put16bits(out, rrClass);
+            if (ttl != UNKNOWN_TTL)
+                task.lastTtl = ttl;
+            else if (defaultTtl != UNKNOWN_TTL)
+                ttl = defaultTtl;
+            else if (task.lastTtl != UNKNOWN_TTL)
+                ttl = task.lastTtl;
+            else
+            {
+                // TTL of the last record of previous task is set later
+                if (task.pendingTtls.empty())
+                    task.pendingLine = lexer.getEntryLine();
+                task.pendingTtls.push_back(out.size());
+                ttl = 0;
+            }
+            put32bits(out, ttl);
+
+            size_t rdataPos = out.size() + 2;
+            put16bits(out, 0);
+            putRData(out, lexer, type, origin);
+            size_t rdataSize = out.size() - rdataPos;
+            if (rdataSize > 0xFFFF)
+                throw(Exception("RDATA is too long"));
+            out[rdataPos - 2] = (rdataSize >> 8) & 0xFF;
+            out[rdataPos - 1] = rdataSize & 0xFF;
+            task.count++;
+        }
+    }
+    catch (exception &e)
+    {
+        task.error = *task.source + ":" + to_string(lexer.getEntryLine()) + ": " + e.what();
+    }
+}
+
+} // namespace
+
+uint dns::parseType(const char* text, const uint len)
+{
+    Token token = { text, len, false };
+    for (uint i = 0; i < sizeof(typeNames) / sizeof(typeNames[0]); i++)
+        if (token.is(typeNames[i].name))
+            return typeNames[i].type;
+
+    if (len > 4 && strncasecmp(text, "TYPE", 4) == 0)
+    {
+        Token number = { text + 4, len - 4, false };
+        return parseNumber(number, 0xFFFF);
+    }
+
+    throw(Exception("Unknown type '" + token.asString() + "'"));
+}
+
+void dns::parseRData(const uint type, const char* text, const size_t size, const DomainName& origin, vector<char>& rdata)
+{
+    rdata.clear();
+    Lexer lexer(text, text + size, 1);
+    putRData(rdata, lexer, type, origin);
+}
+
+/////////// MasterFile ///////////
+
+MasterFile::MasterFile(const DomainName& origin, const uint defaultTtl, const uint rrClass)
+    : mOrigin(origin), mDefaultTtl(defaultTtl), mClass(rrClass), mChunkSize(1 << 20)
+{
+    mThreads = thread::hardware_concurrency();
+    if (mThreads == 0)
+        mThreads = 1;
+}
+
+void MasterFile::load(const string& fileName)
+{
+    MappedFile file(fileName);
+    size_t slash = fileName.rfind('/');
+    parseFile(file.getData(), file.getSize(), fileName, slash != string::npos ? fileName.substr(0, slash + 1) : "");
+}
+
+void MasterFile::parse(const char* data, const size_t size, const string& source)
+{
+    parseFile(data, size, source, "");
+}
+
+size_t MasterFile::getRecordCount() const
+{
+    size_t count = 0;
+    for (vector<Chunk>::const_iterator it = mChunks.begin(); it != mChunks.end(); ++it)
+        count += it->count;
+
+    return count;
+}
+
+void MasterFile::parseFile(const char* data, const size_t size, const string& source, const string& directory)
+{
+    Splitter splitter(mChunkSize);
+    splitter.split(data, size, source, directory, mOrigin, UNKNOWN_TTL, 0);
+    vector<unique_ptr<Task> >& tasks = splitter.getTasks();
+
+    // tasks are taken by workers in order, the first worker runs in this thread
+    atomic<size_t> nextTask(0);
+    uint rrClass = mClass;
+    auto work = [&tasks, &nextTask, rrClass]() {
+        for (size_t i = nextTask++; i < tasks.size(); i = nextTask++)
+            parseTask(*tasks[i], rrClass);
+    };
+    vector<thread> workers;
+    for (uint i = 1; i < mThreads && i < tasks.size(); i++)
+        workers.push_back(thread(work));
+    work();
+    for (vector<thread>::iterator it = workers.begin(); it != workers.end(); ++it)
+        it->join();
+
+    // records without TTL take TTL of the last record with TTL
+    uint lastTtl = mDefaultTtl > 0 ? mDefaultTtl : UNKNOWN_TTL;
+    for (vector<unique_ptr<Task> >::iterator it = tasks.begin(); it != tasks.end(); ++it)
+    {
+        Task &task = **it;
+        if (!task.error.empty())
+            throw(Exception(task.error));
+        if (!task.pendingTtls.empty() && lastTtl == UNKNOWN_TTL)
+            throw(Exception(*task.source + ":" + to_string(task.pendingLine) + ": Missing TTL of record"));
+        for (vector<size_t>::iterator pos = task.pendingTtls.begin(); pos != task.pendingTtls.end(); ++pos)
+        {
+            task.records[*pos] = (lastTtl >> 24) & 0xFF;
+            task.records[*pos + 1] = (lastTtl >> 16) & 0xFF;
+            task.records[*pos + 2] = (lastTtl >> 8) & 0xFF;
+            task.records[*pos + 3] = lastTtl & 0xFF;
+        }
+        if (task.lastTtl != UNKNOWN_TTL)
+            lastTtl = task.lastTtl;
+    }
+
+    for (vector<unique_ptr<Task> >::iterator it = tasks.begin(); it != tasks.end(); ++it)
+    {
+        if ((*it)->count == 0)
+            continue;
+        mChunks.push_back(Chunk());
+        mChunks.back().records.swap((*it)->records);
+        mChunks.back().count = (*it)->count;
+    }
+}
@@ -0,0 +1,164 @@
+/**
+ * DNS Master File Parser
+ *
+ * Copyright (c) 2014 Michal Nezerka
+ * All rights reserved.
+ *
+ * Developed by: Michal Nezerka
+ *               https://github.com/mnezerka/
+ *               mailto:michal.nezerka@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal with the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimers.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimers in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Michal Nezerka, nor the names of its contributors
+ *    may be used to endorse or promote products derived from this Software
+ *    without specific prior written permission. 
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ */
+
+#ifndef _DNS_MASTER_H
+#define	_DNS_MASTER_H
+
+#include <string>
+#include <vector>
+
+#include "dns.h"
+#include "name.h"
+
+namespace dns {
+
+// Get record type by mnemonic or generic form TYPEnnn (exception is thrown if type is unknown)
+uint parseType(const char* text, const uint len);
+
+// Parse RDATA of one record written in master file syntax (all types of rr.h,
+// generic form "\# length hex" for any type) to wire format without compression
+// @param origin - origin of relative names
+// @param rdata - encoded RDATA (exception is thrown if text is not valid RDATA)
+void parseRData(const uint type, const char* text, const size_t size, const DomainName& origin, std::vector<char>& rdata);
+
+/**
+ * Record of master file in wire format
+ *
+ * Owner is not compressed and names inside of RDATA are not compressed
+ * either, so RDATA could be copied to any message as it is.
+ */
+struct MasterRecord
+{
+    // owner in wire format
+    const char* owner;
+    uint type;
+    uint rrClass;
+    uint ttl;
+    const char* rdata;
+    uint rdataSize;
+};
+
+/**
+ * Parser of master files (RFC 1035, section 5)
+ *
+ * Records of all types defined in rr.h are parsed from presentation format,
+ * other types could be written in generic form (RFC 3597). Directives $ORIGIN,
+ * $TTL (RFC 2308) and $INCLUDE, parentheses, comments, quoted strings and
+ * escapes (\X, \DDD) are supported. TTLs could use units (1h30m). Services of
+ * WKS records are given by port numbers. All records must be of the same class.
+ *
+ * Files are mapped to memory and split to chunks at starts of records (one
+ * sequential scan tracks lines, parentheses, quotes and directives), chunks
+ * are parsed by worker threads to wire format. Records are kept in chunks
+ * in order of the file.
+ *
+ *     MasterFile file("example.com");
+ *     file.load("example.com.zone");
+ *     file.forEach([&](const MasterRecord& rr) { ... });
+ */
+class MasterFile
+{
+    public:
+        // @param origin - initial origin (names are relative to it until $ORIGIN is used)
+        // @param defaultTtl - TTL of records without TTL before $TTL or the first explicit TTL (0 - such records are rejected)
+        MasterFile(const DomainName& origin, const uint defaultTtl = 0, const uint rrClass = CLASS_IN);
+
+        // Set number of worker threads (default is number of CPUs)
+        void setThreads(const uint threads) { mThreads = threads > 0 ? threads : 1; }
+
+        // Set size of chunks parsed by workers
+        void setChunkSize(const uint chunkSize) { mChunkSize = chunkSize; }
+
+        // Parse master file (records of previous files are kept)
+        // exception with file name and line is thrown if file is not valid
+        void load(const std::string& fileName);
+
+        // Parse master file stored in memory ($INCLUDE paths are relative to working directory)
+        void parse(const char* data, const size_t size, const std::string& source = "<text>");
+
+        // number of parsed records
+        size_t getRecordCount() const;
+
+        // Call function for each record (in order of master file)
+        template<class F>
+        void forEach(F function) const;
+
+    private:
+        // records of chunk in wire format (owner, type, class, TTL, RDLENGTH, RDATA)
+        struct Chunk
+        {
+            std::vector<char> records;
+            size_t count;
+        };
+
+        DomainName mOrigin;
+        uint mDefaultTtl;
+        uint mClass;
+        uint mThreads;
+        uint mChunkSize;
+        std::vector<Chunk> mChunks;
+
+        void parseFile(const char* data, const size_t size, const std::string& source, const std::string& directory);
+};
+
+template<class F>
+void MasterFile::forEach(F function) const
+{
+    for (std::vector<Chunk>::const_iterator chunk = mChunks.begin(); chunk != mChunks.end(); ++chunk)
+    {
+        const char* p = chunk->records.data();
+        const char* end = p + chunk->records.size();
+        while (p < end)
+        {
+            MasterRecord rr;
+            rr.owner = p;
+            while (*p != 0)
+                p += static_cast<uchar>(*p) + 1;
+            const uchar* fields = reinterpret_cast<const uchar*>(p + 1);
+            rr.type = (fields[0] << 8) | fields[1];
+            rr.rrClass = (fields[2] << 8) | fields[3];
+            rr.ttl = (static_cast<uint>(fields[4]) << 24) | (fields[5] << 16) | (fields[6] << 8) | fields[7];
+            rr.rdataSize = (fields[8] << 8) | fields[9];
+            rr.rdata = p + 11;
+            p = rr.rdata + rr.rdataSize;
+            function(rr);
+        }
+    }
+}
+
+} // namespace
+#endif	/* _DNS_MASTER_H */
@@ -56,37 +56,119 @@ Message::~Message()
     removeAllRecords();
 }
 
+Message::Message(Message&& other) : Message()
+{
+    swap(other);
+}
+
+Message& Message::operator=(Message&& other)
+{
+    // previous content is released together with tmp
+    Message tmp(std::move(other));
+    swap(tmp);
+    return *this;
+}
+
+void Message::swap(Message& other)
+{
+    std::swap(mId, other.mId);
+    std::swap(mQr, other.mQr);
+    std::swap(mOpCode, other.mOpCode);
+    std::swap(mAA, other.mAA);
+    std::swap(mTC, other.mTC);
+    std::swap(mRD, other.mRD);
+    std::swap(mRA, other.mRA);
+    std::swap(mRCode, other.mRCode);
+    mQueries.swap(other.mQueries);
+    mAnswers.swap(other.mAnswers);
+    mAuthorities.swap(other.mAuthorities);
+    mAdditional.swap(other.mAdditional);
+    std::swap(mArena, other.mArena);
+    std::swap(mLazyRData, other.mLazyRData);
+    mFreeQueries.swap(other.mFreeQueries);
+    mFreeRecords.swap(other.mFreeRecords);
+    mFreeRData.swap(other.mFreeRData);
+    std::swap(mEdns, other.mEdns);
+    std::swap(mUdpPayloadSize, other.mUdpPayloadSize);
+    std::swap(mExtRCode, other.mExtRCode);
+    std::swap(mEdnsVersion, other.mEdnsVersion);
+    std::swap(mDO, other.mDO);
+    std::swap(mEdnsOptions, other.mEdnsOptions);
+}
+
 void Message::removeAllRecords()
 {
-    // delete all queries
-    for(std::vector<QuerySection*>::iterator it = mQueries.begin(); it != mQueries.end(); ++it)
-        delete(*it);
+    // records are deleted by their owners
     mQueries.clear();
-
-    // delete answers
-    for(std::vector<ResourceRecord*>::iterator it = mAnswers.begin(); it != mAnswers.end(); ++it)
-        delete(*it);
     mAnswers.clear();
-
-    // delete authorities
-    for(std::vector<ResourceRecord*>::iterator it = mAuthorities.begin(); it != mAuthorities.end(); ++it)
-        delete(*it);
     mAuthorities.clear();
-
-    // delete additional
-    for(std::vector<ResourceRecord*>::iterator it = mAdditional.begin(); it != mAdditional.end(); ++it)
-        delete(*it);
     mAdditional.clear();
+
+    // release memory of all objects allocated from arena at once
+    if (mArena)
+        mArena->reset();
+}
+
+void Message::reset()
+{
+    if (mArena)
+        removeAllRecords();
+    else
+    {
+        for (QueryList::iterator it = mQueries.begin(); it != mQueries.end(); ++it)
+            mFreeQueries.push_back(std::move(*it));
+        mQueries.clear();
+        RecordList* sections[3] = { &mAnswers, &mAuthorities, &mAdditional };
+        for (uint i = 0; i < 3; i++)
+        {
+            for (RecordList::iterator it = sections[i]->begin(); it != sections[i]->end(); ++it)
+                recycleRecord(*it);
+            sections[i]->clear();
+        }
+    }
+
+    mId = 0;
+    mQr = typeQuery;
+    mOpCode = 0;
+    mAA = 0;
+    mTC = 0;
+    mRD = 0;
+    mRA = 0;
+    mRCode = 0;
+    mEdns = false;
+    mUdpPayloadSize = EDNS_UDP_PAYLOAD_SIZE;
+    mExtRCode = 0;
+    mEdnsVersion = 0;
+    mDO = 0;
+    mEdnsOptions.clearOptions();
+}
+
+void Message::recycleRecord(ResourceRecordPtr &rr)
+{
+    RData *rdata = rr->releaseRData();
+    if (rdata)
+        mFreeRData.put(rdata);
+    mFreeRecords.push_back(std::move(rr));
 }
 
 void Message::decode(const char* buffer, const uint bufferSize)
 {
-    if (bufferSize > MAX_MSG_LEN)
-        throw (Exception("Aborting parse of message which exceedes maximal DNS message length."));
+    uint errorOffset;
+    eDecodeError error = decode(buffer, bufferSize, errorOffset);
+    if (error != DECODE_OK)
+        throw (Exception(getDecodeErrorText(error)));
+}
+
+eDecodeError Message::decode(const char* buffer, const uint bufferSize, uint &errorOffset)
+{
+    errorOffset = 0;
+    if (bufferSize > MAX_ENCODED_LEN)
+        return DECODE_MESSAGE_TOO_LONG;
     Buffer buff(const_cast<char*>(buffer), bufferSize);
+    buff.setThrowing(false);
 
-    // 1. delete all items in lists of message records (queries, resource records)
-    removeAllRecords();
+    // 1. remove all items in lists of message records (queries, resource records)
+    reset();
 
     // 2. read header
     mId = buff.get16bits();
@@ -97,84 +179,268 @@ void Message::decode(const char* buffer, const uint bufferSize)
     mTC = (fields >> 9) & 1;
     mRD = (fields >> 8) & 1;
     mRA = (fields >> 7) & 1;
+    mRCode = fields & 15;
     uint qdCount = buff.get16bits();
     uint anCount = buff.get16bits();
     uint nsCount = buff.get16bits();
     uint arCount = buff.get16bits();
 
     // 3. read Question Sections
-    for (uint i = 0; i < qdCount; i++)
+    for (uint i = 0; i < qdCount && buff.getError() == DECODE_OK; i++)
     {
-        std::string qName = buff.getDnsDomainName();
+        DomainName qName;
+        buff.getDnsDomainName(qName);
         uint qType = buff.get16bits();
         eQClass qClass = static_cast<eQClass>(buff.get16bits());
-
-        QuerySection *qs = new QuerySection(qName);
+        if (buff.getError() != DECODE_OK)
+            break;
+
+        QuerySection *qs;
+        if (mFreeQueries.empty())
+            qs = new (mArena) QuerySection(qName);
+        else
+        {
+            qs = mFreeQueries.back().release();
+            mFreeQueries.pop_back();
+            qs->setName(qName);
+        }
         qs->setType(qType);
         qs->setClass(qClass);
-        mQueries.push_back(qs);
+        mQueries.push_back(QuerySectionPtr(qs));
     }
 
     // 4. read Answer Resource Records
-    Message::decodeResourceRecords(buff, anCount, mAnswers);
-    Message::decodeResourceRecords(buff, nsCount, mAuthorities);
-    Message::decodeResourceRecords(buff, arCount, mAdditional);
+    if (buff.getError() == DECODE_OK
+        && decodeResourceRecords(buff, anCount, mAnswers)
+        && decodeResourceRecords(buff, nsCount, mAuthorities)
+        && decodeResourceRecords(buff, arCount, mAdditional))
+    {
+        // 5. check that buffer is consumed
+        if (buff.getPos() != buff.getSize())
+            buff.setError(DECODE_TRAILING_BYTES);
+        // 6. take EDNS0 fields from OPT record
+        else if (!decodeEdns())
+            buff.setError(DECODE_BAD_OPT);
+    }
 
-    // 5. check that buffer is consumed
-    if (buff.getPos() != buff.getSize())
-        throw(Exception("Message buffer not empty after parsing"));
+    errorOffset = buff.getErrorPos();
+    return buff.getError();
 }
 
-void Message::decodeResourceRecords(Buffer &buffer, uint count, std::vector<ResourceRecord*> &list)
+bool Message::decodeResourceRecords(Buffer &buffer, uint count, RecordList &list)
 {
     for (uint i = 0; i < count; i++)
     {
-        ResourceRecord *rr = new ResourceRecord();
-        list.push_back(rr);
-        rr->decode(buffer);
+        if (mFreeRecords.empty())
+            list.push_back(ResourceRecordPtr(new (mArena) ResourceRecord()));
+        else
+        {
+            list.push_back(std::move(mFreeRecords.back()));
+            mFreeRecords.pop_back();
+        }
+        list.back()->decode(buffer, mArena, mLazyRData, &mFreeRData);
+        if (buffer.getError() != DECODE_OK)
+            return false;
     }
+
+    return true;
 }
 
-void Message::encode(char* buffer, const uint bufferSize, uint &validSize)
+bool Message::decodeEdns()
 {
-    validSize = 0;
-    Buffer buff(buffer, bufferSize);
+    for (RecordList::iterator it = mAdditional.begin(); it != mAdditional.end(); )
+    {
+        ResourceRecord *rr = it->get();
+        if (rr->getType() != RDATA_OPT)
+        {
+            ++it;
+            continue;
+        }
+
+        // only one OPT record owned by root domain is allowed
+        if (mEdns || !rr->getName().isRoot())
+            return false;
+
+        mEdns = true;
+        mUdpPayloadSize = rr->getClass();
+        // TTL: | EXTENDED-RCODE (8) | VERSION (8) | DO (1) | Z (15) |
+        mExtRCode = (rr->getTtl() >> 24) & 0xFF;
+        mEdnsVersion = (rr->getTtl() >> 16) & 0xFF;
+        mDO = (rr->getTtl() >> 15) & 1;
+        if (rr->getRData())
+            mEdnsOptions = *static_cast<RDataOPT*>(rr->getRData());
+
+        if (!mArena)
+            recycleRecord(*it);
+        it = mAdditional.erase(it);
+    }
 
-    // encode header
+    return true;
+}
 
+void Message::encodeEdns(Buffer &buff)
+{
+    // owner is root domain
+    buff.put8bits(0);
+    buff.put16bits(RDATA_OPT);
+    buff.put16bits(mUdpPayloadSize);
+    buff.put32bits((mExtRCode << 24) | (mEdnsVersion << 16) | (mDO << 15));
+    buff.put16bits(mEdnsOptions.getSize());
+    mEdnsOptions.encode(buff);
+}
+
+void Message::encodeHeader(Buffer &buff, const uint tc, const uint qdCount, const uint anCount, const uint nsCount, const uint arCount)
+{
     buff.put16bits(mId);
     uint fields = ((mQr & 1) << 15);
     fields += ((mOpCode & 15) << 11);
     fields += ((mAA & 1) << 10);
-    fields += ((mTC & 1) << 9);
+    fields += ((tc & 1) << 9);
     fields += ((mRD & 1) << 8);
     fields += ((mRA & 1) << 7);
     fields += ((mRCode & 15));
     buff.put16bits(fields);
-    buff.put16bits(mQueries.size());
-    buff.put16bits(mAnswers.size());
-    buff.put16bits(mAuthorities.size());
-    buff.put16bits(mAdditional.size());
+    buff.put16bits(qdCount);
+    buff.put16bits(anCount);
+    buff.put16bits(nsCount);
+    buff.put16bits(arCount);
+}
+
+void Message::encode(char* buffer, const uint bufferSize, uint &validSize)
+{
+    validSize = 0;
+    Buffer buff(buffer, bufferSize);
+
+    // encode header
+    encodeHeader(buff, mTC, mQueries.size(), mAnswers.size(), mAuthorities.size(), mAdditional.size() + (mEdns ? 1 : 0));
 
     // encode queries
-    for(std::vector<QuerySection*>::iterator it = mQueries.begin(); it != mQueries.end(); ++it)
+    for(QueryList::iterator it = mQueries.begin(); it != mQueries.end(); ++it)
         (*it)->encode(buff);
 
     // encode answers
-    for(std::vector<ResourceRecord*>::iterator it = mAnswers.begin(); it != mAnswers.end(); ++it)
+    for(RecordList::iterator it = mAnswers.begin(); it != mAnswers.end(); ++it)
         (*it)->encode(buff);
 
     // encode authorities
-    for(std::vector<ResourceRecord*>::iterator it = mAuthorities.begin(); it != mAuthorities.end(); ++it)
+    for(RecordList::iterator it = mAuthorities.begin(); it != mAuthorities.end(); ++it)
         (*it)->encode(buff);
 
     // encode additional
-    for(std::vector<ResourceRecord*>::iterator it = mAdditional.begin(); it != mAdditional.end(); ++it)
+    for(RecordList::iterator it = mAdditional.begin(); it != mAdditional.end(); ++it)
         (*it)->encode(buff);
+    if (mEdns)
+        encodeEdns(buff);
 
     validSize = buff.getPos();
 }
 
+bool Message::encode(std::vector<char>& buffer, const uint maxSize)
+{
+    Buffer buff(buffer, maxSize < MAX_ENCODED_LEN ? maxSize : MAX_ENCODED_LEN);
+    bool truncated = encodeTruncated(buff);
+    buffer.resize(buff.getPos());
+
+    return truncated;
+}
+
+bool Message::encodeTruncated(char* buffer, const uint bufferSize, uint &validSize)
+{
+    Buffer buff(buffer, bufferSize);
+    bool truncated = encodeTruncated(buff);
+    validSize = buff.getPos();
+
+    return truncated;
+}
+
+bool Message::encodeTruncated(Buffer &buff)
+{
+    buff.setThrowing(false);
+
+    // header is written again when counts are known
+    encodeHeader(buff, mTC, 0, 0, 0, 0);
+    if (buff.getError() != DECODE_OK)
+    {
+        // not even header fits, nothing is encoded
+        buff.rewind(0);
+        return true;
+    }
+
+    // space for OPT record is kept, it must be present in truncated message as well
+    if (mEdns)
+        buff.setReserved(getEdnsSize());
+
+    // encode queries, message without complete question section is useless
+    for(QueryList::iterator it = mQueries.begin(); it != mQueries.end(); ++it)
+        (*it)->encode(buff);
+    if (buff.getError() != DECODE_OK)
+    {
+        buff.rewind(0);
+        buff.setReserved(0);
+        encodeHeader(buff, 1, 0, 0, 0, 0);
+        return true;
+    }
+
+    // encode resource records, section is encoded only if previous one is complete
+    uint anCount = encodeRRsets(buff, mAnswers);
+    uint nsCount = anCount == mAnswers.size() ? encodeRRsets(buff, mAuthorities) : 0;
+    uint arCount = nsCount == mAuthorities.size() ? encodeRRsets(buff, mAdditional) : 0;
+    uint tc = mTC;
+    if (anCount < mAnswers.size() || nsCount < mAuthorities.size())
+        tc = 1;
+
+    if (mEdns)
+    {
+        buff.setReserved(0);
+        encodeEdns(buff);
+    }
+
+    // fix header
+    uint size = buff.getPos();
+    buff.setPos(0);
+    encodeHeader(buff, tc, mQueries.size(), anCount, nsCount, arCount + (mEdns ? 1 : 0));
+    buff.setPos(size);
+
+    return anCount < mAnswers.size() || nsCount < mAuthorities.size() || arCount < mAdditional.size();
+}
+
+uint Message::encodeRRsets(Buffer &buff, const RecordList &list)
+{
+    uint count = 0;
+    while (count < list.size())
+    {
+        // find end of RRset
+        const ResourceRecord* first = list[count].get();
+        uint end = count + 1;
+        while (end < list.size()
+            && list[end]->getType() == first->getType()
+            && list[end]->getClass() == first->getClass()
+            && list[end]->getName() == first->getName())
+            end++;
+
+        uint pos = buff.getPos();
+        try
+        {
+            for (uint i = count; i < end; i++)
+                list[i]->encode(buff);
+        }
+        catch (Exception &e)
+        {
+            // RDATA of lazily decoded record is malformed, it is handled as RRset which doesn't fit
+            buff.setError(DECODE_BAD_RDATA_LENGTH);
+        }
+        if (buff.getError() != DECODE_OK)
+        {
+            // drop partially written RRset
+            buff.rewind(pos);
+            break;
+        }
+        count = end;
+    }
+
+    return count;
+}
+
 string Message::asString()
 {
     ostringstream text;
@@ -185,32 +451,34 @@ string Message::asString()
     text << "  ANcount: " << mAnswers.size() << endl;
     text << "  NScount: " << mAuthorities.size() << endl;
     text << "  ARcount: " << mAdditional.size() << endl;
+    if (mEdns)
+        text << "  EDNS: [ version: " << mEdnsVersion << " udp: " << mUdpPayloadSize << " DO: " << mDO << " extRCode: " << mExtRCode << " ] " << mEdnsOptions.asString() << endl;
 
     if (mQueries.size() > 0)
     {
         text << "Queries:" << endl;
-        for(std::vector<QuerySection*>::iterator it = mQueries.begin(); it != mQueries.end(); ++it)
+        for(QueryList::iterator it = mQueries.begin(); it != mQueries.end(); ++it)
             text << "  " << (*it)->asString();
     }
 
     if (mAnswers.size() > 0)
     {
         text << "Answers:" << endl;
-        for(std::vector<ResourceRecord*>::iterator it = mAnswers.begin(); it != mAnswers.end(); ++it)
+        for(RecordList::iterator it = mAnswers.begin(); it != mAnswers.end(); ++it)
             text << "  " << (*it)->asString();
     }
 
     if (mAuthorities.size() > 0)
     {
         text << "Authorities:" << endl;
-        for(std::vector<ResourceRecord*>::iterator it = mAuthorities.begin(); it != mAuthorities.end(); ++it)
+        for(RecordList::iterator it = mAuthorities.begin(); it != mAuthorities.end(); ++it)
             text << "  " << (*it)->asString();
     }
 
     if (mAdditional.size() > 0)
     {
         text << "Additional:" << endl;
-        for(std::vector<ResourceRecord*>::iterator it = mAdditional.begin(); it != mAdditional.end(); ++it)
+        for(RecordList::iterator it = mAdditional.begin(); it != mAdditional.end(); ++it)
             text << "  " << (*it)->asString();
     }
 
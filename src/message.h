@@ -40,14 +40,23 @@
 
 #include <string>
 #include <vector>
+#include <memory>
 
 #include "dns.h"
 #include "rr.h"
 #include "qs.h"
 #include "buffer.h"
+#include "arena.h"
 
 namespace dns {
 
+// Owning pointers to entries of message sections (ArenaObject::operator delete
+// leaves memory of entries allocated from arena to arena reset)
+typedef std::unique_ptr<QuerySection> QuerySectionPtr;
+typedef std::unique_ptr<ResourceRecord> ResourceRecordPtr;
+typedef std::vector<QuerySectionPtr> QueryList;
+typedef std::vector<ResourceRecordPtr> RecordList;
+
 /**
  * Class represents the DNS Message.
  *
@@ -151,23 +160,84 @@ class Message {
         static const uint typeQuery = 0;
         static const uint typeResponse = 1;
 
+        // maximal size of encoded message (limit given by length field of TCP transport)
+        static const uint MAX_ENCODED_LEN = 65535;
+
         // Constructor.
-        Message() : mId(0), mQr(typeQuery), mOpCode(0), mAA(0), mTC(0), mRD(0), mRA(0), mRCode(0) { }
+        Message() : mId(0), mQr(typeQuery), mOpCode(0), mAA(0), mTC(0), mRD(0), mRA(0), mRCode(0), mArena(NULL), mLazyRData(false), mEdns(false), mUdpPayloadSize(EDNS_UDP_PAYLOAD_SIZE), mExtRCode(0), mEdnsVersion(0), mDO(0) { }
 
         // Virtual desctructor
         ~Message();
 
-        // Decode DNS message from buffer
+        // Message is movable (records and arena are handed over without copying),
+        // it can't be copied
+        Message(Message&& other);
+        Message& operator=(Message&& other);
+        Message(const Message&) = delete;
+        Message& operator=(const Message&) = delete;
+
+        // Exchange content (including arena) with other message
+        void swap(Message& other);
+
+        // Decode DNS message from buffer (exception is thrown if message is malformed)
         // @param buffer The buffer to code the message header into.
         // @param size - size of buffer
         void decode(const char* buffer, const uint size);
 
+        // Decode DNS message from buffer without throwing exceptions
+        // @param buffer The buffer to code the message header into.
+        // @param size - size of buffer
+        // @param errorOffset - position in buffer where error was detected
+        // @return DECODE_OK or code of the first detected error
+        eDecodeError decode(const char* buffer, const uint size, uint &errorOffset);
+
+        // Attach arena used for allocation of decoded queries and resource records
+        // (NULL means heap). Arena is reset each time records of message are
+        // removed, it should not be shared with other messages.
+        void setArena(Arena* arena) { removeAllRecords(); mArena = arena; }
+        Arena* getArena() { return mArena; }
+
+        // Reset message to initial state (configuration like arena is kept).
+        // Allocations are kept for reuse - sections keep their capacity and
+        // removed queries, records and rdata are recycled by following decode()
+        // (rdata is reused for records of the same type). If arena is attached,
+        // records are released by reset of arena instead. Called by decode().
+        void reset();
+
+        // Enable lazy decoding of rdata - resource records keep position of rdata
+        // in decoded buffer and rdata is decoded on first access (records which
+        // are only forwarded are encoded by copying of raw data). Decoded buffer
+        // must stay valid as long as records of message are used.
+        void setLazyRData(const bool lazy) { mLazyRData = lazy; }
+        bool getLazyRData() const { return mLazyRData; }
+
         // Function that codes the DNS message
         // @param buffer The buffer to code the message header into.
         // @param size - size of buffer
         // @param validSize - number of bytes that contain encoded message
         void encode(char* buffer, const uint size, uint &validSize);
 
+        // Encode message to growable buffer (it is resized to size of encoded message,
+        // its allocation is reused). If message doesn't fit into maxSize bytes,
+        // resource records are left out by whole RRsets, TC flag is set and
+        // section counts are fixed (see encodeTruncated).
+        // @param buffer - storage for encoded message
+        // @param maxSize - maximal size of encoded message
+        // @return true if message was truncated
+        bool encode(std::vector<char>& buffer, const uint maxSize = MAX_ENCODED_LEN);
+
+        // Encode message to buffer of fixed size without throwing exceptions. Records
+        // are written by whole RRsets (consecutive records with the same name, type
+        // and class), encoding stops at the first RRset which doesn't fit. TC flag is
+        // set if answer or authority records were left out (missing additional records
+        // don't set TC, see RFC 2181). RRsets which can't be encoded (e.g. lazily
+        // decoded RDATA is malformed) are handled as RRsets which don't fit.
+        // @param buffer - buffer for encoded message
+        // @param size - size of buffer
+        // @param validSize - number of bytes that contain encoded message (0 if header doesn't fit)
+        // @return true if message was truncated
+        bool encodeTruncated(char* buffer, const uint size, uint &validSize);
+
         uint getId() const throw() { return mId; }
         void setId(uint id) { mId = id; }
 
@@ -192,19 +262,47 @@ class Message {
         void setRCode(const uint newRCode) { mRCode = newRCode & 15; }
         uint getRCode() { return mRCode; }
 
+        // Extended RCODE (12 bits), upper 8 bits are carried by OPT record
+        void setExtendedRCode(const uint newRCode) { mRCode = newRCode & 15; mExtRCode = (newRCode >> 4) & 0xFF; }
+        uint getExtendedRCode() { return (mExtRCode << 4) | mRCode; }
+
+        // EDNS0 (RFC 6891) - OPT pseudo record is not part of additional records,
+        // it is decoded to following fields and it is encoded as the last
+        // additional record if EDNS0 is enabled
+        void setEdns(const bool edns) { mEdns = edns; }
+        bool hasEdns() { return mEdns; }
+
+        void setUdpPayloadSize(const uint newSize) { mUdpPayloadSize = newSize & 0xFFFF; }
+        uint getUdpPayloadSize() { return mUdpPayloadSize; }
+
+        void setEdnsVersion(const uint newVersion) { mEdnsVersion = newVersion & 0xFF; }
+        uint getEdnsVersion() { return mEdnsVersion; }
+
+        // DNSSEC OK flag
+        void setDO(const uint newDO) { mDO = newDO & 1; }
+        uint getDO() { return mDO; }
+
+        // EDNS0 options
+        RDataOPT& getEdnsOptions() { return mEdnsOptions; }
+
+        // Maximal size of UDP response to this message (advertised UDP payload
+        // size, at least 512 bytes)
+        uint getMaxUdpSize() { return mEdns && mUdpPayloadSize > MAX_MSG_LEN ? mUdpPayloadSize : MAX_MSG_LEN; }
+
         uint getQdCount() { return mQueries.size(); }
         uint getAnCount() { return mAnswers.size(); }
         uint getNsCount() { return mAuthorities.size(); }
         uint getArCount() { return mAdditional.size(); }
 
-        void addQuery(QuerySection* qs) { mQueries.push_back(qs); };
-        std::vector<QuerySection*> getQueries() { return mQueries; };
-        void addAnswer(ResourceRecord* rr) { mAnswers.push_back(rr); };
-        std::vector<ResourceRecord*> getAnswers() { return mAnswers; };
-        void addAuthority(ResourceRecord* rr) { mAuthorities.push_back(rr); };
-        std::vector<ResourceRecord*> getAuthorities() { return mAuthorities; };
-        void addAdditional(ResourceRecord* rr) { mAdditional.push_back(rr); };
-        std::vector<ResourceRecord*> getAdditional() { return mAdditional; };
+        // Sections take ownership of added entries
+        void addQuery(QuerySectionPtr qs) { mQueries.push_back(std::move(qs)); };
+        const QueryList& getQueries() const { return mQueries; };
+        void addAnswer(ResourceRecordPtr rr) { mAnswers.push_back(std::move(rr)); };
+        const RecordList& getAnswers() const { return mAnswers; };
+        void addAuthority(ResourceRecordPtr rr) { mAuthorities.push_back(std::move(rr)); };
+        const RecordList& getAuthorities() const { return mAuthorities; };
+        void addAdditional(ResourceRecordPtr rr) { mAdditional.push_back(std::move(rr)); };
+        const RecordList& getAdditional() const { return mAdditional; };
 
         // Returns the DNS message header as a string text.
         std::string asString();
@@ -221,12 +319,53 @@ class Message {
         uint mRA;
         uint mRCode;
 
-        std::vector<QuerySection*> mQueries;
-        std::vector<ResourceRecord*> mAnswers;
-        std::vector<ResourceRecord*> mAuthorities;
-        std::vector<ResourceRecord*> mAdditional;
+        QueryList mQueries;
+        RecordList mAnswers;
+        RecordList mAuthorities;
+        RecordList mAdditional;
+
+        // arena for decoded objects (optional)
+        Arena* mArena;
+
+        // decode rdata on first access
+        bool mLazyRData;
+
+        // recycled objects (see reset)
+        QueryList mFreeQueries;
+        RecordList mFreeRecords;
+        RDataFreeList mFreeRData;
+
+        // EDNS0 fields (OPT pseudo record)
+        bool mEdns;
+        uint mUdpPayloadSize;
+        uint mExtRCode;
+        uint mEdnsVersion;
+        uint mDO;
+        RDataOPT mEdnsOptions;
+
+        bool decodeResourceRecords(Buffer &buffer, uint count, RecordList &list);
+
+        // move record and its rdata to free lists
+        void recycleRecord(ResourceRecordPtr &rr);
+
+        // move OPT record from additional records to EDNS0 fields
+        bool decodeEdns();
+
+        // encode OPT record
+        void encodeEdns(Buffer &buffer);
+
+        // size of encoded OPT record
+        uint getEdnsSize() { return 11 + mEdnsOptions.getSize(); }
+
+        // encode header with given section counts and TC flag
+        void encodeHeader(Buffer &buffer, const uint tc, const uint qdCount, const uint anCount, const uint nsCount, const uint arCount);
+
+        // encode message to non throwing buffer, records are truncated by RRsets
+        bool encodeTruncated(Buffer &buffer);
 
-        void decodeResourceRecords(Buffer &buffer, uint count, std::vector<ResourceRecord*> &list);
+        // encode whole RRsets of section while they fit into buffer
+        // @return number of encoded records
+        uint encodeRRsets(Buffer &buffer, const RecordList &list);
         void removeAllRecords();
 
 };
@@ -0,0 +1,183 @@
+/**
+ * DNS Domain Name
+ *
+ * Copyright (c) 2014 Michal Nezerka
+ * All rights reserved.
+ *
+ * Developed by: Michal Nezerka
+ *               https://github.com/mnezerka/
+ *               mailto:michal.nezerka@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal with the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimers.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimers in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Michal Nezerka, nor the names of its contributors
+ *    may be used to endorse or promote products derived from this Software
+ *    without specific prior written permission. 
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ */
+
+#include <cstring>
+
+#include "name.h"
+#include "exception.h"
+
+using namespace dns;
+using namespace std;
+
+DomainName::DomainName(const char* text)
+{
+    fromText(text, strlen(text));
+}
+
+void DomainName::fromText(const char* text, const uint textLen)
+{
+    // ignore dot at the end since we do not want to encode
+    // empty label (which will produce one extra 0x00 byte)
+    uint len = textLen;
+    if (len > 0 && text[len - 1] == '.')
+        len--;
+
+    // blue.ims.cz -> |4|b|l|u|e|3|i|m|s|2|c|z|0|
+    // (wire format is two octets longer than text form)
+    if (len + 2 > MAX_DOMAIN_LEN)
+        throw(Exception("Domain name too long to be stored in dns message"));
+
+    uint pos = 0;
+    uint ix = 0;
+    mLabelCount = 0;
+    while (ix < len)
+    {
+        uint labelLenPos = pos++;
+        uint labelLen = 0;
+        while (ix < len && text[ix] != '.')
+        {
+            mData[pos++] = text[ix++];
+            labelLen++;
+        }
+        if (labelLen > MAX_LABEL_LEN)
+            throw(Exception("Encoding failed because of too long domain label (max length is 63 characters)"));
+        if (labelLen == 0)
+            throw(Exception("Encoding failed because of empty domain label"));
+        mData[labelLenPos] = labelLen;
+        mLabelOffsets[mLabelCount++] = labelLenPos;
+        // skip dot
+        ix++;
+    }
+    // terminating zero byte
+    mData[pos++] = 0;
+    mLen = pos;
+}
+
+void DomainName::fromWire(const char* wire)
+{
+    uint pos = 0;
+    uint labelLen = static_cast<uchar>(wire[0]);
+    while (labelLen > 0)
+    {
+        pos += labelLen + 1;
+        labelLen = static_cast<uchar>(wire[pos]);
+    }
+    mLen = pos + 1;
+    memcpy(mData, wire, mLen);
+    indexLabels();
+}
+
+void DomainName::indexLabels()
+{
+    uint pos = 0;
+    mLabelCount = 0;
+    while (mData[pos] != 0)
+    {
+        mLabelOffsets[mLabelCount++] = pos;
+        pos += static_cast<uchar>(mData[pos]) + 1;
+    }
+}
+
+std::string DomainName::toString() const
+{
+    char text[MAX_DOMAIN_LEN];
+    uint textLen = toText(text);
+
+    return std::string(text, textLen);
+}
+
+uint DomainName::toText(char* text) const
+{
+    // |4|b|l|u|e|3|i|m|s|2|c|z|0| -> blue.ims.cz
+    uint textLen = 0;
+    for (uint i = 0; i < mLabelCount; i++)
+    {
+        const char* label = mData + mLabelOffsets[i];
+        uint labelLen = static_cast<uchar>(label[0]);
+        if (textLen > 0)
+            text[textLen++] = '.';
+        memcpy(text + textLen, label + 1, labelLen);
+        textLen += labelLen;
+    }
+    text[textLen] = 0;
+
+    return textLen;
+}
+
+size_t DomainName::hash() const
+{
+    // FNV-1a over lower cased wire format (length octets are never changed by lowerChar)
+    size_t h = 2166136261u;
+    for (uint i = 0; i < mLen; i++)
+        h = (h ^ lowerChar(mData[i])) * 16777619u;
+
+    return h;
+}
+
+int DomainName::compare(const DomainName& other) const
+{
+    uint len = mLen < other.mLen ? mLen : other.mLen;
+    for (uint i = 0; i < len; i++)
+    {
+        int diff = static_cast<int>(lowerChar(mData[i])) - static_cast<int>(lowerChar(other.mData[i]));
+        if (diff != 0)
+            return diff;
+    }
+
+    return static_cast<int>(mLen) - static_cast<int>(other.mLen);
+}
+
+bool DomainName::operator==(const DomainName& other) const
+{
+    if (mLen != other.mLen)
+        return false;
+
+    for (uint i = 0; i < mLen; i++)
+        if (lowerChar(mData[i]) != lowerChar(other.mData[i]))
+            return false;
+
+    return true;
+}
+
+std::ostream& dns::operator<<(std::ostream& os, const DomainName& name)
+{
+    char text[MAX_DOMAIN_LEN];
+    uint textLen = name.toText(text);
+    os.write(text, textLen);
+
+    return os;
+}
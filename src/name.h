@@ -0,0 +1,140 @@
+/**
+ * DNS Domain Name
+ *
+ * Copyright (c) 2014 Michal Nezerka
+ * All rights reserved.
+ *
+ * Developed by: Michal Nezerka
+ *               https://github.com/mnezerka/
+ *               mailto:michal.nezerka@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal with the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimers.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimers in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Michal Nezerka, nor the names of its contributors
+ *    may be used to endorse or promote products derived from this Software
+ *    without specific prior written permission. 
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ */
+
+#ifndef _DNS_NAME_H
+#define	_DNS_NAME_H
+
+#include <string>
+#include <ostream>
+#include <functional>
+
+#include "dns.h"
+
+namespace dns {
+
+/**
+ * Domain name value
+ *
+ * Name is stored inline in wire format (sequence of labels terminated by
+ * zero octet, no compression links), so no memory is allocated. Offsets of
+ * labels are cached to allow fast access to labels and suffixes. Names are
+ * compared and hashed case-insensitively, so they could be used as keys of
+ * caches and zones directly.
+ *
+ *     blue.ims.cz -> |4|b|l|u|e|3|i|m|s|2|c|z|0|
+ */
+class DomainName
+{
+    public:
+        // maximal number of labels (without the root label)
+        static const uint MAX_LABELS = MAX_DOMAIN_LEN / 2;
+
+        // Constructor (root domain)
+        DomainName() : mLen(1), mLabelCount(0) { mData[0] = 0; }
+
+        // Constructors from text form (labels separated by dots, dot at the end is optional)
+        DomainName(const std::string& text) { fromText(text.data(), text.length()); }
+        DomainName(const char* text);
+
+        // Set name from text form (exception is thrown if name is not valid)
+        void fromText(const char* text, const uint textLen);
+
+        // Set name from wire format (name must be valid - e.g. decoded by Buffer)
+        void fromWire(const char* wire);
+
+        // Get text form of name
+        std::string toString() const;
+
+        // Write zero terminated text form of name to buffer (at least MAX_DOMAIN_LEN bytes)
+        // @return length of text
+        uint toText(char* text) const;
+
+        // Name in wire format
+        const char* getWire() const { return mData; }
+        uint getWireLen() const { return mLen; }
+
+        // Number of labels (root label is not counted)
+        uint getLabelCount() const { return mLabelCount; }
+
+        // Offset of label in wire format (index getLabelCount() refers to root label)
+        uint getLabelOffset(const uint index) const { return index < mLabelCount ? mLabelOffsets[index] : mLen - 1; }
+
+        // Label (length octet followed by characters)
+        const char* getLabel(const uint index) const { return mData + getLabelOffset(index); }
+
+        // Check if name is the root domain
+        bool isRoot() const { return mLabelCount == 0; }
+
+        // Case-insensitive hash of name
+        size_t hash() const;
+
+        // Case-insensitive comparison (negative, zero or positive value like strcmp)
+        int compare(const DomainName& other) const;
+
+        bool operator==(const DomainName& other) const;
+        bool operator!=(const DomainName& other) const { return !(*this == other); }
+        bool operator<(const DomainName& other) const { return compare(other) < 0; }
+
+    private:
+        // name in wire format
+        char mData[MAX_DOMAIN_LEN];
+        // length of name in wire format
+        uchar mLen;
+        // number of labels
+        uchar mLabelCount;
+        // offsets of labels
+        uchar mLabelOffsets[MAX_LABELS];
+
+        // fill table of label offsets
+        void indexLabels();
+};
+
+std::ostream& operator<<(std::ostream& os, const DomainName& name);
+
+} // namespace
+
+namespace std {
+
+template<>
+struct hash<dns::DomainName>
+{
+    size_t operator()(const dns::DomainName& name) const { return name.hash(); }
+};
+
+} // namespace
+
+#endif	/* _DNS_NAME_H */
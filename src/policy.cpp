@@ -0,0 +1,370 @@
+/**
+ * DNS Answer Policy
+ *
+ * Copyright (c) 2014 Michal Nezerka
+ * All rights reserved.
+ *
+ * Developed by: Michal Nezerka
+ *               https://github.com/mnezerka/
+ *               mailto:michal.nezerka@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal with the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimers.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimers in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Michal Nezerka, nor the names of its contributors
+ *    may be used to endorse or promote products derived from this Software
+ *    without specific prior written permission. 
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ */
+
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <memory>
+#include <tuple>
+#include <strings.h>
+
+#include "policy.h"
+#include "master.h"
+#include "message.h"
+#include "exception.h"
+
+using namespace dns;
+using namespace std;
+
+namespace {
+
+// remove comment (text behind '#' or ';' which is not quoted or escaped)
+void stripComment(string& line)
+{
+    bool quoted = false;
+    for (uint i = 0; i < line.size(); i++)
+    {
+        char c = line[i];
+        if (c == '\\')
+            i++;
+        else if (c == '"')
+            quoted = !quoted;
+        else if (!quoted && (c == '#' || c == ';'))
+        {
+            line.resize(i);
+            return;
+        }
+    }
+}
+
+// get next field separated by blanks (position is moved behind it)
+// @return false if there is no field left
+bool nextField(const string& line, size_t& pos, string& field)
+{
+    while (pos < line.size() && (line[pos] == ' ' || line[pos] == '\t' || line[pos] == '\r'))
+        pos++;
+    if (pos == line.size())
+        return false;
+
+    size_t start = pos;
+    while (pos < line.size() && line[pos] != ' ' && line[pos] != '\t' && line[pos] != '\r')
+        pos++;
+    field.assign(line, start, pos - start);
+
+    return true;
+}
+
+uint parseNumber(const string& token, const unsigned long max)
+{
+    char* end;
+    unsigned long value = strtoul(token.c_str(), &end, 10);
+    if (token.empty() || *end != 0 || token[0] == '-' || value > max)
+        throw(Exception("Invalid number '" + token + "'"));
+
+    return value;
+}
+
+// case-insensitive comparison of names in wire format
+bool equalWire(const char* a, const char* b, const uint len)
+{
+    for (uint i = 0; i < len; i++)
+        if (lowerChar(a[i]) != lowerChar(b[i]))
+            return false;
+
+    return true;
+}
+
+// rules with the same pattern and query type (compiled to one Rule)
+typedef tuple<bool, DomainName, uint> RuleKey;
+
+// action of rules which drop queries (out of range of response codes)
+const uint DROP_ACTION = 0x10000;
+
+struct PendingRule
+{
+    uint rcode;
+    Message response;
+};
+
+} // namespace
+
+/////////// Policy ///////////
+
+void Policy::load(const string& fileName)
+{
+    ifstream input(fileName.c_str());
+    if (!input)
+        throw(Exception("Can't open rules file '" + fileName + "'"));
+
+    load(input, fileName);
+}
+
+void Policy::load(istream& input, const string& source)
+{
+    // rules are ordered by (wildcard, pattern, qtype), so rules of one name are neighbours
+    map<RuleKey, PendingRule> pending;
+
+    string line;
+    string fields[4];
+    // RDATA is parsed by master file parser and decoded to rdata object of its type
+    vector<char> rdata;
+    rdata.reserve(MAX_MSG_LEN);
+    uint lineNo = 0;
+    while (getline(input, line))
+    {
+        lineNo++;
+        try
+        {
+            stripComment(line);
+            size_t pos = 0;
+            uint fieldCount = 0;
+            while (fieldCount < 3 && nextField(line, pos, fields[fieldCount]))
+                fieldCount++;
+            if (fieldCount == 0)
+                continue;
+            if (fieldCount < 3)
+                throw(Exception("Pattern, query type and action expected"));
+
+            bool wildcard = fields[0] == "*" || fields[0].compare(0, 2, "*.") == 0;
+            DomainName pattern(wildcard ? fields[0].substr(fields[0].size() > 1 ? 2 : 1) : fields[0]);
+            uint qtype = fields[1] == "*" ? ANY_QTYPE : parseType(fields[1].data(), fields[1].size());
+
+            uint rcode = RCODE_NOERROR;
+            if (strcasecmp(fields[2].c_str(), "NXDOMAIN") == 0)
+                rcode = RCODE_NXDOMAIN;
+            else if (strcasecmp(fields[2].c_str(), "REFUSED") == 0)
+                rcode = RCODE_REFUSED;
+            else if (strcasecmp(fields[2].c_str(), "DROP") == 0)
+                rcode = DROP_ACTION;
+
+            bool record = rcode == RCODE_NOERROR && strcasecmp(fields[2].c_str(), "NODATA") != 0;
+            bool typeGiven = nextField(line, pos, fields[3]);
+            if (!record && typeGiven)
+                throw(Exception("Unexpected text behind action"));
+
+            PendingRule &rule = pending.insert(make_pair(RuleKey(wildcard, pattern, qtype), PendingRule{rcode, Message()})).first->second;
+            if (rule.rcode != rcode)
+                throw(Exception("Action conflicts with previous rule of the same pattern and query type"));
+
+            if (record)
+            {
+                if (!typeGiven)
+                    throw(Exception("TTL, type and data of record expected"));
+                uint type = parseType(fields[3].data(), fields[3].size());
+                parseRData(type, line.data() + pos, line.size() - pos, DomainName(), rdata);
+                Buffer buffer(rdata.data(), rdata.size());
+                ResourceRecordPtr rr(new ResourceRecord());
+                rr->setClass(CLASS_IN);
+                rr->setTtl(parseNumber(fields[2], 0x7FFFFFFF));
+                rr->setRData(RDataRegistry::instance().get(type).decode(buffer, rdata.size(), NULL));
+                // rdata of unknown type is kept by generic object
+                rr->setType(static_cast<eRDataType>(type));
+                rule.response.addAnswer(std::move(rr));
+            }
+        }
+        catch (Exception &e)
+        {
+            ostringstream text;
+            text << source << ":" << lineNo << ": " << e.what();
+            throw(Exception(text.str()));
+        }
+    }
+
+    clear();
+
+    // responses are pre-encoded for query owned by root, records are written with links to QNAME
+    for (map<RuleKey, PendingRule>::iterator it = pending.begin(); it != pending.end(); )
+    {
+        bool wildcard = get<0>(it->first);
+        const DomainName pattern = get<1>(it->first);
+        uint firstRule = mRules.size();
+        for (; it != pending.end() && get<0>(it->first) == wildcard && get<1>(it->first) == pattern; ++it)
+        {
+            mRules.push_back(Rule());
+            Rule &rule = mRules.back();
+            rule.qtype = get<2>(it->first);
+            rule.drop = it->second.rcode == DROP_ACTION;
+            if (rule.drop)
+                continue;
+
+            Message &m = it->second.response;
+            m.setQr(Message::typeResponse);
+            m.setAA(it->second.rcode != RCODE_REFUSED);
+            m.setRCode(it->second.rcode);
+            m.addQuery(QuerySectionPtr(new QuerySection()));
+
+            rule.response.build(m);
+            m.setEdns(true);
+            rule.responseEdns.build(m);
+        }
+
+        RuleRange rules;
+        rules.firstRule = firstRule;
+        rules.ruleCount = mRules.size() - firstRule;
+        if (wildcard)
+        {
+            uint node = 0;
+            for (uint i = pattern.getLabelCount(); i-- > 0; )
+                node = mSuffixes.addChild(node, pattern.getLabel(i));
+            mSuffixes[node] = rules;
+        }
+        else
+        {
+            mNames.push_back(ExactName());
+            ExactName &name = mNames.back();
+            name.name = pattern;
+            name.hash = pattern.hash();
+            name.rules = rules;
+        }
+    }
+    indexNames();
+
+    Message noData;
+    noData.setQr(Message::typeResponse);
+    noData.setAA(1);
+    noData.addQuery(QuerySectionPtr(new QuerySection()));
+    mNoData.build(noData);
+    noData.setEdns(true);
+    mNoDataEdns.build(noData);
+
+    Message refused;
+    refused.setQr(Message::typeResponse);
+    refused.setRCode(RCODE_REFUSED);
+    refused.addQuery(QuerySectionPtr(new QuerySection()));
+    mRefused.build(refused);
+    refused.setEdns(true);
+    mRefusedEdns.build(refused);
+}
+
+const ResponseTemplate* Policy::find(const QueryPeek& query) const
+{
+    const Rule* rule = NULL;
+    bool matched = false;
+
+    // exact name
+    if (!mSlots.empty())
+    {
+        for (uint slot = query.qnameHash & mSlotMask; mSlots[slot] != 0; slot = (slot + 1) & mSlotMask)
+        {
+            const ExactName& name = mNames[mSlots[slot] - 1];
+            if (name.hash == query.qnameHash && name.name.getWireLen() == query.qnameSize && equalWire(name.name.getWire(), query.qname, query.qnameSize))
+            {
+                matched = true;
+                rule = selectRule(name.rules, query.qtype);
+                break;
+            }
+        }
+    }
+
+    // the longest wildcard suffix (labels of QNAME are walked from root, at least
+    // one label must be left below suffix)
+    if (!matched)
+    {
+        uint labels[DomainName::MAX_LABELS];
+        uint labelCount = 0;
+        for (uint pos = 0; query.qname[pos] != 0 && labelCount < DomainName::MAX_LABELS; pos += static_cast<uchar>(query.qname[pos]) + 1)
+            labels[labelCount++] = pos;
+
+        const RuleRange* match = mSuffixes[0].ruleCount > 0 ? &mSuffixes[0] : NULL;
+        uint node = 0;
+        for (uint i = labelCount; i-- > 1; )
+        {
+            node = mSuffixes.findChild(node, query.qname + labels[i]);
+            if (node == 0)
+                break;
+            if (mSuffixes[node].ruleCount > 0)
+                match = &mSuffixes[node];
+        }
+
+        if (match == NULL)
+            return query.edns ? &mRefusedEdns : &mRefused;
+        rule = selectRule(*match, query.qtype);
+    }
+
+    if (rule == NULL)
+        return query.edns ? &mNoDataEdns : &mNoData;
+    if (rule->drop)
+        return NULL;
+
+    return query.edns ? &rule->responseEdns : &rule->response;
+}
+
+void Policy::clear()
+{
+    mRules.clear();
+    mNames.clear();
+    mSlots.clear();
+    mSlotMask = 0;
+    mSuffixes.clear();
+}
+
+void Policy::indexNames()
+{
+    if (mNames.empty())
+        return;
+
+    // table is at most half full
+    uint size = 2;
+    while (size < mNames.size() * 2)
+        size *= 2;
+    mSlots.assign(size, 0);
+    mSlotMask = size - 1;
+
+    for (uint i = 0; i < mNames.size(); i++)
+    {
+        uint slot = mNames[i].hash & mSlotMask;
+        while (mSlots[slot] != 0)
+            slot = (slot + 1) & mSlotMask;
+        mSlots[slot] = i + 1;
+    }
+}
+
+const Policy::Rule* Policy::selectRule(const RuleRange& rules, const uint qtype) const
+{
+    const Rule* any = NULL;
+    for (uint i = rules.firstRule; i < rules.firstRule + rules.ruleCount; i++)
+    {
+        if (mRules[i].qtype == qtype)
+            return &mRules[i];
+        if (mRules[i].qtype == ANY_QTYPE)
+            any = &mRules[i];
+    }
+
+    return any;
+}
@@ -0,0 +1,156 @@
+/**
+ * DNS Answer Policy
+ *
+ * Copyright (c) 2014 Michal Nezerka
+ * All rights reserved.
+ *
+ * Developed by: Michal Nezerka
+ *               https://github.com/mnezerka/
+ *               mailto:michal.nezerka@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal with the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimers.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimers in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Michal Nezerka, nor the names of its contributors
+ *    may be used to endorse or promote products derived from this Software
+ *    without specific prior written permission. 
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ */
+
+#ifndef _DNS_POLICY_H
+#define	_DNS_POLICY_H
+
+#include <string>
+#include <vector>
+#include <istream>
+
+#include "dns.h"
+#include "name.h"
+#include "view.h"
+#include "response.h"
+#include "labeltree.h"
+
+namespace dns {
+
+/**
+ * Answer policy of fake server compiled from rules
+ *
+ * Each line of rules maps query name pattern and query type to an action:
+ *
+ *     <pattern> <qtype> <ttl> <type> <rdata>    record of answer RRset
+ *     <pattern> <qtype> NODATA                  empty answer (NOERROR)
+ *     <pattern> <qtype> NXDOMAIN                name error
+ *     <pattern> <qtype> REFUSED                 query is refused
+ *     <pattern> <qtype> DROP                    query is not answered
+ *
+ * Pattern is a domain name matched exactly, "*.name" matches all names below
+ * name and "*" matches any name. Query type is a type mnemonic, TYPEnnn or "*"
+ * for all types. Records with the same pattern and query type form one RRset
+ * owned by QNAME. RDATA is written in master file syntax (any known type,
+ * "\# <len> <hex>" for other types, \DDD escapes), names in RDATA are
+ * absolute. Text behind '#' or ';' is a comment.
+ *
+ *     www.example.com   A      300 A 192.0.2.1
+ *     www.example.com   A      300 A 192.0.2.2
+ *     *.example.com     NAPTR  60 NAPTR 100 10 "u" "E2U+sip" "!^.*$!sip:info@example.com!" .
+ *     *.example.com     *      NXDOMAIN
+ *     *                 *      REFUSED
+ *
+ * Rules are compiled to pre-encoded responses, exact names are kept in hash
+ * table and wildcard suffixes in trie over reversed labels, so query is
+ * resolved by one hash lookup and one walk over its labels. Exact name takes
+ * precedence over wildcards and the longest wildcard suffix wins. If the
+ * matched name has no rule for query type, empty NOERROR response is used.
+ * Queries not matched by any pattern are refused ("* * DROP" drops them).
+ */
+class Policy
+{
+    public:
+        Policy() { clear(); }
+
+        // Load rules from file (previous rules are replaced, exception is thrown if rules are not valid)
+        void load(const std::string& fileName);
+
+        // Load rules from stream
+        // @param source - name of source used in error messages
+        void load(std::istream& input, const std::string& source);
+
+        // Find response to query
+        // @return response template (with EDNS0 if query uses it) or NULL if query should be dropped
+        const ResponseTemplate* find(const QueryPeek& query) const;
+
+        // number of compiled rules
+        uint getRuleCount() const { return mRules.size(); }
+
+    private:
+        // query type of rules applied to all types
+        static const uint ANY_QTYPE = 0x10000;
+
+        struct Rule
+        {
+            uint qtype;
+            // query is dropped (responses are not built)
+            bool drop;
+            ResponseTemplate response;
+            ResponseTemplate responseEdns;
+        };
+
+        // rules of one name (rules of each name are stored in sequence)
+        struct RuleRange
+        {
+            uint firstRule;
+            uint ruleCount;
+
+            RuleRange() : firstRule(0), ruleCount(0) { }
+        };
+
+        struct ExactName
+        {
+            DomainName name;
+            size_t hash;
+            RuleRange rules;
+        };
+
+        std::vector<Rule> mRules;
+        std::vector<ExactName> mNames;
+        // open addressing table of exact names (index to mNames + 1, 0 is free slot)
+        std::vector<uint> mSlots;
+        uint mSlotMask;
+        // wildcard suffixes
+        LabelTree<RuleRange> mSuffixes;
+        // response for names matched without rule for query type
+        ResponseTemplate mNoData;
+        ResponseTemplate mNoDataEdns;
+        // response for names not matched by any pattern
+        ResponseTemplate mRefused;
+        ResponseTemplate mRefusedEdns;
+
+        void clear();
+
+        // build hash table of exact names
+        void indexNames();
+
+        // select rule for query type
+        const Rule* selectRule(const RuleRange& rules, const uint qtype) const;
+};
+
+} // namespace
+#endif	/* _DNS_POLICY_H */
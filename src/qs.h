@@ -43,6 +43,7 @@
 
 #include "dns.h"
 #include "buffer.h"
+#include "arena.h"
 
 namespace dns {
 
@@ -79,12 +80,12 @@ namespace dns {
  * QCLASS          a two octet code that specifies the class of the query.
  *                 For example, the QCLASS field is IN for the Internet.
  */
-class QuerySection
+class QuerySection : public ArenaObject
 {
 public:
 
     /* Constructor */
-    QuerySection(const std::string& qName = "") : mQName(qName), mQType(0), mQClass(QCLASS_IN) { };
+    QuerySection(const DomainName& qName = DomainName()) : mQName(qName), mQType(0), mQClass(QCLASS_IN) { };
 
     /* Set type of the query */
     void setType(uint qType) { mQType = qType; };
@@ -93,10 +94,10 @@ public:
     void setClass(eQClass qClass) { mQClass = qClass; };
 
     /* Set name field from a string */
-    void setName(const std::string& qName) { mQName = qName; } ;
+    void setName(const DomainName& qName) { mQName = qName; } ;
 
     /* Get name filed of the query */
-    std::string getName() const { return mQName; } ;
+    const DomainName& getName() const { return mQName; } ;
 
     /* Get the type of the query */
     uint getType() const { return mQType; };
@@ -111,7 +112,7 @@ public:
 private:
 
     // Name of the query
-    std::string mQName;
+    DomainName mQName;
 
     // Type field
     uint mQType;
@@ -0,0 +1,152 @@
+/**
+ * DNS Resource Record With Inline RData
+ *
+ * Copyright (c) 2014 Michal Nezerka
+ * All rights reserved.
+ *
+ * Developed by: Michal Nezerka
+ *               https://github.com/mnezerka/
+ *               mailto:michal.nezerka@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal with the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimers.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimers in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Michal Nezerka, nor the names of its contributors
+ *    may be used to endorse or promote products derived from this Software
+ *    without specific prior written permission. 
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ */
+
+#include <sstream>
+
+#include "record.h"
+
+using namespace dns;
+using namespace std;
+
+namespace {
+
+// Inline rdata is accessed by qualified calls (no virtual dispatch)
+struct RDataEncoder
+{
+    Buffer &buffer;
+
+    void operator()(monostate&) { }
+    void operator()(unique_ptr<RData>& rdata) { if (rdata) rdata->encode(buffer); }
+
+    template<class T>
+    void operator()(T& rdata) { rdata.T::encode(buffer); }
+};
+
+struct RDataPointer
+{
+    RData* operator()(monostate&) { return NULL; }
+    RData* operator()(unique_ptr<RData>& rdata) { return rdata.get(); }
+
+    template<class T>
+    RData* operator()(T& rdata) { return &rdata; }
+};
+
+} // namespace
+
+/////////// Record ///////////
+
+RData* Record::getRData()
+{
+    return visit(RDataPointer(), mRData);
+}
+
+void Record::decode(Buffer &buffer)
+{
+    buffer.getDnsDomainName(mName);
+    mType = static_cast<eRDataType>(buffer.get16bits());
+    mClass = static_cast<eClass>(buffer.get16bits());
+    mTtl = buffer.get32bits();
+    uint size = buffer.get16bits();
+    mRData.emplace<monostate>();
+    if (size == 0 || !buffer.checkAvailableSpace(size))
+        return;
+
+    const RDataType &type = RDataRegistry::instance().get(mType);
+    if (type.fixedSize != RDataRegistry::VARIABLE_SIZE && type.fixedSize != size)
+    {
+        buffer.setError(DECODE_BAD_RDATA_LENGTH);
+        return;
+    }
+
+    uint bPos = buffer.getPos();
+    switch (mType)
+    {
+        case RDATA_A:
+            decodeInline<RDataA>(buffer, size);
+            break;
+        case RDATA_AAAA:
+            decodeInline<RDataAAAA>(buffer, size);
+            break;
+        case RDATA_TXT:
+            decodeInline<RDataTXT>(buffer, size);
+            break;
+        default:
+            mRData.emplace<unique_ptr<RData> >(type.decode(buffer, size, NULL));
+            break;
+    }
+
+    if (buffer.getPos() - bPos != size)
+        buffer.setError(DECODE_BAD_RDATA_LENGTH);
+}
+
+void Record::encode(Buffer &buffer)
+{
+    buffer.putDnsDomainName(mName);
+    buffer.put16bits(mType);
+    buffer.put16bits(mClass);
+    buffer.put32bits(mTtl);
+    uint sizePos = buffer.getPos();
+    buffer.put16bits(0);
+    RDataEncoder encoder = { buffer };
+    visit(encoder, mRData);
+
+    // write actual size of rdata
+    uint lastPos = buffer.getPos();
+    buffer.setPos(sizePos);
+    buffer.put16bits(lastPos - sizePos - 2);
+    buffer.setPos(lastPos);
+}
+
+std::string Record::asString()
+{
+    RData *rdata = getRData();
+    ostringstream text;
+    if (rdata)
+        text << rdata->asString();
+    text << endl;
+    return text.str();
+}
+
+void Record::decodeSection(Buffer &buffer, const uint count, std::vector<Record> &list)
+{
+    list.reserve(list.size() + count);
+    for (uint i = 0; i < count && buffer.getError() == DECODE_OK; i++)
+    {
+        list.emplace_back();
+        list.back().decode(buffer);
+    }
+}
@@ -0,0 +1,137 @@
+/**
+ * DNS Resource Record With Inline RData
+ *
+ * Copyright (c) 2014 Michal Nezerka
+ * All rights reserved.
+ *
+ * Developed by: Michal Nezerka
+ *               https://github.com/mnezerka/
+ *               mailto:michal.nezerka@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal with the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimers.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimers in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Michal Nezerka, nor the names of its contributors
+ *    may be used to endorse or promote products derived from this Software
+ *    without specific prior written permission. 
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ */
+
+#ifndef _DNS_RECORD_H
+#define	_DNS_RECORD_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <variant>
+#include <type_traits>
+
+#include "dns.h"
+#include "buffer.h"
+#include "rr.h"
+
+namespace dns {
+
+/**
+ * Resource record with rdata stored by value
+ *
+ * Rdata of small common types (A, AAAA, TXT) is stored inline in variant and
+ * it is decoded and encoded without virtual dispatch, so records of one
+ * section could be kept in contiguous std::vector<Record> without allocation
+ * per record. Types with domain names in rdata (each DomainName takes
+ * hundreds of bytes) and other types are decoded through RDataRegistry to
+ * RData object owned by record (extension types keep working), so the variant
+ * stays small.
+ */
+class Record
+{
+    public:
+        // rdata of record (monostate if record has no rdata)
+        typedef std::variant<std::monostate, RDataA, RDataAAAA, RDataTXT, std::unique_ptr<RData> > Value;
+
+        // check if T is one of rdata types stored inline
+        template<class T>
+        static constexpr bool isInlineType() { return isAlternative<T>(static_cast<Value*>(NULL)); }
+
+        Record() : mType(RDATA_NULL), mClass(CLASS_IN), mTtl(0) { }
+
+        void setName(const DomainName& newName) { mName = newName; }
+        const DomainName& getName() const { return mName; }
+
+        void setType(const eRDataType type) { mType = type; }
+        eRDataType getType() const { return mType; }
+
+        void setClass(const eClass newClass) { mClass = newClass; }
+        eClass getClass() const { return mClass; }
+
+        void setTtl(const uint newTtl) { mTtl = newTtl; }
+        uint getTtl() const { return mTtl; }
+
+        // Store copy of rdata inline
+        template<class T, typename std::enable_if<isInlineType<T>(), int>::type = 0>
+        void setRData(const T& rdata) { mRData.template emplace<T>(rdata); mType = std::get<T>(mRData).T::getType(); }
+
+        // Store copy of rdata of type which is not stored inline (copy is allocated on heap)
+        template<class T, typename std::enable_if<!isInlineType<T>() && std::is_base_of<RData, T>::value, int>::type = 0>
+        void setRData(const T& rdata) { setRData(static_cast<RData*>(new T(rdata))); }
+
+        // Take ownership of rdata allocated on heap
+        void setRData(RData* rdata) { mType = rdata->getType(); mRData.emplace<std::unique_ptr<RData> >(rdata); }
+
+        // Get inline rdata of given type (NULL if record holds other type)
+        template<class T, typename std::enable_if<isInlineType<T>(), int>::type = 0>
+        T* get() { return std::get_if<T>(&mRData); }
+
+        // Get rdata through virtual interface (NULL if record has no rdata)
+        RData* getRData();
+
+        // Check if rdata is stored inline
+        bool isInline() const { return mRData.index() != 0 && !std::holds_alternative<std::unique_ptr<RData> >(mRData); }
+
+        const Value& getValue() const { return mRData; }
+
+        void decode(Buffer &buffer);
+        void encode(Buffer &buffer);
+
+        std::string asString();
+
+        // Decode count records of one section and append them to list
+        static void decodeSection(Buffer &buffer, const uint count, std::vector<Record> &list);
+
+    private:
+        template<class T, class... Types>
+        static constexpr bool isAlternative(std::variant<Types...>*) { return (std::is_same<T, Types>::value || ...); }
+
+        DomainName mName;
+        eRDataType mType;
+        eClass mClass;
+        uint mTtl;
+        Value mRData;
+
+        // construct inline rdata and decode it
+        template<class T>
+        void decodeInline(Buffer &buffer, const uint size) { mRData.template emplace<T>().T::decode(buffer, size); }
+};
+
+static_assert(sizeof(Record::Value) <= 48, "inline rdata of Record must stay small");
+
+} // namespace
+#endif	/* _DNS_RECORD_H */
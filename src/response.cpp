@@ -0,0 +1,326 @@
+/**
+ * DNS Response Builder
+ *
+ * Copyright (c) 2014 Michal Nezerka
+ * All rights reserved.
+ *
+ * Developed by: Michal Nezerka
+ *               https://github.com/mnezerka/
+ *               mailto:michal.nezerka@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal with the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimers.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimers in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Michal Nezerka, nor the names of its contributors
+ *    may be used to endorse or promote products derived from this Software
+ *    without specific prior written permission. 
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ */
+
+#include <cstring>
+
+#include "response.h"
+#include "exception.h"
+
+using namespace dns;
+using namespace std;
+
+/////////// ResponseBuilder ///////////
+
+ResponseBuilder::ResponseBuilder(char* buffer, const uint bufferSize)
+    : mData(buffer), mBuffer(buffer, bufferSize), mBufferSize(bufferSize), mMaxSize(bufferSize),
+      mEdns(false), mUdpPayloadSize(EDNS_UDP_PAYLOAD_SIZE),
+      mFlags(0), mSection(SECTION_ANSWER), mFull(true)
+{
+    mCounts[SECTION_ANSWER] = mCounts[SECTION_AUTHORITY] = mCounts[SECTION_ADDITIONAL] = 0;
+    mBuffer.setThrowing(false);
+}
+
+eDecodeError ResponseBuilder::start(const uint querySize)
+{
+    eDecodeError error = peekQuestion(mData, querySize < mBufferSize ? querySize : mBufferSize, mQuery);
+    if (error != DECODE_OK)
+        return error;
+
+    // response keeps OPCODE, RD and CD flags of query
+    mFlags = 0x8000 | (mQuery.flags & 0x7910);
+
+    // records are written behind question, QNAME is target for compression links
+    uint pos = 12 + mQuery.qnameSize + 4;
+    mBuffer.rewind(0);
+    mBuffer.setPos(pos);
+    mBuffer.registerDnsDomainName(12);
+    mCounts[SECTION_ANSWER] = mCounts[SECTION_AUTHORITY] = mCounts[SECTION_ADDITIONAL] = 0;
+    mSection = SECTION_ANSWER;
+    mEdns = false;
+    mFull = false;
+    updateReserved();
+
+    return DECODE_OK;
+}
+
+void ResponseBuilder::setMaxSize(const uint maxSize)
+{
+    mMaxSize = maxSize < mBufferSize ? maxSize : mBufferSize;
+    updateReserved();
+}
+
+void ResponseBuilder::setEdns(const uint udpPayloadSize)
+{
+    mEdns = true;
+    mUdpPayloadSize = udpPayloadSize & 0xFFFF;
+    updateReserved();
+}
+
+void ResponseBuilder::updateReserved()
+{
+    mBuffer.setReserved(mBufferSize - mMaxSize + (mEdns ? OPT_SIZE : 0));
+}
+
+bool ResponseBuilder::enterSection(const eSection section)
+{
+    if (mFull || section < mSection)
+        return false;
+    mSection = section;
+
+    return true;
+}
+
+void ResponseBuilder::dropRecord(const uint pos, const eSection section)
+{
+    mBuffer.rewind(pos);
+    mFull = true;
+    // missing additional records don't set TC (RFC 2181)
+    if (section != SECTION_ADDITIONAL)
+        mFlags |= 0x0200;
+}
+
+bool ResponseBuilder::addAnswer(const uint type, const uint ttl, RData &rdata)
+{
+    if (!enterSection(SECTION_ANSWER))
+        return false;
+
+    uint pos = mBuffer.getPos();
+    // link to QNAME
+    mBuffer.put16bits(0xc000 + 12);
+    mBuffer.put16bits(type);
+    mBuffer.put16bits(mQuery.qclass);
+    mBuffer.put32bits(ttl);
+    mBuffer.put16bits(0);
+    uint rdataPos = mBuffer.getPos();
+    rdata.encode(mBuffer);
+    if (mBuffer.getError() != DECODE_OK)
+    {
+        dropRecord(pos, SECTION_ANSWER);
+        return false;
+    }
+
+    // write length of rdata
+    uint rdataSize = mBuffer.getPos() - rdataPos;
+    mData[rdataPos - 2] = (rdataSize >> 8) & 0xFF;
+    mData[rdataPos - 1] = rdataSize & 0xFF;
+    mCounts[SECTION_ANSWER]++;
+
+    return true;
+}
+
+bool ResponseBuilder::addRecord(const eSection section, ResourceRecord &rr)
+{
+    if (!enterSection(section))
+        return false;
+
+    uint pos = mBuffer.getPos();
+    try
+    {
+        rr.encode(mBuffer);
+    }
+    catch (Exception &e)
+    {
+        // malformed rdata of lazily decoded record is left out like record which doesn't fit
+        dropRecord(pos, section);
+        return false;
+    }
+    if (mBuffer.getError() != DECODE_OK)
+    {
+        dropRecord(pos, section);
+        return false;
+    }
+    mCounts[section]++;
+
+    return true;
+}
+
+bool ResponseBuilder::addRRset(const eSection section, const RRsetView &rrset, const uint ownerOffset)
+{
+    if (!enterSection(section))
+        return false;
+
+    uint pos = mBuffer.getPos();
+    if (!rrset.write(mBuffer, ownerOffset))
+    {
+        dropRecord(pos, section);
+        return false;
+    }
+    mCounts[section] += rrset.getCount();
+
+    return true;
+}
+
+uint ResponseBuilder::finish()
+{
+    if (mEdns)
+    {
+        mBuffer.setReserved(0);
+        mBuffer.put8bits(0);
+        mBuffer.put16bits(RDATA_OPT);
+        mBuffer.put16bits(mUdpPayloadSize);
+        mBuffer.put32bits(0);
+        mBuffer.put16bits(0);
+        mCounts[SECTION_ADDITIONAL]++;
+    }
+
+    uint size = mBuffer.getPos();
+    mBuffer.setPos(2);
+    mBuffer.put16bits(mFlags);
+    mBuffer.setPos(6);
+    mBuffer.put16bits(mCounts[SECTION_ANSWER]);
+    mBuffer.put16bits(mCounts[SECTION_AUTHORITY]);
+    mBuffer.put16bits(mCounts[SECTION_ADDITIONAL]);
+    mBuffer.setPos(size);
+
+    return size;
+}
+
+/////////// ResponseTemplate ///////////
+
+void ResponseTemplate::build(Message &response)
+{
+    const QueryList& queries = response.getQueries();
+    if (queries.size() != 1)
+        throw(Exception("Response template must contain exactly one question"));
+    const DomainName& qName = queries[0]->getName();
+
+    // question is written without registration for compression, so no link
+    // could depend on content of QNAME
+    std::vector<char> data;
+    Buffer buff(data, Message::MAX_ENCODED_LEN);
+    buff.setPos(12);
+    buff.putBytes(qName.getWire(), qName.getWireLen());
+    buff.put16bits(queries[0]->getType());
+    buff.put16bits(queries[0]->getClass());
+    mQuestionEnd = buff.getPos();
+
+    std::vector<uint> links;
+    buff.setLinkLog(&links);
+    const RecordList* sections[3] = { &response.getAnswers(), &response.getAuthorities(), &response.getAdditional() };
+    for (uint section = SECTION_ANSWER; section <= SECTION_ADDITIONAL; section++)
+    {
+        for (RecordList::const_iterator it = sections[section]->begin(); it != sections[section]->end(); ++it)
+        {
+            ResourceRecord *rr = it->get();
+            if (rr->getName() != qName)
+            {
+                rr->encode(buff);
+                continue;
+            }
+
+            // owner is written as link to QNAME
+            buff.put16bits(0xc000 + 12);
+            buff.put16bits(rr->getType());
+            buff.put16bits(rr->getClass());
+            buff.put32bits(rr->getTtl());
+            uint rdataPos = buff.getPos() + 2;
+            buff.put16bits(0);
+            if (rr->getRData())
+            {
+                rr->getRData()->encode(buff);
+                uint end = buff.getPos();
+                buff.setPos(rdataPos - 2);
+                buff.put16bits(end - rdataPos);
+                buff.setPos(end);
+            }
+        }
+        mCounts[section] = sections[section]->size();
+    }
+
+    if (response.hasEdns())
+    {
+        RDataOPT &options = response.getEdnsOptions();
+        buff.put8bits(0);
+        buff.put16bits(RDATA_OPT);
+        buff.put16bits(response.getUdpPayloadSize());
+        buff.put32bits(((response.getExtendedRCode() >> 4) << 24) | (response.getEdnsVersion() << 16) | (response.getDO() << 15));
+        buff.put16bits(options.getSize());
+        options.encode(buff);
+        mCounts[SECTION_ADDITIONAL]++;
+    }
+
+    // flags of response (OPCODE, RD and CD are taken from query)
+    mFlags = 0x8000 | (response.getAA() << 10) | (response.getTC() << 9) | (response.getRA() << 7) | response.getRCode();
+
+    mRecords.assign(data.begin() + mQuestionEnd, data.begin() + buff.getPos());
+    mLinks.clear();
+    mMaxLinkTarget = 0;
+    for (std::vector<uint>::iterator it = links.begin(); it != links.end(); ++it)
+    {
+        mLinks.push_back(*it - mQuestionEnd);
+        uint target = ((static_cast<uchar>(data[*it]) & 0x3F) << 8) + static_cast<uchar>(data[*it + 1]);
+        if (target > mMaxLinkTarget)
+            mMaxLinkTarget = target;
+    }
+}
+
+uint ResponseTemplate::render(char* buffer, const uint bufferSize, const QueryPeek &query) const
+{
+    uint questionEnd = 12 + query.qnameSize + 4;
+    uint size = questionEnd + mRecords.size();
+    if (size > bufferSize || mMaxLinkTarget + questionEnd > 0x3FFF + mQuestionEnd)
+        return 0;
+
+    uchar* p = reinterpret_cast<uchar*>(buffer);
+    uint flags = mFlags | (query.flags & 0x7910);
+    p[2] = flags >> 8;
+    p[3] = flags & 0xFF;
+    p[4] = 0;
+    p[5] = 1;
+    for (uint i = 0; i < 3; i++)
+    {
+        p[6 + 2 * i] = mCounts[i] >> 8;
+        p[7 + 2 * i] = mCounts[i] & 0xFF;
+    }
+
+    if (!mRecords.empty())
+        memcpy(buffer + questionEnd, mRecords.data(), mRecords.size());
+
+    // links to names inside of records are moved together with records
+    if (questionEnd != mQuestionEnd)
+    {
+        for (std::vector<uint>::const_iterator it = mLinks.begin(); it != mLinks.end(); ++it)
+        {
+            uchar* link = p + questionEnd + *it;
+            uint offset = (((link[0] & 0x3F) << 8) + link[1]) + questionEnd - mQuestionEnd;
+            link[0] = 0xC0 | ((offset >> 8) & 0x3F);
+            link[1] = offset & 0xFF;
+        }
+    }
+
+    return size;
+}
@@ -0,0 +1,203 @@
+/**
+ * DNS Response Builder
+ *
+ * Copyright (c) 2014 Michal Nezerka
+ * All rights reserved.
+ *
+ * Developed by: Michal Nezerka
+ *               https://github.com/mnezerka/
+ *               mailto:michal.nezerka@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal with the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimers.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimers in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Michal Nezerka, nor the names of its contributors
+ *    may be used to endorse or promote products derived from this Software
+ *    without specific prior written permission. 
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ */
+
+#ifndef _DNS_RESPONSE_H
+#define	_DNS_RESPONSE_H
+
+#include <vector>
+
+#include "dns.h"
+#include "buffer.h"
+#include "message.h"
+#include "view.h"
+#include "rr.h"
+#include "zone.h"
+
+namespace dns {
+
+/**
+ * Builder of response in wire format directly in buffer with received query
+ *
+ * Query is not decoded to Message. Its header is turned to response header in
+ * place, question section is kept as it is and records are appended behind it.
+ * QNAME at offset 12 is used as target for compression links, so owner names
+ * equal to QNAME take only two octets. Records of query behind the question
+ * (e.g. OPT record) are dropped.
+ *
+ *     ResponseBuilder builder(buffer, sizeof(buffer));
+ *     if (builder.start(querySize) == DECODE_OK)
+ *     {
+ *         builder.addAnswer(RDATA_A, 60, rdata);
+ *         sendto(fd, buffer, builder.finish(), ...);
+ *     }
+ */
+class ResponseBuilder
+{
+    public:
+        // @param buffer - buffer with received query, response is built in it
+        // @param bufferSize - size of buffer (maximal size of response)
+        ResponseBuilder(char* buffer, const uint bufferSize);
+
+        // Check query stored at the beginning of buffer (see peekQuestion) and start response to it
+        // @param querySize - size of query
+        // @return DECODE_OK or code of error found in query
+        eDecodeError start(const uint querySize);
+
+        // header and question of query
+        const QueryPeek& getQuery() const { return mQuery; }
+
+        // EDNS0 of query (OPT record is recognized if it is the only record behind question)
+        bool hasQueryEdns() const { return mQuery.edns; }
+
+        // Maximal size of UDP response to query (advertised UDP payload size, at least 512 bytes)
+        uint getMaxUdpSize() const { return mQuery.getMaxUdpSize(); }
+
+        // Limit size of response (must not exceed size of buffer)
+        void setMaxSize(const uint maxSize);
+
+        // Add OPT record with given UDP payload size to response (it is written by finish)
+        void setEdns(const uint udpPayloadSize);
+
+        void setAA(const uint aa) { mFlags = (mFlags & ~0x0400) | ((aa & 1) << 10); }
+        void setRA(const uint ra) { mFlags = (mFlags & ~0x0080) | ((ra & 1) << 7); }
+        void setRCode(const uint rcode) { mFlags = (mFlags & ~0x000F) | (rcode & 15); }
+
+        // Append answer record owned by QNAME (owner is written as compression link to offset 12)
+        // @return false if record doesn't fit into response (no more records are accepted)
+        bool addAnswer(const uint type, const uint ttl, RData &rdata);
+
+        // Append record to section, sections must be filled in order (answer, authority, additional).
+        // If record of answer or authority section doesn't fit, response is truncated (TC flag is set),
+        // record with malformed lazily decoded rdata is handled the same way (nothing is thrown).
+        // @return false if record doesn't fit or section is out of order
+        bool addRecord(const eSection section, ResourceRecord &rr);
+
+        // Append pre-encoded RRset to section (see addRecord)
+        // @param ownerOffset - offset of owner name in response (QNAME is at offset 12)
+        // @return false if RRset doesn't fit or section is out of order
+        bool addRRset(const eSection section, const RRsetView &rrset, const uint ownerOffset);
+
+        bool addRRset(const eSection section, const RRset &rrset, const uint ownerOffset) { return addRRset(section, rrset.getView(), ownerOffset); }
+
+        // Write header (section counts, flags) and OPT record
+        // @return size of response
+        uint finish();
+
+    private:
+        // size of OPT record without options
+        static const uint OPT_SIZE = 11;
+
+        // buffer with query and response
+        char* mData;
+        // writer of records
+        Buffer mBuffer;
+        // size of buffer
+        uint mBufferSize;
+        // maximal size of response
+        uint mMaxSize;
+        // header and question of query
+        QueryPeek mQuery;
+        // EDNS0 of response
+        bool mEdns;
+        uint mUdpPayloadSize;
+        // flags of response header
+        uint mFlags;
+        // number of records in sections
+        uint mCounts[3];
+        // section which is filled now
+        uint mSection;
+        // no more records are accepted
+        bool mFull;
+
+        // keep space for OPT record and limit of response size
+        void updateReserved();
+
+        // check that record could be added to section
+        bool enterSection(const eSection section);
+
+        // drop partially written record
+        void dropRecord(const uint pos, const eSection section);
+};
+
+/**
+ * Response pre-encoded for fast answering of queries
+ *
+ * Records of response are encoded once. Owner names equal to the question
+ * name are written as links to QNAME at offset 12, other names are compressed
+ * only against names inside of records. Positions of these links are kept,
+ * so response to any query is rendered to buffer with the query by copying
+ * the records behind its question, patching header and shifting the links
+ * when QNAME of query is longer or shorter than QNAME of template.
+ */
+class ResponseTemplate
+{
+    public:
+        ResponseTemplate() : mFlags(0), mQuestionEnd(0), mMaxLinkTarget(0) { mCounts[0] = mCounts[1] = mCounts[2] = 0; }
+
+        // Encode records of response (message must contain one question, records owned
+        // by its name will be owned by QNAME of answered queries). Flags AA, RA and RCODE
+        // and EDNS0 fields of message are used as well.
+        void build(Message &response);
+
+        // Render response to query stored in buffer (question of query is kept, ID,
+        // OPCODE, RD and CD flags are taken from query)
+        // @param buffer - buffer with query
+        // @param bufferSize - maximal size of response
+        // @param query - header and question of query (see peekQuestion)
+        // @return size of response or 0 if it doesn't fit into buffer
+        uint render(char* buffer, const uint bufferSize, const QueryPeek &query) const;
+
+        // size of encoded records
+        uint getRecordsSize() const { return mRecords.size(); }
+
+    private:
+        // encoded records
+        std::vector<char> mRecords;
+        // positions of compression links inside of records (relative to start of records)
+        std::vector<uint> mLinks;
+        // flags of response header (without flags taken from query)
+        uint mFlags;
+        // section counts
+        uint mCounts[3];
+        // end of question in template message (records are encoded behind it)
+        uint mQuestionEnd;
+        // the highest offset referred by links (links must not exceed 14 bits when shifted)
+        uint mMaxLinkTarget;
+};
+
+} // namespace
+#endif	/* _DNS_RESPONSE_H */
@@ -47,11 +47,48 @@
 using namespace dns;
 using namespace std;
 
+namespace {
+
+// check if name starting at pos of raw rdata contains compression link (name
+// which doesn't fit into rdata is reported as well, it is found by decoding)
+bool nameHasLink(const char* rdata, uint pos, const uint size)
+{
+    while (pos < size)
+    {
+        uint len = static_cast<uchar>(rdata[pos]);
+        if (len == 0)
+            return false;
+        if (len & 0xC0)
+            return true;
+        pos += len + 1;
+    }
+
+    return true;
+}
+
+// target of SRV follows priority, weight and port
+bool srvHasLinks(const char* rdata, const uint size)
+{
+    return nameHasLink(rdata, 6, size);
+}
+
+// replacement of NAPTR follows order, preference, flags, services and regexp
+bool naptrHasLinks(const char* rdata, const uint size)
+{
+    uint pos = 4;
+    for (uint i = 0; i < 3 && pos < size; i++)
+        pos += static_cast<uchar>(rdata[pos]) + 1;
+
+    return nameHasLink(rdata, pos, size);
+}
+
+} // namespace
+
 /////////// RDataWithName ///////////
 
-void RDataWithName::decode(Buffer &buffer, const uint size)
+void RDataWithName::decode(Buffer &buffer, const uint)
 {
-    mName = buffer.getDnsDomainName();
+    buffer.getDnsDomainName(mName);
 }
 
 void RDataWithName::encode(Buffer &buffer)
@@ -70,7 +107,7 @@ std::string RDataCNAME::asString()
 
 /////////// RDataHINFO /////////////////
 
-void RDataHINFO::decode(Buffer &buffer, const uint size)
+void RDataHINFO::decode(Buffer &buffer, const uint)
 {
     mCpu = buffer.getDnsCharacterString();
     mOs = buffer.getDnsCharacterString();
@@ -127,10 +164,10 @@ std::string RDataMG::asString()
 
 /////////// RDataMINFO /////////////////
 
-void RDataMINFO::decode(Buffer &buffer, const uint size)
+void RDataMINFO::decode(Buffer &buffer, const uint)
 {
-    mRMailBx = buffer.getDnsDomainName();
-    mMailBx = buffer.getDnsDomainName();
+    buffer.getDnsDomainName(mRMailBx);
+    buffer.getDnsDomainName(mMailBx);
 }
 
 void RDataMINFO::encode(Buffer &buffer)
@@ -157,10 +194,10 @@ std::string RDataMR::asString()
 
 
 /////////// RDataMX /////////////////
-void RDataMX::decode(Buffer &buffer, const uint size)
+void RDataMX::decode(Buffer &buffer, const uint)
 {
     mPreference = buffer.get16bits();
-    mExchange = buffer.getDnsDomainName();
+    buffer.getDnsDomainName(mExchange);
 }
 
 void RDataMX::encode(Buffer &buffer)
@@ -187,10 +224,18 @@ RDataNULL::~RDataNULL()
 void RDataNULL::decode(Buffer &buffer, const uint size)
 {
     // get data from buffer
+    mDataSize = 0;
     const char *data = buffer.getBytes(size);
+    if (data == NULL)
+        return;
 
-    // allocate new memory
-    mData = new char[size];
+    // memory of reused object is enlarged only if it isn't sufficient
+    if (size > mDataCapacity)
+    {
+        delete[] mData;
+        mData = new char[size];
+        mDataCapacity = size;
+    }
 
     // copy rdata
     std::memcpy(mData, data, size);
@@ -231,10 +276,10 @@ std::string RDataPTR::asString()
 
 /////////// RDataSOA /////////////////
 
-void RDataSOA::decode(Buffer &buffer, const uint size)
+void RDataSOA::decode(Buffer &buffer, const uint)
 {
-    mMName = buffer.getDnsDomainName();
-    mRName = buffer.getDnsDomainName();
+    buffer.getDnsDomainName(mMName);
+    buffer.getDnsDomainName(mRName);
     mSerial = buffer.get32bits();
     mRefresh = buffer.get32bits();
     mRetry = buffer.get32bits();
@@ -269,7 +314,7 @@ void RDataTXT::decode(Buffer &buffer, const uint size)
 {
     mTexts.clear();
     uint posStart = buffer.getPos();
-    while (buffer.getPos() - posStart < size)
+    while (buffer.getPos() - posStart < size && buffer.getError() == DECODE_OK)
         mTexts.push_back(buffer.getDnsCharacterString());
 }
 
@@ -290,10 +335,12 @@ std::string RDataTXT::asString()
 
 /////////// RDataA /////////////////
 
-void RDataA::decode(Buffer &buffer, const uint size)
+void RDataA::decode(Buffer &buffer, const uint)
 {
     // get data from buffer
     const char *data = buffer.getBytes(4);
+    if (data == NULL)
+        return;
     for (uint i = 0; i < 4; i++)
         mAddr[i] = data[i];
 }
@@ -322,8 +369,18 @@ RDataWKS::~RDataWKS()
 
 void RDataWKS::decode(Buffer &buffer, const uint size)
 {
+    // address and protocol are followed by bitmap
+    mBitmapSize = 0;
+    if (size < 5)
+    {
+        buffer.setError(DECODE_BAD_RDATA_LENGTH);
+        return;
+    }
+
     // get ip address
     const char *data = buffer.getBytes(4);
+    if (data == NULL)
+        return;
     for (uint i = 0; i < 4; i++)
         mAddr[i] = data[i];
 
@@ -331,14 +388,22 @@ void RDataWKS::decode(Buffer &buffer, const uint size)
     mProtocol = buffer.get8bits();
 
     // get bitmap
-    mBitmapSize = size - 5;
-    data = buffer.getBytes(mBitmapSize);
+    uint bitmapSize = size - 5;
+    data = buffer.getBytes(bitmapSize);
+    if (data == NULL)
+        return;
 
-    // allocate new memory
-    mBitmap = new char[size];
+    // memory of reused object is enlarged only if it isn't sufficient
+    if (bitmapSize > mBitmapCapacity)
+    {
+        delete[] mBitmap;
+        mBitmap = new char[bitmapSize];
+        mBitmapCapacity = bitmapSize;
+    }
 
     // copy rdata
-    std::memcpy(mBitmap, data, mBitmapSize);
+    std::memcpy(mBitmap, data, bitmapSize);
+    mBitmapSize = bitmapSize;
 }
 
 void RDataWKS::encode(Buffer &buffer)
@@ -373,10 +438,12 @@ std::string RDataWKS::asString()
 
 /////////// RDataAAAA /////////////////
 
-void RDataAAAA::decode(Buffer &buffer, const uint size)
+void RDataAAAA::decode(Buffer &buffer, const uint)
 {
     // get data from buffer
     const char *data = buffer.getBytes(16);
+    if (data == NULL)
+        return;
     for (uint i = 0; i < 16; i++)
         mAddr[i] = data[i];
 }
@@ -405,14 +472,15 @@ std::string RDataAAAA::asString()
 
 /////////// RDataNAPTR /////////////////
 
-void RDataNAPTR::decode(Buffer &buffer, const uint size)
+void RDataNAPTR::decode(Buffer &buffer, const uint)
 {
     mOrder = buffer.get16bits();
     mPreference = buffer.get16bits();
     mFlags = buffer.getDnsCharacterString();
     mServices = buffer.getDnsCharacterString();
     mRegExp = buffer.getDnsCharacterString();
-    mReplacement = buffer.getDnsDomainName(false);
+    // replacement must not be compressed, but it is accepted from older servers (RFC 3597, section 4)
+    buffer.getDnsDomainName(mReplacement);
 }
 
 void RDataNAPTR::encode(Buffer &buffer)
@@ -433,20 +501,15 @@ std::string RDataNAPTR::asString()
 }
 
 /////////// RDataSRV /////////////////
-void RDataSRV::decode(Buffer &buffer, const uint size)
+void RDataSRV::decode(Buffer &buffer, const uint)
 {
     mPriority = buffer.get16bits();
     mWeight = buffer.get16bits();
     mPort = buffer.get16bits();
 
-    mTarget.clear();
-    uint posStart = buffer.getPos();
-    while (buffer.getPos() - posStart < size - 6) {
-        mTarget.append(buffer.getDnsCharacterString());
-        mTarget.append(".");
-    }
-    mTarget.pop_back();
-    mTarget.pop_back();
+    // target must not be compressed (RFC 2782), but servers following RFC 2052
+    // compress it, so it is accepted on decode (RFC 3597, section 4)
+    buffer.getDnsDomainName(mTarget);
 }
 
 void RDataSRV::encode(Buffer &buffer)
@@ -454,7 +517,7 @@ void RDataSRV::encode(Buffer &buffer)
     buffer.put16bits(mPriority);
     buffer.put16bits(mWeight);
     buffer.put16bits(mPort);
-    buffer.putDnsCharacterString(mTarget);
+    buffer.putDnsDomainName(mTarget, false);
 }
 
 std::string RDataSRV::asString()
@@ -465,6 +528,171 @@ std::string RDataSRV::asString()
 }
 
 
+/////////// RDataOPT /////////////////
+void RDataOPT::decode(Buffer &buffer, const uint size)
+{
+    mOptions.clear();
+    uint end = buffer.getPos() + size;
+    while (buffer.getPos() + 4 <= end && buffer.getError() == DECODE_OK)
+    {
+        Option option;
+        option.code = buffer.get16bits();
+        uint len = buffer.get16bits();
+        if (buffer.getPos() + len > end)
+        {
+            buffer.setError(DECODE_BAD_RDATA_LENGTH);
+            return;
+        }
+        const char* data = buffer.getBytes(len);
+        if (data == NULL)
+            return;
+        option.data.assign(data, len);
+        mOptions.push_back(option);
+    }
+}
+
+void RDataOPT::encode(Buffer &buffer)
+{
+    for (std::vector<Option>::const_iterator it = mOptions.begin(); it != mOptions.end(); ++it)
+    {
+        buffer.put16bits(it->code);
+        buffer.put16bits(it->data.length());
+        buffer.putBytes(it->data.data(), it->data.length());
+    }
+}
+
+void RDataOPT::addOption(const uint code, const std::string& data)
+{
+    Option option;
+    option.code = code;
+    option.data = data;
+    mOptions.push_back(option);
+}
+
+uint RDataOPT::getSize() const
+{
+    uint size = 0;
+    for (std::vector<Option>::const_iterator it = mOptions.begin(); it != mOptions.end(); ++it)
+        size += 4 + it->data.length();
+
+    return size;
+}
+
+std::string RDataOPT::asString()
+{
+    ostringstream text;
+    text << "<<OPT options=" << mOptions.size();
+    for (std::vector<Option>::const_iterator it = mOptions.begin(); it != mOptions.end(); ++it)
+        text << " code=" << it->code << " length=" << it->data.length();
+    return text.str();
+}
+
+/////////// RDataRegistry ////////////
+
+RDataRegistry& RDataRegistry::instance()
+{
+    static RDataRegistry registry;
+    return registry;
+}
+
+RDataRegistry::RDataRegistry()
+{
+    mUnknown.create = createRData<RDataNULL>;
+    mUnknown.decode = decodeRData<RDataNULL>;
+    mUnknown.fixedSize = VARIABLE_SIZE;
+    mUnknown.compressedNames = false;
+    mUnknown.hasLinks = NULL;
+    for (uint i = 0; i < TABLE_SIZE; i++)
+        mTable[i] = mUnknown;
+
+    add<RDataA>(RDATA_A, 4);
+    add<RDataNS>(RDATA_NS, VARIABLE_SIZE, true);
+    add<RDataMD>(RDATA_MD, VARIABLE_SIZE, true);
+    add<RDataMF>(RDATA_MF, VARIABLE_SIZE, true);
+    add<RDataCNAME>(RDATA_CNAME, VARIABLE_SIZE, true);
+    add<RDataSOA>(RDATA_SOA, VARIABLE_SIZE, true);
+    add<RDataMB>(RDATA_MB, VARIABLE_SIZE, true);
+    add<RDataMG>(RDATA_MG, VARIABLE_SIZE, true);
+    add<RDataMR>(RDATA_MR, VARIABLE_SIZE, true);
+    add<RDataNULL>(RDATA_NULL);
+    add<RDataWKS>(RDATA_WKS);
+    add<RDataPTR>(RDATA_PTR, VARIABLE_SIZE, true);
+    add<RDataHINFO>(RDATA_HINFO);
+    add<RDataMINFO>(RDATA_MINFO, VARIABLE_SIZE, true);
+    add<RDataMX>(RDATA_MX, VARIABLE_SIZE, true);
+    add<RDataTXT>(RDATA_TXT);
+    add<RDataAAAA>(RDATA_AAAA, 16);
+    add<RDataSRV>(RDATA_SRV, VARIABLE_SIZE, false, srvHasLinks);
+    add<RDataNAPTR>(RDATA_NAPTR, VARIABLE_SIZE, false, naptrHasLinks);
+    add<RDataOPT>(RDATA_OPT);
+}
+
+void RDataRegistry::add(const uint type, RDataFactory create, RDataDecoder decode, const uint fixedSize, const bool compressedNames, RDataLinkCheck hasLinks)
+{
+    RDataType t;
+    t.create = create;
+    t.decode = decode;
+    t.fixedSize = fixedSize;
+    t.compressedNames = compressedNames;
+    t.hasLinks = hasLinks;
+    if (type < TABLE_SIZE)
+        mTable[type] = t;
+    else
+        mOther[type] = t;
+}
+
+const RDataType& RDataRegistry::get(const uint type) const
+{
+    if (type < TABLE_SIZE)
+        return mTable[type];
+
+    std::map<uint, RDataType>::const_iterator it = mOther.find(type);
+    return it != mOther.end() ? it->second : mUnknown;
+}
+
+/////////// RDataFreeList ////////////
+
+void RDataFreeList::put(RData* rdata)
+{
+    RDataDecoder decoder = RDataRegistry::instance().get(rdata->getType()).decode;
+    for (std::vector<List>::iterator it = mLists.begin(); it != mLists.end(); ++it)
+    {
+        if (it->decoder == decoder)
+        {
+            it->items.push_back(rdata);
+            return;
+        }
+    }
+
+    List list;
+    list.decoder = decoder;
+    list.items.push_back(rdata);
+    mLists.push_back(list);
+}
+
+RData* RDataFreeList::get(RDataDecoder decoder)
+{
+    for (std::vector<List>::iterator it = mLists.begin(); it != mLists.end(); ++it)
+    {
+        if (it->decoder == decoder && !it->items.empty())
+        {
+            RData* rdata = it->items.back();
+            it->items.pop_back();
+            return rdata;
+        }
+    }
+
+    return NULL;
+}
+
+void RDataFreeList::clear()
+{
+    for (std::vector<List>::iterator it = mLists.begin(); it != mLists.end(); ++it)
+        for (std::vector<RData*>::iterator item = it->items.begin(); item != it->items.end(); ++item)
+            delete *item;
+    mLists.clear();
+}
+
 /////////// ResourceRecord ////////////
 
 ResourceRecord::~ResourceRecord()
@@ -473,78 +701,78 @@ ResourceRecord::~ResourceRecord()
     mRData = NULL;
 }
 
-void ResourceRecord::decode(Buffer &buffer)
+void ResourceRecord::decode(Buffer &buffer, Arena* arena, const bool lazy, RDataFreeList* freeList)
 {
-    mName = buffer.getDnsDomainName();
+    // record could be recycled
+    delete mRData;
+    mRData = NULL;
+    mWire = NULL;
+
+    buffer.getDnsDomainName(mName);
     mType = static_cast<eRDataType>(buffer.get16bits());
     mClass = static_cast<eClass>(buffer.get16bits());
     mTtl = buffer.get32bits();
     mRDataSize = buffer.get16bits();
-    if (mRDataSize > 0)
+    if (mRDataSize > 0 && buffer.checkAvailableSpace(mRDataSize))
     {
-        switch (mType) {
-            case RDATA_CNAME:
-                mRData = new RDataCNAME();
-                break;
-            case RDATA_HINFO:
-                mRData = new RDataHINFO();
-                break;
-            case RDATA_MB:
-                mRData = new RDataMB();
-                break;
-            case RDATA_MD:
-                mRData = new RDataMD();
-                break;
-            case RDATA_MF:
-                mRData = new RDataMF();
-                break;
-            case RDATA_MG:
-                mRData = new RDataMG();
-                break;
-            case RDATA_MINFO:
-                mRData = new RDataMINFO();
-                break;
-            case RDATA_MR:
-                mRData = new RDataMR();
-                break;
-            case RDATA_MX:
-                mRData = new RDataMX();
-                break;
-            case RDATA_NS:
-                mRData = new RDataNS();
-                break;
-            case RDATA_PTR:
-                mRData = new RDataPTR();
-                break;
-            case RDATA_SOA:
-                mRData = new RDataSOA();
-                break;
-            case RDATA_TXT:
-                mRData = new RDataTXT();
-                break;
-            case RDATA_A:
-                mRData = new RDataA();
-                break;
-            case RDATA_WKS:
-                mRData = new RDataA();
-                break;
-            case RDATA_AAAA:
-                mRData = new RDataAAAA();
-                break;
-            case RDATA_NAPTR:
-                mRData = new RDataNAPTR();
-                break;
-            case RDATA_SRV:
-                mRData = new RDataSRV();
-                break;
-            default:
-                mRData = new RDataNULL();
+        // check size of fixed size rdata before it is constructed
+        const RDataType &type = RDataRegistry::instance().get(mType);
+        if (type.fixedSize != RDataRegistry::VARIABLE_SIZE && type.fixedSize != mRDataSize)
+        {
+            buffer.setError(DECODE_BAD_RDATA_LENGTH);
+            return;
         }
-        uint bPos = buffer.getPos();
+
+        // OPT record is always decoded (EDNS0 fields are taken from it by message)
+        if (lazy && mType != RDATA_OPT)
+        {
+            mWire = buffer.getData();
+            mWireSize = buffer.getSize();
+            mRDataPos = buffer.getPos();
+            mArena = arena;
+            buffer.setPos(mRDataPos + mRDataSize);
+            return;
+        }
+
+        decodeRData(buffer, arena, freeList);
+    }
+}
+
+void ResourceRecord::decodeRData(Buffer &buffer, Arena* arena, RDataFreeList* freeList) const
+{
+    uint bPos = buffer.getPos();
+    RDataDecoder decoder = RDataRegistry::instance().get(mType).decode;
+    mRData = freeList ? freeList->get(decoder) : NULL;
+    if (mRData)
         mRData->decode(buffer, mRDataSize);
-        if (buffer.getPos() - bPos != mRDataSize)
-            throw (Exception("Number of decoded bytes are different than expected size"));
+    else
+        mRData = decoder(buffer, mRDataSize, arena);
+    if (buffer.getPos() - bPos != mRDataSize)
+        buffer.setError(DECODE_BAD_RDATA_LENGTH);
+}
+
+RData* ResourceRecord::getRData() const
+{
+    if (mWire)
+    {
+        // links in rdata could point anywhere in message
+        Buffer buffer(const_cast<char*>(mWire), mWireSize);
+        buffer.setPos(mRDataPos);
+        mWire = NULL;
+        try
+        {
+            decodeRData(buffer, mArena, NULL);
+        }
+        catch (Exception &e)
+        {
+            // rdata which failed (e.g. with bad length) is not returned by later calls
+            delete mRData;
+            mRData = NULL;
+            throw;
+        }
     }
+
+    return mRData;
 }
 
 void ResourceRecord::encode(Buffer &buffer)
@@ -553,11 +781,21 @@ void ResourceRecord::encode(Buffer &buffer)
     buffer.put16bits(mType);
     buffer.put16bits(mClass);
     buffer.put32bits(mTtl);
+
+    // raw rdata is copied if it doesn't contain links to original message
+    const RDataType &type = RDataRegistry::instance().get(mType);
+    if (mWire && !type.compressedNames && (type.hasLinks == NULL || !type.hasLinks(mWire + mRDataPos, mRDataSize)))
+    {
+        buffer.put16bits(mRDataSize);
+        buffer.putBytes(mWire + mRDataPos, mRDataSize);
+        return;
+    }
+
     // save position of buffer for later use (write length of RData part)
     uint bufferPosRDataLength = buffer.getPos();
     buffer.put16bits(0); // this value could be later overwritten
     // encode RData if present
-    if (mRData)
+    if (getRData())
     {
         mRData->encode(buffer);
         mRDataSize = buffer.getPos() - bufferPosRDataLength - 2; // 2 because two bytes for RData length are not part of RData block
@@ -572,7 +810,7 @@ std::string ResourceRecord::asString()
 {
     ostringstream text;
     //text << "<DNS RR: "  << mName << " rtype=" << mType << " rclass=" << mClass << " ttl=" << mTtl << " rdata=" <<  mRDataSize << " bytes ";
-    if (mRData)
+    if (getRData())
         text << mRData->asString();
     text << endl;
     return text.str();
@@ -39,15 +39,17 @@
 
 #include <string>
 #include <vector>
+#include <map>
 #include <arpa/inet.h>
 
 #include "dns.h"
 #include "buffer.h"
+#include "arena.h"
 
 namespace dns {
 
 /** Abstract class that act as base for all Resource Record RData types */
-class RData {
+class RData : public ArenaObject {
     public:
         virtual ~RData() { };
         virtual eRDataType getType() = 0;
@@ -61,17 +63,17 @@ class RData {
 */
 class RDataWithName: public RData {
     public:
-        RDataWithName() : mName("") { };
+        RDataWithName() { };
         virtual ~RDataWithName() { };
         virtual void decode(Buffer &buffer, const uint size);
         virtual void encode(Buffer &buffer);
 
-        virtual void setName(const std::string& newName) { mName = newName; };
-        virtual std::string getName() { return mName; };
+        virtual void setName(const DomainName& newName) { mName = newName; };
+        virtual const DomainName& getName() const { return mName; };
 
     private:
         // <domain-name> as defined in DNS RFC (sequence of labels)
-        std::string mName;
+        DomainName mName;
 };
 
 /**
@@ -162,16 +164,16 @@ class RDataMG: public RDataWithName {
   */
 class RDataMINFO: public RData {
     public:
-        RDataMINFO() : mRMailBx(""), mMailBx("") { };
+        RDataMINFO() { };
         virtual ~RDataMINFO() { };
 
         virtual eRDataType getType() { return RDATA_MINFO; };
 
-        void setRMailBx(const std::string& newRMailBx) { mRMailBx = newRMailBx; };
-        std::string getRMailBx() { return mRMailBx; };
+        void setRMailBx(const DomainName& newRMailBx) { mRMailBx = newRMailBx; };
+        const DomainName& getRMailBx() const { return mRMailBx; };
 
-        void setMailBx(const std::string& newMailBx) { mMailBx = newMailBx; };
-        std::string getMailBx() { return mMailBx; };
+        void setMailBx(const DomainName& newMailBx) { mMailBx = newMailBx; };
+        const DomainName& getMailBx() const { return mMailBx; };
 
         virtual void decode(Buffer &buffer, const uint size);
         virtual void encode(Buffer &buffer);
@@ -180,11 +182,11 @@ class RDataMINFO: public RData {
     private:
         // A <domain-name> which specifies a mailbox which is
         // responsible for the mailing list or mailbox.
-        std::string mRMailBx;
+        DomainName mRMailBx;
         // A <domain-name> which specifies a mailbox which is to
         // receive error messages related to the mailing list or
         // mailbox specified by the owner of the MINFO RR.
-        std::string mMailBx;
+        DomainName mMailBx;
 };
 
 /**
@@ -204,7 +206,7 @@ class RDataMR: public RDataWithName {
  */
 class RDataMX: public RData {
     public:
-        RDataMX() : mPreference(0), mExchange("") { };
+        RDataMX() : mPreference(0) { };
         virtual ~RDataMX() { };
 
         virtual eRDataType getType() { return RDATA_MX; };
@@ -212,8 +214,8 @@ class RDataMX: public RData {
         void setPreference(const uint newPreference) { mPreference = newPreference; };
         uint getPreference() { return mPreference; };
 
-        void setExchange(const std::string& newExchange) { mExchange = newExchange; };
-        std::string getExchange() { return mExchange; };
+        void setExchange(const DomainName& newExchange) { mExchange = newExchange; };
+        const DomainName& getExchange() const { return mExchange; };
 
         virtual void decode(Buffer &buffer, const uint size);
         virtual void encode(Buffer &buffer);
@@ -225,7 +227,7 @@ class RDataMX: public RData {
         uint mPreference;
         // A <domain-name> which specifies a host willing to act
         // as a mail exchange for the owner name
-        std::string mExchange;
+        DomainName mExchange;
 };
 
 /** Generic RData field which stores raw RData bytes.
@@ -234,7 +236,7 @@ class RDataMX: public RData {
  * class for appropriate type is not implemented. */
 class RDataNULL : public RData {
     public:
-        RDataNULL() : mDataSize(0), mData(NULL) { };
+        RDataNULL() : mDataSize(0), mDataCapacity(0), mData(NULL) { };
         virtual ~RDataNULL();
         virtual eRDataType getType() { return RDATA_NULL; };
         virtual void decode(Buffer &buffer, const uint size);
@@ -242,8 +244,9 @@ class RDataNULL : public RData {
         virtual std::string asString();
 
     private:
-        // raw data
+        // raw data (allocated memory is kept when object is reused)
         uint mDataSize;
+        uint mDataCapacity;
         char* mData;
 };
 
@@ -276,16 +279,16 @@ class RDataPTR: public RDataWithName {
  */
 class RDataSOA: public RData {
     public:
-        RDataSOA() : mMName(""), mRName(""), mSerial(0), mRefresh(0), mRetry(0), mExpire(0), mMinimum(0) { };
+        RDataSOA() : mSerial(0), mRefresh(0), mRetry(0), mExpire(0), mMinimum(0) { };
         virtual ~RDataSOA() { };
 
         virtual eRDataType getType() { return RDATA_SOA; };
 
-        void setMName(const std::string& newMName) { mMName = newMName; };
-        std::string getMName() { return mMName; };
+        void setMName(const DomainName& newMName) { mMName = newMName; };
+        const DomainName& getMName() const { return mMName; };
 
-        void setRName(const std::string& newRName) { mRName = newRName; };
-        std::string getRName() { return mRName; };
+        void setRName(const DomainName& newRName) { mRName = newRName; };
+        const DomainName& getRName() const { return mRName; };
 
         void setSerial(const uint newSerial) { mSerial = newSerial; };
         uint getSerial() { return mSerial; };
@@ -309,10 +312,10 @@ class RDataSOA: public RData {
     private:
         // The <domain-name> of the name server that was the
         // original or primary source of data for this zone.
-        std::string mMName;
+        DomainName mMName;
         // A <domain-name> which specifies the mailbox of the
         // person responsible for this zone.
-        std::string mRName;
+        DomainName mRName;
         // The unsigned 32 bit version number of the original copy
         // of the zone.  Zone transfers preserve this value.  This
         // value wraps and should be compared using sequence space
@@ -383,7 +386,7 @@ class RDataA: public RData {
  */
 class RDataWKS: public RData {
     public:
-        RDataWKS() : mProtocol(0), mBitmap(NULL), mBitmapSize(0) { for (uint i = 0; i < 4; i++) mAddr[i] = 0; };
+        RDataWKS() : mProtocol(0), mBitmap(NULL), mBitmapSize(0), mBitmapCapacity(0) { for (uint i = 0; i < 4; i++) mAddr[i] = 0; };
         virtual ~RDataWKS();
         virtual eRDataType getType() { return RDATA_WKS; };
 
@@ -409,6 +412,8 @@ class RDataWKS: public RData {
         char *mBitmap;
         // Size of bitmap
         uint mBitmapSize;
+        // Size of allocated bitmap (it is kept when object is reused)
+        uint mBitmapCapacity;
 };
 
 /**
@@ -437,7 +442,7 @@ class RDataAAAA: public RData {
 // http://www.ietf.org/rfc/rfc2915.txt - NAPTR
 class RDataNAPTR : public RData {
     public:
-        RDataNAPTR() : mOrder(0), mPreference(0), mFlags(""), mServices(""), mRegExp(""), mReplacement("") { };
+        RDataNAPTR() : mOrder(0), mPreference(0), mFlags(""), mServices(""), mRegExp("") { };
         virtual ~RDataNAPTR() { };
 
         virtual eRDataType getType() { return RDATA_NAPTR; };
@@ -452,8 +457,8 @@ class RDataNAPTR : public RData {
         std::string getServices () { return mServices; };
         void setRegExp (std::string newRegExp) { mRegExp = newRegExp; };
         std::string getRegExp () { return mRegExp; };
-        void setReplacement (std::string newReplacement) { mReplacement = newReplacement; };
-        std::string getReplacement () { return mReplacement; };
+        void setReplacement (const DomainName& newReplacement) { mReplacement = newReplacement; };
+        const DomainName& getReplacement () const { return mReplacement; };
 
         virtual void decode(Buffer &buffer, const uint size);
         virtual void encode(Buffer &buffer);
@@ -465,7 +470,7 @@ class RDataNAPTR : public RData {
         std::string mFlags;
         std::string mServices;
         std::string mRegExp;
-        std::string mReplacement;
+        DomainName mReplacement;
 };
 
 /**
@@ -473,7 +478,7 @@ class RDataNAPTR : public RData {
  */
 class RDataSRV : public RData {
     public:
-        RDataSRV() { };
+        RDataSRV() : mPriority(0), mWeight(0), mPort(0) { };
         virtual ~RDataSRV() { };
         virtual eRDataType getType() { return RDATA_SRV; };
         virtual void decode(Buffer &buffer, const uint size);
@@ -486,16 +491,182 @@ class RDataSRV : public RData {
         uint getWeight() const { return mWeight; };
         void setPort(const uint newPort) { mPort = newPort; };
         uint getPort() const { return mPort; };
-        void setTarget(const std::string newTarget) { mTarget = newTarget; };
-        std::string getTarget() const { return mTarget; };
+        void setTarget(const DomainName& newTarget) { mTarget = newTarget; };
+        const DomainName& getTarget() const { return mTarget; };
 
     private:
         uint mPriority;
         uint mWeight;
         uint mPort;
-        std::string mTarget;
+        DomainName mTarget;
 };
 
+/**
+ * OPT pseudo record representation (EDNS0, RFC 6891)
+ *
+ * Only options are stored in RData, the requestor's UDP payload size is
+ * carried by CLASS field and extended RCODE, version and flags by TTL field
+ * of the record (see Message which handles these fields).
+ *
+ *                  +0 (MSB)                            +1 (LSB)
+ *       +---+---+---+---+---+---+---+---+---+---+---+---+---+---+---+---+
+ *    0: |                          OPTION-CODE                          |
+ *       +---+---+---+---+---+---+---+---+---+---+---+---+---+---+---+---+
+ *    2: |                         OPTION-LENGTH                         |
+ *       +---+---+---+---+---+---+---+---+---+---+---+---+---+---+---+---+
+ *    4: |                                                               |
+ *       /                          OPTION-DATA                          /
+ *       /                                                               /
+ *       +---+---+---+---+---+---+---+---+---+---+---+---+---+---+---+---+
+ */
+class RDataOPT : public RData {
+    public:
+        struct Option
+        {
+            uint code;
+            std::string data;
+        };
+
+        RDataOPT() { };
+        virtual ~RDataOPT() { };
+        virtual eRDataType getType() { return RDATA_OPT; };
+        virtual void decode(Buffer &buffer, const uint size);
+        virtual void encode(Buffer &buffer);
+        virtual std::string asString();
+
+        void addOption(const uint code, const std::string& data);
+        const std::vector<Option>& getOptions() const { return mOptions; };
+        void clearOptions() { mOptions.clear(); };
+
+        // size of options in wire format
+        uint getSize() const;
+
+    private:
+        std::vector<Option> mOptions;
+};
+// Function which creates empty RData of one type (heap is used if arena is NULL)
+typedef RData* (*RDataFactory)(Arena* arena);
+
+// Function which creates RData of one type and decodes it from buffer
+typedef RData* (*RDataDecoder)(Buffer &buffer, const uint size, Arena* arena);
+
+// Function which checks if raw rdata contains compression links
+typedef bool (*RDataLinkCheck)(const char* rdata, const uint size);
+
+template<class T>
+RData* createRData(Arena* arena) { return new (arena) T(); }
+
+template<class T>
+RData* decodeRData(Buffer &buffer, const uint size, Arena* arena)
+{
+    T* rdata = new (arena) T();
+    try
+    {
+        rdata->decode(buffer, size);
+    }
+    catch (...)
+    {
+        delete rdata;
+        throw;
+    }
+    return rdata;
+}
+
+/**
+ * Description of RData type used for decoding
+ */
+struct RDataType
+{
+    RDataFactory create;
+    RDataDecoder decode;
+    // RDLENGTH of every valid rdata (RDataRegistry::VARIABLE_SIZE if it is not fixed)
+    uint fixedSize;
+    // rdata contains domain names which could be compressed (raw rdata can't be
+    // copied to another message as is)
+    bool compressedNames;
+    // check of names which must not be compressed, but older servers compress
+    // them (RFC 3597, section 4), raw rdata with links is not copied (NULL if
+    // rdata has no such names)
+    RDataLinkCheck hasLinks;
+};
+
+/**
+ * Registry of RData types indexed by type code
+ *
+ * Types without registration are decoded as RDataNULL (raw data). Custom types
+ * could be registered at startup, registry must not be modified while records
+ * are decoded.
+ */
+class RDataRegistry
+{
+    public:
+        static const uint VARIABLE_SIZE = 0xFFFFFFFF;
+
+        // registry used by ResourceRecord::decode
+        static RDataRegistry& instance();
+
+        // Register RData type (existing registration of type is replaced)
+        void add(const uint type, RDataFactory create, RDataDecoder decode, const uint fixedSize = VARIABLE_SIZE, const bool compressedNames = false, RDataLinkCheck hasLinks = NULL);
+
+        template<class T>
+        void add(const uint type, const uint fixedSize = VARIABLE_SIZE, const bool compressedNames = false, RDataLinkCheck hasLinks = NULL) { add(type, createRData<T>, decodeRData<T>, fixedSize, compressedNames, hasLinks); }
+
+        // Get description of type (description of RDataNULL for unknown types)
+        const RDataType& get(const uint type) const;
+
+        // Create empty RData of type
+        RData* create(const uint type, Arena* arena = NULL) const { return get(type).create(arena); }
+
+    private:
+        // number of types stored in table (other types are stored in map)
+        static const uint TABLE_SIZE = 256;
+
+        RDataRegistry();
+
+        // types with codes lower than TABLE_SIZE
+        RDataType mTable[TABLE_SIZE];
+        // types with higher codes
+        std::map<uint, RDataType> mOther;
+        // description used for unknown types
+        RDataType mUnknown;
+};
+
+/**
+ * Free list of rdata objects used for recycling of decoded records
+ *
+ * Objects are grouped by decoder which created them (e.g. all unknown types
+ * share list of RDataNULL objects), recycled object is decoded again by its
+ * own decode() method.
+ */
+class RDataFreeList
+{
+    public:
+        RDataFreeList() { }
+        ~RDataFreeList() { clear(); }
+        RDataFreeList(const RDataFreeList&) = delete;
+        RDataFreeList& operator=(const RDataFreeList&) = delete;
+
+        // Store rdata allocated on heap (ownership is taken)
+        void put(RData* rdata);
+
+        // Take rdata created by decoder (NULL if there is no such object)
+        RData* get(RDataDecoder decoder);
+
+        // Delete all stored objects
+        void clear();
+
+        void swap(RDataFreeList& other) { mLists.swap(other.mLists); }
+
+    private:
+        struct List
+        {
+            RDataDecoder decoder;
+            std::vector<RData*> items;
+        };
+
+        // few lists are expected, they are searched sequentially
+        std::vector<List> mLists;
+};
 
 /** Represents DNS Resource Record
  *
@@ -548,36 +719,53 @@ class RDataSRV : public RData {
  *                 For example, the if the TYPE is A and the CLASS is IN,
  *                 the RDATA field is a 4 octet ARPA Internet address.
  */
-class ResourceRecord
+class ResourceRecord : public ArenaObject
 {
     public:
         /* Constructor */
-        ResourceRecord() : mName(""), mType (RDATA_NULL), mClass(CLASS_IN), mTtl(0), mRDataSize(0), mRData(NULL) { };
+        ResourceRecord() : mType (RDATA_NULL), mClass(CLASS_IN), mTtl(0), mRDataSize(0), mRData(NULL), mWire(NULL), mWireSize(0), mRDataPos(0), mArena(NULL) { };
         ~ResourceRecord();
 
-        void setName(std::string newName) { mName = newName; };
-        uint getName() const;
+        void setName(const DomainName& newName) { mName = newName; };
+        const DomainName& getName() const { return mName; };
 
         void setType(const eRDataType type) { mType = type; };
-        eRDataType getType() const;
+        eRDataType getType() const { return mType; };
 
         void setClass(eClass newClass) { mClass = newClass; };
-        eClass getClass() const;
+        eClass getClass() const { return mClass; };
 
         void setTtl(uint newTtl) { mTtl = newTtl; };
-        uint getTtl() const;
+        uint getTtl() const { return mTtl; };
+
+        void setRData(RData *newRData) { mRData = newRData; mType = newRData->getType(); mWire = NULL; };
 
-        void setRData(RData *newRData) { mRData = newRData; mType = newRData->getType(); };
-        //const char* getRData() const;
+        // Get rdata (lazily decoded rdata is decoded on first access, exception
+        // is thrown if it is malformed)
+        RData* getRData() const;
 
-        void decode(Buffer &buffer);
+        // Check if rdata is kept in wire format only (not decoded yet)
+        bool isRDataRaw() const { return mWire != NULL; }
+
+        // Take rdata out of record (caller becomes owner)
+        RData* releaseRData() { RData* rdata = mRData; mRData = NULL; mWire = NULL; return rdata; }
+
+        // Decode resource record from buffer
+        // @param arena - arena used for allocation of rdata (heap is used if NULL)
+        // @param lazy - rdata is not decoded, only its position in buffer is remembered
+        //               (buffer must stay valid until rdata is accessed or record is encoded)
+        // @param freeList - rdata objects which could be reused (optional)
+        void decode(Buffer &buffer, Arena* arena = NULL, const bool lazy = false, RDataFreeList* freeList = NULL);
+
+        // Encode resource record to buffer (raw rdata without compressed names
+        // is copied as is, rdata with links is decoded and encoded again)
         void encode(Buffer &buffer);
 
         std::string asString();
 
     private:
         /* Domain name to which this resource record pertains */
-        std::string mName;
+        DomainName mName;
 
         /* Type field */
         eRDataType mType;
@@ -592,7 +780,20 @@ class ResourceRecord
         uint mRDataSize;
 
         /* rdata */
-        RData *mRData;
+        mutable RData *mRData;
+
+        /* message wire data with raw rdata (NULL if rdata is decoded) */
+        mutable const char* mWire;
+        uint mWireSize;
+
+        /* position of raw rdata in message */
+        uint mRDataPos;
+
+        /* arena for lazily decoded rdata */
+        Arena* mArena;
+
+        // decode rdata from buffer positioned at its beginning
+        void decodeRData(Buffer &buffer, Arena* arena, RDataFreeList* freeList) const;
 };
 
 } // namespace
@@ -0,0 +1,671 @@
+/**
+ * DNS Zone Snapshot
+ *
+ * Copyright (c) 2014 Michal Nezerka
+ * All rights reserved.
+ *
+ * Developed by: Michal Nezerka
+ *               https://github.com/mnezerka/
+ *               mailto:michal.nezerka@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal with the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimers.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimers in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Michal Nezerka, nor the names of its contributors
+ *    may be used to endorse or promote products derived from this Software
+ *    without specific prior written permission. 
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "snapshot.h"
+#include "exception.h"
+
+using namespace dns;
+using namespace std;
+
+/////////// file layout ///////////
+
+// Header is followed by origin name, array of nodes, hash table of children,
+// array of RRsets, labels of nodes and records of RRsets. Numbers are stored
+// in byte order of writer, offsets are counted from the start of file.
+struct ZoneSnapshot::Header
+{
+    char magic[8];
+    uint32_t version;
+    // BYTE_ORDER_MARK in byte order of writer
+    uint32_t byteOrder;
+    uint64_t fileSize;
+    // checksum of file behind header
+    uint64_t checksum;
+    uint32_t zoneClass;
+    uint32_t nodeCount;
+    uint32_t rrsetCount;
+    // size of hash table of children minus one
+    uint32_t slotMask;
+    // offsets of sections
+    uint64_t origin;
+    uint64_t nodes;
+    uint64_t slots;
+    uint64_t rrsets;
+};
+
+struct ZoneSnapshot::NodeEntry
+{
+    // offset of label (length octet followed by lower cased characters)
+    uint64_t label;
+    uint32_t parent;
+    // RRsets of node are stored one after another
+    uint32_t firstRRset;
+    uint32_t rrsetCount;
+    uint32_t cut;
+};
+
+struct ZoneSnapshot::RRsetEntry
+{
+    // offset of records, positions of records and positions of links follow
+    // records (aligned to 4 bytes)
+    uint64_t data;
+    uint32_t type;
+    uint32_t rrClass;
+    uint32_t count;
+    uint32_t size;
+    uint32_t linkCount;
+    uint32_t maxLinkTarget;
+};
+
+namespace {
+
+const char MAGIC[8] = { 'D', 'N', 'S', 'Z', 'O', 'N', 'E', 0 };
+const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+uint64_t align(const uint64_t offset, const uint64_t alignment)
+{
+    return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+// hash of child in hash table (lower cased label and index of parent)
+uint childHash(const uint parent, const char* label)
+{
+    uint h = 2166136261u;
+    uint len = static_cast<uchar>(label[0]) + 1;
+    for (uint i = 0; i < len; i++)
+        h = (h ^ lowerChar(label[i])) * 16777619u;
+
+    return h ^ (parent * 2654435761u);
+}
+
+/**
+ * FNV-1a like checksum computed over 64 bit words (tail is padded by zeros)
+ */
+class Checksum
+{
+    public:
+        Checksum() : mHash(14695981039346656037ull), mTailSize(0) { }
+
+        void update(const char* data, size_t size);
+
+        uint64_t get() const;
+
+    private:
+        uint64_t mHash;
+        char mTail[8];
+        uint mTailSize;
+
+        static uint64_t mix(uint64_t hash, const char* word);
+};
+
+void Checksum::update(const char* data, size_t size)
+{
+    if (mTailSize > 0)
+    {
+        size_t n = min(size, static_cast<size_t>(8 - mTailSize));
+        memcpy(mTail + mTailSize, data, n);
+        mTailSize += n;
+        data += n;
+        size -= n;
+        if (mTailSize < 8)
+            return;
+        mHash = mix(mHash, mTail);
+        mTailSize = 0;
+    }
+
+    uint64_t hash = mHash;
+    for (; size >= 8; data += 8, size -= 8)
+        hash = mix(hash, data);
+    mHash = hash;
+
+    memcpy(mTail, data, size);
+    mTailSize = size;
+}
+
+uint64_t Checksum::get() const
+{
+    if (mTailSize == 0)
+        return mHash;
+
+    char word[8] = { 0 };
+    memcpy(word, mTail, mTailSize);
+
+    return mix(mHash, word);
+}
+
+uint64_t Checksum::mix(uint64_t hash, const char* word)
+{
+    uint64_t w;
+    memcpy(&w, word, sizeof(w));
+    hash = (hash ^ w) * 1099511628211ull;
+
+    return hash ^ (hash >> 32);
+}
+
+/**
+ * Sequential writer of snapshot file
+ *
+ * Space for header is skipped, header is written at the end when checksum
+ * of the rest of file is known.
+ */
+class SnapshotWriter
+{
+    public:
+        SnapshotWriter(const string& fileName, const uint headerSize);
+        ~SnapshotWriter();
+
+        void put(const void* data, const size_t size);
+
+        // write zero bytes up to multiple of alignment
+        void pad(const uint64_t alignment);
+
+        uint64_t getPos() const { return mPos; }
+        uint64_t getChecksum() const { return mChecksum.get(); }
+
+        // write header and close file
+        void finish(const void* header, const uint headerSize);
+
+    private:
+        string mFileName;
+        FILE *mFile;
+        uint64_t mPos;
+        Checksum mChecksum;
+
+        void fail();
+
+        SnapshotWriter(const SnapshotWriter&) = delete;
+        SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+};
+
+SnapshotWriter::SnapshotWriter(const string& fileName, const uint headerSize) : mFileName(fileName), mFile(NULL), mPos(headerSize)
+{
+    mFile = fopen(fileName.c_str(), "wb");
+    if (mFile == NULL)
+        throw(Exception("Can't create snapshot file '" + fileName + "': " + strerror(errno)));
+    if (fseek(mFile, headerSize, SEEK_SET) != 0)
+        fail();
+}
+
+SnapshotWriter::~SnapshotWriter()
+{
+    if (mFile != NULL)
+    {
+        fclose(mFile);
+        remove(mFileName.c_str());
+    }
+}
+
+void SnapshotWriter::put(const void* data, const size_t size)
+{
+    if (size == 0)
+        return;
+    if (fwrite(data, 1, size, mFile) != size)
+        fail();
+    mChecksum.update(static_cast<const char*>(data), size);
+    mPos += size;
+}
+
+void SnapshotWriter::pad(const uint64_t alignment)
+{
+    static const char zeros[8] = { 0 };
+    put(zeros, align(mPos, alignment) - mPos);
+}
+
+void SnapshotWriter::finish(const void* header, const uint headerSize)
+{
+    if (fseek(mFile, 0, SEEK_SET) != 0 || fwrite(header, 1, headerSize, mFile) != headerSize || fflush(mFile) != 0)
+        fail();
+    int result = fclose(mFile);
+    mFile = NULL;
+    if (result != 0)
+    {
+        remove(mFileName.c_str());
+        throw(Exception("Can't write snapshot file '" + mFileName + "': " + strerror(errno)));
+    }
+}
+
+void SnapshotWriter::fail()
+{
+    throw(Exception("Can't write snapshot file '" + mFileName + "': " + strerror(errno)));
+}
+
+} // namespace
+
+/////////// ZoneSnapshot ///////////
+
+void ZoneSnapshot::write(const Zone& zone, const string& fileName)
+{
+    const LabelTree<Zone::Node> &tree = zone.mTree;
+    uint nodeCount = tree.getSize();
+    uint rrsetCount = zone.mRRsets.size();
+
+    // hash table is at most half full
+    uint slotCount = 2;
+    while (slotCount < nodeCount * 2)
+        slotCount *= 2;
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.zoneClass = zone.mClass;
+    header.nodeCount = nodeCount;
+    header.rrsetCount = rrsetCount;
+    header.slotMask = slotCount - 1;
+    header.origin = sizeof(Header);
+    header.nodes = align(header.origin + zone.mOrigin.getWireLen(), 8);
+    header.slots = header.nodes + static_cast<uint64_t>(nodeCount) * sizeof(NodeEntry);
+    header.rrsets = align(header.slots + static_cast<uint64_t>(slotCount) * sizeof(uint), 8);
+    uint64_t labels = header.rrsets + static_cast<uint64_t>(rrsetCount) * sizeof(RRsetEntry);
+    uint64_t records = align(labels + tree.getLabelsSize(), 4);
+
+    // new file is renamed when it is complete, so file which is in use is not modified
+    string tmpFileName = fileName + ".tmp";
+    SnapshotWriter out(tmpFileName, sizeof(Header));
+    out.put(zone.mOrigin.getWire(), zone.mOrigin.getWireLen());
+    out.pad(8);
+
+    // RRsets of zone are chained per node, they are written ordered by nodes
+    vector<uint> rrsets;
+    rrsets.reserve(rrsetCount);
+    for (uint i = 0; i < nodeCount; i++)
+    {
+        NodeEntry node;
+        node.label = labels + (tree.getLabel(i) - tree.getLabels());
+        node.parent = tree.getParent(i);
+        node.firstRRset = rrsets.size();
+        for (uint rrset = tree[i].firstRRset; rrset != Zone::NO_RRSET; rrset = zone.mNextRRset[rrset])
+            rrsets.push_back(rrset);
+        node.rrsetCount = rrsets.size() - node.firstRRset;
+        node.cut = tree[i].cut;
+        out.put(&node, sizeof(node));
+    }
+
+    vector<uint> slots(slotCount, 0);
+    for (uint i = 1; i < nodeCount; i++)
+    {
+        uint slot = childHash(tree.getParent(i), tree.getLabel(i)) & header.slotMask;
+        while (slots[slot] != 0)
+            slot = (slot + 1) & header.slotMask;
+        slots[slot] = i;
+    }
+    out.put(slots.data(), slots.size() * sizeof(uint));
+    out.pad(8);
+
+    for (uint i = 0; i < rrsetCount; i++)
+    {
+        RRsetView view = zone.mRRsets[rrsets[i]].getView();
+        RRsetEntry rrset;
+        rrset.data = records;
+        rrset.type = view.getType();
+        rrset.rrClass = view.getClass();
+        rrset.count = view.getCount();
+        rrset.size = view.getSize();
+        rrset.linkCount = view.getLinkCount();
+        rrset.maxLinkTarget = view.getMaxLinkTarget();
+        out.put(&rrset, sizeof(rrset));
+        records += align(rrset.size, 4) + (static_cast<uint64_t>(rrset.count) + rrset.linkCount) * sizeof(uint);
+    }
+
+    out.put(tree.getLabels(), tree.getLabelsSize());
+    out.pad(4);
+
+    for (uint i = 0; i < rrsetCount; i++)
+    {
+        RRsetView view = zone.mRRsets[rrsets[i]].getView();
+        out.put(view.getData(), view.getSize());
+        out.pad(4);
+        out.put(view.getRecords(), view.getCount() * sizeof(uint));
+        out.put(view.getLinks(), view.getLinkCount() * sizeof(uint));
+    }
+    out.pad(8);
+
+    header.fileSize = out.getPos();
+    header.checksum = out.getChecksum();
+    out.finish(&header, sizeof(header));
+
+    if (rename(tmpFileName.c_str(), fileName.c_str()) != 0)
+    {
+        int error = errno;
+        remove(tmpFileName.c_str());
+        throw(Exception("Can't write snapshot file '" + fileName + "': " + strerror(error)));
+    }
+}
+
+void ZoneSnapshot::open(const string& fileName, const bool verify)
+{
+    close();
+
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd == -1)
+        throw(Exception("Can't open snapshot file '" + fileName + "': " + strerror(errno)));
+
+    struct stat st;
+    if (fstat(fd, &st) == -1)
+    {
+        int error = errno;
+        ::close(fd);
+        throw(Exception("Can't read snapshot file '" + fileName + "': " + strerror(error)));
+    }
+
+    if (st.st_size > 0)
+    {
+        void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            int error = errno;
+            ::close(fd);
+            throw(Exception("Can't map snapshot file '" + fileName + "': " + strerror(error)));
+        }
+        mData = static_cast<const char*>(data);
+        mSize = st.st_size;
+    }
+    ::close(fd);
+
+    try
+    {
+        attach(verify);
+    }
+    catch (Exception &e)
+    {
+        close();
+        throw(Exception("Snapshot file '" + fileName + "' " + e.what()));
+    }
+
+    // pages are touched by lookups at random, read ahead would be wasted
+    madvise(const_cast<char*>(mData), mSize, MADV_RANDOM);
+}
+
+void ZoneSnapshot::attach(const bool verify)
+{
+    if (mSize < sizeof(Header) || memcmp(mData, MAGIC, sizeof(MAGIC)) != 0)
+        throw(Exception("is not zone snapshot"));
+
+    const Header *header = reinterpret_cast<const Header*>(mData);
+    if (header->byteOrder != BYTE_ORDER_MARK)
+        throw(Exception("was written on machine with different byte order"));
+    if (header->version != VERSION)
+        throw(Exception("has version " + to_string(header->version) + ", version " + to_string(VERSION) + " is expected"));
+    if (header->fileSize != mSize)
+        throw(Exception("is truncated"));
+
+    uint64_t slotCount = static_cast<uint64_t>(header->slotMask) + 1;
+    if (header->nodeCount == 0 || (slotCount & header->slotMask) != 0 || slotCount <= header->nodeCount
+        || header->origin >= mSize
+        || header->nodes % 8 != 0 || header->nodes > mSize || (mSize - header->nodes) / sizeof(NodeEntry) < header->nodeCount
+        || header->slots % 4 != 0 || header->slots > mSize || (mSize - header->slots) / sizeof(uint) < slotCount
+        || header->rrsets % 8 != 0 || header->rrsets > mSize || (mSize - header->rrsets) / sizeof(RRsetEntry) < header->rrsetCount)
+        throw(Exception("is damaged (invalid layout)"));
+
+    // origin must be valid name inside of file
+    const char* origin = mData + header->origin;
+    uint pos = 0;
+    uint labels = 0;
+    while (header->origin + pos < mSize && origin[pos] != 0)
+    {
+        uint len = static_cast<uchar>(origin[pos]);
+        if (len > MAX_LABEL_LEN || pos + len + 1 >= MAX_DOMAIN_LEN)
+            throw(Exception("is damaged (invalid origin)"));
+        pos += len + 1;
+        labels++;
+    }
+    if (header->origin + pos >= mSize)
+        throw(Exception("is damaged (invalid origin)"));
+
+    if (verify)
+    {
+        Checksum checksum;
+        checksum.update(mData + sizeof(Header), mSize - sizeof(Header));
+        if (checksum.get() != header->checksum)
+            throw(Exception("is damaged (checksum mismatch)"));
+    }
+
+    mHeader = header;
+    mOrigin = origin;
+    mOriginLabels = labels;
+    mNodes = reinterpret_cast<const NodeEntry*>(mData + header->nodes);
+    mSlots = reinterpret_cast<const uint*>(mData + header->slots);
+    mRRsets = reinterpret_cast<const RRsetEntry*>(mData + header->rrsets);
+}
+
+void ZoneSnapshot::close()
+{
+    if (mData != NULL)
+        munmap(const_cast<char*>(mData), mSize);
+
+    mData = NULL;
+    mSize = 0;
+    mHeader = NULL;
+    mOrigin = NULL;
+    mOriginLabels = 0;
+    mNodes = NULL;
+    mSlots = NULL;
+    mRRsets = NULL;
+}
+
+DomainName ZoneSnapshot::getOrigin() const
+{
+    DomainName origin;
+    if (mOrigin != NULL)
+        origin.fromWire(mOrigin);
+
+    return origin;
+}
+
+uint ZoneSnapshot::getClass() const
+{
+    return mHeader != NULL ? mHeader->zoneClass : 0;
+}
+
+uint ZoneSnapshot::getNodeCount() const
+{
+    return mHeader != NULL ? mHeader->nodeCount : 0;
+}
+
+uint ZoneSnapshot::getRRsetCount() const
+{
+    return mHeader != NULL ? mHeader->rrsetCount : 0;
+}
+
+RRsetView ZoneSnapshot::find(const DomainName& owner, const uint type) const
+{
+    if (mHeader == NULL || owner.getLabelCount() < mOriginLabels)
+        return RRsetView();
+
+    uint i = owner.getLabelCount() - mOriginLabels;
+    if (!isInside(owner.getWire(), owner.getLabelOffset(i)))
+        return RRsetView();
+
+    uint node = 0;
+    while (i-- > 0)
+    {
+        node = findChild(node, owner.getLabel(i));
+        if (node == 0)
+            return RRsetView();
+    }
+
+    return findRRset(node, type);
+}
+
+eZoneResult ZoneSnapshot::lookup(const char* qname, const uint qtype, SnapshotLookup& lookup) const
+{
+    // offsets of labels, the last one is offset of root label
+    uint labels[DomainName::MAX_LABELS + 1];
+    uint labelCount = 0;
+    uint pos = 0;
+    while (qname[pos] != 0 && labelCount < DomainName::MAX_LABELS)
+    {
+        labels[labelCount++] = pos;
+        pos += static_cast<uchar>(qname[pos]) + 1;
+    }
+    labels[labelCount] = pos;
+
+    lookup.rrset = RRsetView();
+    lookup.ownerOffset = 0;
+    lookup.wildcard = false;
+    lookup.encloserOffset = 0;
+    lookup.soa = RRsetView();
+    lookup.originOffset = 0;
+
+    if (mHeader == NULL || labelCount < mOriginLabels || !isInside(qname, labels[labelCount - mOriginLabels]))
+        return lookup.result = ZONE_NOT_AUTH;
+    lookup.originOffset = labels[labelCount - mOriginLabels];
+    lookup.soa = findRRset(0, RDATA_SOA);
+
+    // labels below origin are walked from the top one, the walk stops at zone
+    // cut or at the closest encloser
+    uint node = 0;
+    uint i = labelCount - mOriginLabels;
+    while (i > 0)
+    {
+        uint child = findChild(node, qname + labels[i - 1]);
+        if (child == 0)
+            break;
+        node = child;
+        i--;
+
+        if (mNodes[node].cut)
+        {
+            lookup.rrset = findRRset(node, RDATA_NS);
+            lookup.ownerOffset = labels[i];
+            lookup.encloserOffset = labels[i];
+            return lookup.result = ZONE_DELEGATION;
+        }
+    }
+    lookup.encloserOffset = labels[i];
+
+    // exact match
+    if (i == 0)
+        return answer(node, qtype, lookup);
+
+    // answer is synthesized from wildcard child of the closest encloser
+    uint wildcard = findChild(node, "\001*");
+    if (wildcard == 0)
+        return lookup.result = ZONE_NXDOMAIN;
+    lookup.wildcard = true;
+
+    return answer(wildcard, qtype, lookup);
+}
+
+eZoneResult ZoneSnapshot::answer(const uint node, const uint qtype, SnapshotLookup& lookup) const
+{
+    lookup.ownerOffset = 0;
+    lookup.rrset = findRRset(node, qtype);
+    if (!lookup.rrset.isEmpty())
+        return lookup.result = ZONE_ANSWER;
+
+    if (qtype != RDATA_CNAME)
+    {
+        lookup.rrset = findRRset(node, RDATA_CNAME);
+        if (!lookup.rrset.isEmpty())
+            return lookup.result = ZONE_CNAME;
+    }
+
+    // name without RRsets is empty non-terminal, it exists as well
+    return lookup.result = ZONE_NODATA;
+}
+
+bool ZoneSnapshot::isInside(const char* name, const uint suffixOffset) const
+{
+    // origin is compared including its root label
+    uint i = 0;
+    do
+    {
+        if (lowerChar(name[suffixOffset + i]) != lowerChar(mOrigin[i]))
+            return false;
+    }
+    while (mOrigin[i++] != 0);
+
+    return true;
+}
+
+uint ZoneSnapshot::findChild(const uint parent, const char* label) const
+{
+    uint len = static_cast<uchar>(label[0]) + 1;
+    uint slot = childHash(parent, label) & mHeader->slotMask;
+    // probes are limited by size of table and damaged entries are skipped
+    for (uint probe = 0; probe <= mHeader->slotMask && mSlots[slot] != 0; probe++, slot = (slot + 1) & mHeader->slotMask)
+    {
+        uint node = mSlots[slot];
+        if (node >= mHeader->nodeCount || mNodes[node].parent != parent || mNodes[node].label > mSize - len)
+            continue;
+        const char* childLabel = mData + mNodes[node].label;
+        uint i = 0;
+        while (i < len && childLabel[i] == static_cast<char>(lowerChar(label[i])))
+            i++;
+        if (i == len)
+            return node;
+    }
+
+    return 0;
+}
+
+RRsetView ZoneSnapshot::findRRset(const uint node, const uint type) const
+{
+    const NodeEntry &n = mNodes[node];
+    if (n.firstRRset > mHeader->rrsetCount || n.rrsetCount > mHeader->rrsetCount - n.firstRRset)
+        return RRsetView();
+
+    for (uint i = n.firstRRset; i < n.firstRRset + n.rrsetCount; i++)
+    {
+        const RRsetEntry &rrset = mRRsets[i];
+        if (rrset.type == type)
+        {
+            // records and links must be inside of file (their positions are checked when RRset is written)
+            if (rrset.data % 4 != 0 || rrset.data > mSize
+                || align(rrset.size, 4) + (static_cast<uint64_t>(rrset.count) + rrset.linkCount) * sizeof(uint) > mSize - rrset.data)
+                return RRsetView();
+
+            const char* data = mData + rrset.data;
+            const uint* records = reinterpret_cast<const uint*>(data + align(rrset.size, 4));
+            return RRsetView(rrset.type, rrset.rrClass, rrset.count, data, rrset.size, records, records + rrset.count, rrset.linkCount, rrset.maxLinkTarget);
+        }
+    }
+
+    return RRsetView();
+}
@@ -0,0 +1,165 @@
+/**
+ * DNS Zone Snapshot
+ *
+ * Copyright (c) 2014 Michal Nezerka
+ * All rights reserved.
+ *
+ * Developed by: Michal Nezerka
+ *               https://github.com/mnezerka/
+ *               mailto:michal.nezerka@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal with the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimers.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimers in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Michal Nezerka, nor the names of its contributors
+ *    may be used to endorse or promote products derived from this Software
+ *    without specific prior written permission. 
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ */
+
+#ifndef _DNS_SNAPSHOT_H
+#define	_DNS_SNAPSHOT_H
+
+#include <string>
+
+#include "dns.h"
+#include "name.h"
+#include "zone.h"
+
+namespace dns {
+
+/**
+ * Answer found in snapshot (see ZoneLookup, RRsets not found are empty)
+ */
+struct SnapshotLookup
+{
+    eZoneResult result;
+    RRsetView rrset;
+    uint ownerOffset;
+    bool wildcard;
+    uint encloserOffset;
+    RRsetView soa;
+    uint originOffset;
+};
+
+/**
+ * Compiled zone stored in file which is mapped to memory
+ *
+ * Snapshot holds tree of names (nodes with hashed index of children) and
+ * pre-encoded RRsets of Zone in flat layout where all references are offsets
+ * from the start of file, so file is used in place: open() maps it and checks
+ * its header, nothing is allocated or copied and pages are read when lookups
+ * touch them. Lookups give the same answers as Zone they were written from.
+ *
+ *     ZoneSnapshot::write(zone, "example.com.snap");
+ *     ...
+ *     ZoneSnapshot snapshot;
+ *     snapshot.open("example.com.snap");
+ *     SnapshotLookup lookup;
+ *     if (snapshot.lookup(query.qname, query.qtype, lookup) == ZONE_ANSWER)
+ *         lookup.rrset.write(buffer, 12 + lookup.ownerOffset);
+ *
+ * Header holds format version, byte order and checksum of the rest of file,
+ * files of other versions or architectures and truncated files are rejected.
+ * Checksum is verified only on request, because it reads whole file. Without
+ * it lookups check each offset taken from file against its size, so damaged
+ * entries are treated as missing and file is never read outside of its end.
+ */
+class ZoneSnapshot
+{
+    public:
+        // version of file format (files of other versions are rejected)
+        static const uint VERSION = 1;
+
+        ZoneSnapshot() : mData(NULL), mSize(0), mHeader(NULL), mOrigin(NULL), mOriginLabels(0), mNodes(NULL), mSlots(NULL), mRRsets(NULL) { }
+        ~ZoneSnapshot() { close(); }
+
+        // Write zone to file (file is replaced atomically, exception is thrown on error)
+        static void write(const Zone& zone, const std::string& fileName);
+
+        // Map snapshot file (exception is thrown if file is not valid snapshot)
+        // @param verify - compute checksum of file (whole file is read), by
+        //                 default only header is checked and pages of file
+        //                 are read lazily by lookups
+        void open(const std::string& fileName, const bool verify = false);
+
+        // Unmap file (RRset views of previous lookups become invalid)
+        void close();
+
+        bool isOpen() const { return mData != NULL; }
+
+        DomainName getOrigin() const;
+        uint getClass() const;
+
+        // number of names in zone (including empty non-terminals and origin)
+        uint getNodeCount() const;
+
+        // number of RRsets in zone
+        uint getRRsetCount() const;
+
+        // Find RRset by owner and type (no wildcard or delegation processing)
+        // @return view of RRset (empty if it doesn't exist)
+        RRsetView find(const DomainName& owner, const uint type) const;
+
+        // Look up query name and type (see Zone::lookup)
+        // @param qname - name in wire format without compression links (e.g. QueryPeek::qname)
+        eZoneResult lookup(const char* qname, const uint qtype, SnapshotLookup& lookup) const;
+
+        eZoneResult lookup(const DomainName& qname, const uint qtype, SnapshotLookup& lookup) const { return this->lookup(qname.getWire(), qtype, lookup); }
+
+    private:
+        // layout of file (defined in snapshot.cpp)
+        struct Header;
+        struct NodeEntry;
+        struct RRsetEntry;
+
+        const char* mData;
+        size_t mSize;
+        const Header* mHeader;
+        // zone origin in wire format
+        const char* mOrigin;
+        uint mOriginLabels;
+        const NodeEntry* mNodes;
+        // hash table of children (indexes of nodes, 0 is empty slot)
+        const uint* mSlots;
+        const RRsetEntry* mRRsets;
+
+        ZoneSnapshot(const ZoneSnapshot&) = delete;
+        ZoneSnapshot& operator=(const ZoneSnapshot&) = delete;
+
+        // check header of mapped file and locate sections (exception is thrown if file is not valid)
+        void attach(const bool verify);
+
+        // check if name ends with zone origin
+        bool isInside(const char* name, const uint suffixOffset) const;
+
+        // find child of node by label
+        uint findChild(const uint parent, const char* label) const;
+
+        // find RRset of node by type
+        RRsetView findRRset(const uint node, const uint type) const;
+
+        // find RRset of node for query type
+        eZoneResult answer(const uint node, const uint qtype, SnapshotLookup& lookup) const;
+};
+
+} // namespace
+#endif	/* _DNS_SNAPSHOT_H */
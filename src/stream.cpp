@@ -0,0 +1,121 @@
+/**
+ * DNS Stream Transport Codec
+ *
+ * Copyright (c) 2014 Michal Nezerka
+ * All rights reserved.
+ *
+ * Developed by: Michal Nezerka
+ *               https://github.com/mnezerka/
+ *               mailto:michal.nezerka@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal with the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimers.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimers in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Michal Nezerka, nor the names of its contributors
+ *    may be used to endorse or promote products derived from this Software
+ *    without specific prior written permission. 
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ */
+
+#include <cstring>
+
+#include "stream.h"
+#include "exception.h"
+
+using namespace dns;
+using namespace std;
+
+/////////// StreamDecoder ///////////
+
+void StreamDecoder::feed(const char* data, const uint size)
+{
+    memcpy(prepare(size), data, size);
+    commit(size);
+}
+
+char* StreamDecoder::prepare(const uint size)
+{
+    // move incomplete message to the beginning of buffer, all complete
+    // messages were already taken
+    if (mStart > 0)
+    {
+        if (mEnd > mStart)
+            memmove(mBuffer.data(), mBuffer.data() + mStart, mEnd - mStart);
+        mEnd -= mStart;
+        mStart = 0;
+    }
+
+    if (mBuffer.size() < mEnd + size)
+        mBuffer.resize(mEnd + size);
+
+    return mBuffer.data() + mEnd;
+}
+
+bool StreamDecoder::next(const char*& message, uint &size)
+{
+    if (mEnd - mStart < 2)
+        return false;
+
+    const uchar* lenField = reinterpret_cast<const uchar*>(mBuffer.data() + mStart);
+    uint len = (lenField[0] << 8) + lenField[1];
+    if (mEnd - mStart < len + 2)
+        return false;
+
+    message = mBuffer.data() + mStart + 2;
+    size = len;
+    mStart += len + 2;
+
+    return true;
+}
+
+/////////// StreamEncoder ///////////
+
+bool StreamEncoder::add(Message &message)
+{
+    bool truncated = message.encode(mMessage, Message::MAX_ENCODED_LEN);
+    add(mMessage.data(), mMessage.size());
+
+    return truncated;
+}
+
+void StreamEncoder::add(const char* message, const uint size)
+{
+    // length prefix would wrap and desynchronize all following messages
+    if (size > 0xFFFF)
+        throw(Exception("Message is too large for TCP stream"));
+
+    // drop data which was already written
+    if (mStart > 0 && mStart == mBuffer.size())
+        clear();
+
+    uint pos = mBuffer.size();
+    mBuffer.resize(pos + size + 2);
+    mBuffer[pos] = (size >> 8) & 0xFF;
+    mBuffer[pos + 1] = size & 0xFF;
+    memcpy(mBuffer.data() + pos + 2, message, size);
+}
+
+void StreamEncoder::consume(const uint size)
+{
+    mStart += size < getSize() ? size : getSize();
+    if (mStart == mBuffer.size())
+        clear();
+}
@@ -0,0 +1,135 @@
+/**
+ * DNS Stream Transport Codec
+ *
+ * Copyright (c) 2014 Michal Nezerka
+ * All rights reserved.
+ *
+ * Developed by: Michal Nezerka
+ *               https://github.com/mnezerka/
+ *               mailto:michal.nezerka@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal with the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimers.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimers in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Michal Nezerka, nor the names of its contributors
+ *    may be used to endorse or promote products derived from this Software
+ *    without specific prior written permission. 
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ */
+
+#ifndef _DNS_STREAM_H
+#define	_DNS_STREAM_H
+
+#include <vector>
+
+#include "dns.h"
+#include "message.h"
+
+namespace dns {
+
+/**
+ * Decoder of messages received over stream transport (TCP)
+ *
+ * Each message is prefixed by two byte length field (RFC 1035, 4.2.2).
+ * Received data is appended to decoder in chunks of any size (message could
+ * be split between chunks, one chunk could contain several pipelined
+ * messages) and complete messages are taken one by one without copying.
+ *
+ *     StreamDecoder decoder;
+ *     int n = recv(fd, decoder.prepare(4096), 4096, 0);
+ *     decoder.commit(n);
+ *     while (decoder.next(data, size))
+ *         message.decode(data, size);
+ */
+class StreamDecoder
+{
+    public:
+        StreamDecoder() : mStart(0), mEnd(0) { }
+
+        // Append received data
+        void feed(const char* data, const uint size);
+
+        // Get space for at least size bytes which could be received directly
+        // to decoder, number of received bytes is passed to commit()
+        char* prepare(const uint size);
+        void commit(const uint size) { mEnd += size; }
+
+        // Take next complete message (without length field)
+        // @param message - set to message data, valid until next call of feed() or prepare()
+        // @param size - set to size of message
+        // @return false if there is no complete message
+        bool next(const char*& message, uint &size);
+
+        // number of buffered bytes which don't form complete message yet
+        uint getPending() const { return mEnd - mStart; }
+
+        // drop all buffered data
+        void clear() { mStart = mEnd = 0; }
+
+    private:
+        // received data
+        std::vector<char> mBuffer;
+        // start of data which was not taken yet
+        uint mStart;
+        // end of received data
+        uint mEnd;
+};
+
+/**
+ * Encoder of messages sent over stream transport (TCP)
+ *
+ * Messages are encoded with two byte length field one after another to one
+ * contiguous buffer, so several responses could be sent by one write. Data
+ * which couldn't be written is kept for the next write.
+ */
+class StreamEncoder
+{
+    public:
+        StreamEncoder() : mStart(0) { }
+
+        // Encode message and append it to output data
+        // @return true if message was truncated to maximal message size
+        bool add(Message &message);
+
+        // Append message which is already encoded (exception is thrown if it is longer than 65535 bytes)
+        void add(const char* message, const uint size);
+
+        // output data
+        const char* getData() const { return mBuffer.data() + mStart; }
+        uint getSize() const { return mBuffer.size() - mStart; }
+
+        // Remove size bytes from the beginning of output data (after they were written)
+        void consume(const uint size);
+
+        // drop all output data
+        void clear() { mBuffer.clear(); mStart = 0; }
+
+    private:
+        // output data
+        std::vector<char> mBuffer;
+        // start of data which was not written yet
+        uint mStart;
+        // storage for encoding of single message
+        std::vector<char> mMessage;
+};
+
+} // namespace
+#endif	/* _DNS_STREAM_H */
@@ -34,11 +34,23 @@
  */
 
 #include <iostream>
+#include <cstring>
+#include <sstream>
+#include <unordered_set>
 
 #include "exception.h"
 #include "message.h"
 #include "rr.h"
 #include "buffer.h"
+#include "view.h"
+#include "stream.h"
+#include "response.h"
+#include "record.h"
+#include "policy.h"
+#include "labeltree.h"
+#include "zone.h"
+#include "master.h"
+#include "snapshot.h"
 #include "assert.h"
 
 using namespace std;
@@ -62,6 +74,41 @@ void testBuffer()
     assert (strCheck == "www.google.com");
 }
 
+// check decoding of domain names with compression links
+void testBufferDomainNameLinks()
+{
+    char b[] = "\x01\x61\x00\x01\x62\xc0\x00\xc0\x03\xc0\x0b\x00";
+    dns::Buffer buff(b, sizeof(b) - 1);
+
+    // link to name which ends with link
+    buff.setPos(7);
+    assert (buff.getDnsDomainName() == "b.a");
+    assert (buff.getPos() == 9);
+
+    // name in wire format
+    char name[dns::MAX_DOMAIN_LEN];
+    buff.setPos(3);
+    assert (buff.getDnsDomainName(name, true) == 5);
+    assert (memcmp(name, "\x01\x62\x01\x61\x00", 5) == 0);
+    assert (buff.getPos() == 7);
+
+    // link which doesn't point to prior data
+    buff.setPos(9);
+    try
+    {
+        buff.getDnsDomainName();
+        assert (false);
+    }
+    catch (dns::Exception const&) { /* ok */ };
+
+    // links are not allowed
+    buff.setThrowing(false);
+    buff.setPos(3);
+    assert (buff.getDnsDomainName(name, false) == 0);
+    assert (buff.getError() == dns::DECODE_POINTER_NOT_ALLOWED);
+    assert (buff.getErrorPos() == 5);
+}
+
 // check encoding of empty domain name
 void testBufferEmptyDomainName()
 {
@@ -110,6 +157,131 @@ void testBufferDotEndedDomainName()
     assert (buffer[9] == 'x');
 }
 
+// check compression of domain names written to buffer
+void testBufferNameCompression()
+{
+    char buffer[100];
+    dns::Buffer dnsBuffer(buffer, sizeof(buffer));
+    dnsBuffer.putDnsDomainName("www.google.com");
+    assert (dnsBuffer.getPos() == 16);
+
+    // same name (case differs) is replaced by link to the first one
+    dnsBuffer.putDnsDomainName("WWW.Google.COM");
+    assert (dnsBuffer.getPos() == 18);
+    assert (buffer[16] == '\xc0');
+    assert (buffer[17] == '\x00');
+
+    // only first label is written, suffix is linked
+    dnsBuffer.putDnsDomainName("mail.google.com");
+    assert (dnsBuffer.getPos() == 25);
+    assert (buffer[18] == '\x04');
+    assert (buffer[23] == '\xc0');
+    assert (buffer[24] == '\x04');
+
+    // name written with link is a compression target as well
+    dnsBuffer.putDnsDomainName("mail.google.com");
+    assert (dnsBuffer.getPos() == 27);
+    assert (buffer[25] == '\xc0');
+    assert (buffer[26] == '\x12');
+
+    // names written without compression are also targets for compression
+    dnsBuffer.putDnsDomainName("sip.ims", false);
+    assert (dnsBuffer.getPos() == 36);
+    dnsBuffer.putDnsDomainName("ims");
+    assert (dnsBuffer.getPos() == 38);
+    assert (buffer[36] == '\xc0');
+    assert (buffer[37] == '\x1f');
+
+    // decoding of compressed names
+    dnsBuffer.setPos(16);
+    assert (dnsBuffer.getDnsDomainName() == "www.google.com");
+    dnsBuffer.setPos(25);
+    assert (dnsBuffer.getDnsDomainName() == "mail.google.com");
+    dnsBuffer.setPos(36);
+    assert (dnsBuffer.getDnsDomainName() == "ims");
+
+    // all names of large message are compression targets
+    char largeBuffer[0x4000];
+    dns::Buffer large(largeBuffer, sizeof(largeBuffer));
+    std::vector<uint> offsets;
+    for (uint i = 0; i < 1500; i++)
+    {
+        offsets.push_back(large.getPos());
+        large.putDnsDomainName("h" + std::to_string(i) + ".example.com");
+    }
+    uint pos = large.getPos();
+    large.putDnsDomainName("H1499.example.com");
+    assert (large.getPos() == pos + 2);
+    auto linkTarget = [&](const uint linkPos) -> uint { return (static_cast<dns::uchar>(largeBuffer[linkPos]) & 0x3F) * 256 + static_cast<dns::uchar>(largeBuffer[linkPos + 1]); };
+    assert (linkTarget(pos) == offsets[1499]);
+
+    // names behind rewound position are forgotten, names before it are kept
+    large.rewind(offsets[1000]);
+    large.putDnsDomainName("h1200.example.com");
+    assert (large.getPos() == offsets[1000] + 8);
+    large.putDnsDomainName("h999.example.com");
+    assert (linkTarget(offsets[1000] + 8) == offsets[999]);
+    large.rewind(offsets[100]);
+    large.putDnsDomainName("h99.example.com");
+    assert (large.getPos() == offsets[100] + 2);
+    large.putDnsDomainName("h100.example.com");
+    assert (large.getPos() == offsets[100] + 2 + 7);
+}
+
+// check domain name value (labels, comparison, hashing)
+void testDomainName()
+{
+    dns::DomainName root;
+    assert (root.isRoot());
+    assert (root.getWireLen() == 1);
+    assert (root.toString() == "");
+    assert (dns::DomainName(".") == root);
+
+    dns::DomainName n("Blue.IMS.cz.");
+    assert (n.getLabelCount() == 3);
+    assert (n.getWireLen() == 13);
+    assert (memcmp(n.getWire(), "\x04" "Blue" "\x03" "IMS" "\x02" "cz" "\x00", 13) == 0);
+    assert (n.getLabelOffset(1) == 5);
+    assert (n.getLabelOffset(3) == 12);
+    assert (*n.getLabel(2) == 2);
+    assert (n.toString() == "Blue.IMS.cz");
+
+    // comparison and hash are case insensitive
+    dns::DomainName n2(std::string("blue.ims.CZ"));
+    assert (n == n2);
+    assert (n == "blue.ims.cz");
+    assert (n.hash() == n2.hash());
+    assert (n != "ims.cz");
+    assert (dns::DomainName("a.cz") < dns::DomainName("B.cz"));
+    assert (!(n < n2) && !(n2 < n));
+
+    std::unordered_set<dns::DomainName> names;
+    names.insert(n);
+    assert (names.count(dns::DomainName("BLUE.ims.cz")) == 1);
+
+    // decoding from buffer
+    char b[] = "\x03\x77\x77\x77\x06\x67\x6f\x6f\x67\x6c\x65\x03\x63\x6f\x6d\x00";
+    dns::Buffer buff(b, sizeof(b) - 1);
+    dns::DomainName decoded;
+    assert (buff.getDnsDomainName(decoded));
+    assert (decoded == "www.google.com");
+    assert (decoded.getLabelCount() == 3);
+
+    // invalid names
+    bool thrown = false;
+    try { dns::DomainName("a..cz"); } catch (dns::Exception& e) { thrown = true; }
+    assert (thrown);
+    thrown = false;
+    try { dns::DomainName(std::string(64, 'a')); } catch (dns::Exception& e) { thrown = true; }
+    assert (thrown);
+    thrown = false;
+    std::string longName;
+    for (uint i = 0; i < 64; i++)
+        longName.append("abc.");
+    try { dns::DomainName name(longName); } catch (dns::Exception& e) { thrown = true; }
+    assert (thrown);
+}
+
 void testBufferCharacterString()
 {
     // check encoding of domain name
@@ -303,6 +475,13 @@ void testSRV()
     assert (r.getWeight() == 0);
     assert (r.getPort() == 5269);
     assert (r.getTarget() == "alt2.xmpp-server.l.google.com");
+
+    // target is encoded as uncompressed domain name
+    char out[100];
+    dns::Buffer b2(out, sizeof(out));
+    r.encode(b2);
+    assert (b2.getPos() == sizeof(dasrv) - 1);
+    assert (memcmp(out, dasrv, b2.getPos()) == 0);
 }
 
 void testPacket()
@@ -331,12 +510,12 @@ void testPacket()
     assert (m1.getNsCount() == 0);
     assert (m1.getArCount() == 0);
 
-    std::vector<dns::QuerySection*> qs = m1.getQueries();
+    const dns::QueryList& qs = m1.getQueries();
     assert (qs[0]->getType() == dns::CLASS_IN);
     assert (qs[0]->getClass() == dns::QCLASS_IN);
     assert (qs[0]->getName() == "www.google.com");
 
-    std::vector<dns::ResourceRecord*> answers = m1.getAnswers();
+    const dns::RecordList& answers = m1.getAnswers();
     std::string expected[] = {"<<CNAME domainName=www.l.google.com\n", "<<RData A addr=66.249.91.104\n", "<<RData A addr=66.249.91.99\n", "<<RData A addr=66.249.91.103\n", "<<RData A addr=66.249.91.147\n"};
     for (long unsigned int i = 0; i < answers.size(); i++) {
         assert(answers[i]->asString() == expected[i]);
@@ -382,6 +561,1829 @@ void testPacketInvalid()
     catch (dns::Exception const&) { /* ok */ };
 }
 
+void testMessageView()
+{
+    char packet[] = "\xd5\xad\x81\x80\x00\x01\x00\x05\x00\x00\x00\x00\x03\x77\x77\x77\x06\x67\x6f\x6f\x67\x6c\x65\x03\x63\x6f\x6d\x00\x00\x01\x00\x01\xc0\x0c\x00\x05\x00\x01\x00\x00\x00\x05\x00\x08\x03\x77\x77\x77\x01\x6c\xc0\x10\xc0\x2c\x00\x01\x00\x01\x00\x00\x00\x05\x00\x04\x42\xf9\x5b\x68\xc0\x2c\x00\x01\x00\x01\x00\x00\x00\x05\x00\x04\x42\xf9\x5b\x63\xc0\x2c\x00\x01\x00\x01\x00\x00\x00\x05\x00\x04\x42\xf9\x5b\x67\xc0\x2c\x00\x01\x00\x01\x00\x00\x00\x05\x00\x04\x42\xf9\x5b\x93";
+    dns::MessageView v;
+    v.parse(packet, sizeof(packet) - 1);
+    assert (v.getId() == 0xd5ad);
+    assert (v.getQr() == 1);
+    assert (v.getRD() == 1);
+    assert (v.getRA() == 1);
+    assert (v.getQdCount() == 1);
+    assert (v.getAnCount() == 5);
+    assert (v.getAuthorities().empty());
+
+    for (dns::QuestionView q : v.getQuestions())
+    {
+        assert (q.getNameOffset() == 12);
+        assert (q.getType() == dns::RDATA_A);
+        assert (q.getClass() == dns::QCLASS_IN);
+        assert (v.getName(q.getNameOffset()) == "www.google.com");
+    }
+
+    dns::uint count = 0;
+    char name[dns::MAX_DOMAIN_LEN + 1];
+    for (dns::RecordView rr : v.getAnswers())
+    {
+        assert (rr.getTtl() == 5);
+        if (count == 0)
+        {
+            assert (rr.getType() == dns::RDATA_CNAME);
+            assert (v.getName(rr.getNameOffset(), name) == 14);
+            assert (string(name) == "www.google.com");
+            assert (v.getName(rr.getRDataOffset()) == "www.l.google.com");
+        }
+        else
+        {
+            assert (rr.getType() == dns::RDATA_A);
+            assert (v.getName(rr.getNameOffset()) == "www.l.google.com");
+            assert (rr.getRDataLength() == 4);
+            assert (rr.getRData()[0] == '\x42');
+        }
+        count++;
+    }
+    assert (count == 5);
+
+    // compression link pointing to itself
+    char packetLoop[] = "\x00\x01\x01\x00\x00\x01\x00\x00\x00\x00\x00\x00\xc0\x0c\x00\x01\x00\x01";
+    try
+    {
+        v.parse(packetLoop, sizeof(packetLoop) - 1);
+        assert (false);
+    }
+    catch (dns::Exception const&) { /* ok */ };
+
+    // truncated record
+    try
+    {
+        v.parse(packet, sizeof(packet) - 2);
+        assert (false);
+    }
+    catch (dns::Exception const&) { /* ok */ };
+}
+
+void testArena()
+{
+    dns::Arena arena(256);
+    void* p1 = arena.allocate(10);
+    void* p2 = arena.allocate(10);
+    assert (static_cast<char*>(p2) - static_cast<char*>(p1) == dns::Arena::ALIGNMENT);
+    assert (arena.getBlockCount() == 1);
+
+    // large allocation gets its own block
+    arena.allocate(1000);
+    assert (arena.getBlockCount() == 2);
+
+    // blocks are reused after reset
+    arena.reset();
+    assert (arena.allocate(10) == p1);
+    arena.allocate(1000);
+    assert (arena.getBlockCount() == 2);
+
+    // decoded records are allocated from arena, memory is reused for next packets
+    char packet[] = "\xd5\xad\x81\x80\x00\x01\x00\x05\x00\x00\x00\x00\x03\x77\x77\x77\x06\x67\x6f\x6f\x67\x6c\x65\x03\x63\x6f\x6d\x00\x00\x01\x00\x01\xc0\x0c\x00\x05\x00\x01\x00\x00\x00\x05\x00\x08\x03\x77\x77\x77\x01\x6c\xc0\x10\xc0\x2c\x00\x01\x00\x01\x00\x00\x00\x05\x00\x04\x42\xf9\x5b\x68\xc0\x2c\x00\x01\x00\x01\x00\x00\x00\x05\x00\x04\x42\xf9\x5b\x63\xc0\x2c\x00\x01\x00\x01\x00\x00\x00\x05\x00\x04\x42\xf9\x5b\x67\xc0\x2c\x00\x01\x00\x01\x00\x00\x00\x05\x00\x04\x42\xf9\x5b\x93";
+    dns::Arena msgArena;
+    dns::Message m;
+    m.setArena(&msgArena);
+    m.decode(packet, sizeof(packet) - 1);
+    assert (msgArena.getBlockCount() == 1);
+    // one question, five records and five rdata objects
+    assert (msgArena.getAllocationCount() == 11);
+    assert (m.getAnswers()[1]->asString() == "<<RData A addr=66.249.91.104\n");
+
+    // records created by user could be mixed with arena records
+    m.addAnswer(dns::ResourceRecordPtr(new dns::ResourceRecord()));
+
+    for (unsigned int i = 0; i < 10; i++)
+        m.decode(packet, sizeof(packet) - 1);
+    assert (msgArena.getBlockCount() == 1);
+    assert (msgArena.getAllocationCount() == 11 * 11);
+}
+
+void testDecodeErrors()
+{
+    dns::Message m;
+    dns::MessageView v;
+    dns::uint errorOffset;
+
+    char packetOk[] = "\x00\x01\x01\x00\x00\x01\x00\x00\x00\x00\x00\x00\x01\x61\x00\x00\x01\x00\x01";
+    assert (m.decode(packetOk, sizeof(packetOk) - 1, errorOffset) == dns::DECODE_OK);
+    assert (v.parse(packetOk, sizeof(packetOk) - 1, errorOffset) == dns::DECODE_OK);
+
+    // missing qclass
+    assert (m.decode(packetOk, sizeof(packetOk) - 3, errorOffset) == dns::DECODE_TRUNCATED);
+    assert (errorOffset == 17);
+    assert (v.parse(packetOk, sizeof(packetOk) - 3, errorOffset) == dns::DECODE_TRUNCATED);
+
+    // header only
+    assert (m.decode(packetOk, 5, errorOffset) == dns::DECODE_TRUNCATED);
+    assert (v.parse(packetOk, 5, errorOffset) == dns::DECODE_TRUNCATED);
+
+    char packetTrailing[] = "\x00\x01\x01\x00\x00\x01\x00\x00\x00\x00\x00\x00\x01\x61\x00\x00\x01\x00\x01\xff";
+    assert (m.decode(packetTrailing, sizeof(packetTrailing) - 1, errorOffset) == dns::DECODE_TRAILING_BYTES);
+    assert (errorOffset == 19);
+    assert (v.parse(packetTrailing, sizeof(packetTrailing) - 1, errorOffset) == dns::DECODE_TRAILING_BYTES);
+    assert (errorOffset == 19);
+
+    char packetLoop[] = "\x00\x01\x01\x00\x00\x01\x00\x00\x00\x00\x00\x00\xc0\x0c\x00\x01\x00\x01";
+    assert (m.decode(packetLoop, sizeof(packetLoop) - 1, errorOffset) == dns::DECODE_POINTER_LOOP);
+    assert (v.parse(packetLoop, sizeof(packetLoop) - 1, errorOffset) == dns::DECODE_POINTER_LOOP);
+
+    char packetBadPointer[] = "\x00\x01\x01\x00\x00\x01\x00\x00\x00\x00\x00\x00\xc0\xff\x00\x01\x00\x01";
+    assert (m.decode(packetBadPointer, sizeof(packetBadPointer) - 1, errorOffset) == dns::DECODE_BAD_POINTER);
+    assert (v.parse(packetBadPointer, sizeof(packetBadPointer) - 1, errorOffset) == dns::DECODE_BAD_POINTER);
+
+    char packetLongLabel[] = "\x00\x01\x01\x00\x00\x01\x00\x00\x00\x00\x00\x00\x41\x61\x00\x00\x01\x00\x01";
+    assert (m.decode(packetLongLabel, sizeof(packetLongLabel) - 1, errorOffset) == dns::DECODE_LABEL_TOO_LONG);
+    assert (v.parse(packetLongLabel, sizeof(packetLongLabel) - 1, errorOffset) == dns::DECODE_LABEL_TOO_LONG);
+
+    // A record with wrong rdata length
+    char packetRData[] = "\x00\x01\x81\x00\x00\x00\x00\x01\x00\x00\x00\x00\x00\x00\x01\x00\x01\x00\x00\x00\x05\x00\x05\x01\x02\x03\x04\x05";
+    assert (m.decode(packetRData, sizeof(packetRData) - 1, errorOffset) == dns::DECODE_BAD_RDATA_LENGTH);
+    assert (v.parse(packetRData, sizeof(packetRData) - 1, errorOffset) == dns::DECODE_OK);
+
+    // throwing api reports the same errors
+    try
+    {
+        m.decode(packetLoop, sizeof(packetLoop) - 1);
+        assert (false);
+    }
+    catch (dns::Exception const& e)
+    {
+        assert (string(e.what()) == dns::getDecodeErrorText(dns::DECODE_POINTER_LOOP));
+    };
+}
+
+// create A record
+static dns::ResourceRecordPtr createRecordA(const char* name, const char* addr)
+{
+    dns::ResourceRecordPtr rr(new dns::ResourceRecord());
+    rr->setName(name);
+    rr->setTtl(60);
+    dns::RDataA *rdata = new dns::RDataA();
+    rdata->setAddress(addr);
+    rr->setRData(rdata);
+    return rr;
+}
+
+// check encoding to growable buffer and truncation by RRsets
+void testEncodeTruncated()
+{
+    dns::Message m;
+    m.setId(7);
+    m.setQr(dns::Message::typeResponse);
+    dns::QuerySection *qs = new dns::QuerySection("www.example.com");
+    qs->setType(dns::RDATA_A);
+    m.addQuery(dns::QuerySectionPtr(qs));
+    // two RRsets in answer section, one in additional section
+    for (uint i = 0; i < 3; i++)
+        m.addAnswer(createRecordA("www.example.com", "10.0.0.1"));
+    for (uint i = 0; i < 2; i++)
+        m.addAnswer(createRecordA("mail.example.com", "10.0.0.2"));
+    m.addAdditional(createRecordA("ns.example.com", "10.0.0.3"));
+
+    // whole message
+    std::vector<char> out;
+    assert (!m.encode(out));
+    dns::Message full;
+    full.decode(out.data(), out.size());
+    assert (full.getTC() == 0);
+    assert (full.getAnCount() == 5);
+    assert (full.getArCount() == 1);
+    uint fullSize = out.size();
+
+    // buffer is enlarged on demand and its allocation is reused
+    for (uint i = 0; i < 100; i++)
+        m.addAuthority(createRecordA("example.com", "10.0.0.4"));
+    assert (!m.encode(out));
+    assert (out.size() > dns::MAX_MSG_LEN);
+    const char* data = out.data();
+    assert (!m.encode(out));
+    assert (out.data() == data);
+    dns::MessageView big;
+    big.parse(out.data(), out.size());
+    assert (big.getNsCount() == 100);
+    // authority RRset doesn't fit, additional records are left out as well
+    assert (m.encode(out, dns::MAX_MSG_LEN));
+    assert (out.size() <= dns::MAX_MSG_LEN);
+    dns::Message cut;
+    cut.decode(out.data(), out.size());
+    assert (cut.getTC() == 1);
+    assert (cut.getAnCount() == 5);
+    assert (cut.getNsCount() == 0);
+    assert (cut.getArCount() == 0);
+
+    // second RRset of answer section doesn't fit
+    dns::Message m2;
+    m2.setId(8);
+    m2.setQr(dns::Message::typeResponse);
+    m2.addQuery(dns::QuerySectionPtr(new dns::QuerySection("www.example.com")));
+    for (uint i = 0; i < 3; i++)
+        m2.addAnswer(createRecordA("www.example.com", "10.0.0.1"));
+    for (uint i = 0; i < 2; i++)
+        m2.addAnswer(createRecordA("mail.example.com", "10.0.0.2"));
+    char buffer[100];
+    uint size;
+    assert (m2.encodeTruncated(buffer, 100, size));
+    dns::Message part;
+    part.decode(buffer, size);
+    assert (part.getTC() == 1);
+    assert (part.getAnCount() == 3);
+    assert (part.getAnswers()[2]->getName() == "www.example.com");
+
+    // missing additional records don't set TC
+    assert (m.getAuthorities().size() == 100);
+    dns::Message m3;
+    m3.addQuery(dns::QuerySectionPtr(new dns::QuerySection("www.example.com")));
+    m3.addAnswer(createRecordA("www.example.com", "10.0.0.1"));
+    m3.addAdditional(createRecordA("ns.example.com", "10.0.0.3"));
+    assert (m3.encodeTruncated(buffer, 60, size));
+    dns::Message noAdditional;
+    noAdditional.decode(buffer, size);
+    assert (noAdditional.getTC() == 0);
+    assert (noAdditional.getAnCount() == 1);
+    assert (noAdditional.getArCount() == 0);
+
+    // message which fits exactly
+    m3.encode(buffer, 100, size);
+    uint exactSize = size;
+    assert (!m3.encodeTruncated(buffer, exactSize, size));
+    assert (size == exactSize);
+    assert (fullSize > exactSize);
+
+    // not even header fits
+    assert (m3.encodeTruncated(buffer, 11, size));
+    assert (size == 0);
+
+    // old interface still reports small buffer by exception
+    bool thrown = false;
+    try { m2.encode(buffer, 100, size); } catch (dns::Exception& e) { thrown = true; }
+    assert (thrown);
+}
+
+// check decoding and encoding of EDNS0 OPT record
+void testEdns()
+{
+    // query with OPT record (udp size 4096, DO flag, COOKIE option)
+    char query[] = "\x12\x34\x01\x00\x00\x01\x00\x00\x00\x00\x00\x01\x03\x77\x77\x77\x06\x67\x6f\x6f\x67\x6c\x65\x03\x63\x6f\x6d\x00\x00\x01\x00\x01"
+        "\x00\x00\x29\x10\x00\x00\x00\x80\x00\x00\x0c\x00\x0a\x00\x08\x01\x02\x03\x04\x05\x06\x07\x08";
+    dns::Message m;
+    m.decode(query, sizeof(query) - 1);
+    assert (m.hasEdns());
+    assert (m.getArCount() == 0);
+    assert (m.getUdpPayloadSize() == 4096);
+    assert (m.getMaxUdpSize() == 4096);
+    assert (m.getDO() == 1);
+    assert (m.getEdnsVersion() == 0);
+    assert (m.getExtendedRCode() == 0);
+    assert (m.getEdnsOptions().getOptions().size() == 1);
+    assert (m.getEdnsOptions().getOptions()[0].code == 10);
+    assert (m.getEdnsOptions().getOptions()[0].data == std::string("\x01\x02\x03\x04\x05\x06\x07\x08", 8));
+
+    // OPT record is encoded as the last additional record
+    char out[100];
+    uint size;
+    m.encode(out, sizeof(out), size);
+    assert (size == sizeof(query) - 1);
+    assert (memcmp(out, query, size) == 0);
+
+    // extended rcode is split between header and OPT record
+    m.setExtendedRCode(16);
+    assert (m.getRCode() == 0);
+    m.encode(out, sizeof(out), size);
+    dns::Message badVers;
+    badVers.decode(out, size);
+    assert (badVers.getExtendedRCode() == 16);
+
+    // message larger than 512 bytes with large records
+    dns::Message large;
+    large.setQr(dns::Message::typeResponse);
+    large.setEdns(true);
+    large.addQuery(dns::QuerySectionPtr(new dns::QuerySection("www.example.com")));
+    for (uint i = 0; i < 10; i++)
+    {
+        dns::ResourceRecord *rr = new dns::ResourceRecord();
+        rr->setName("www.example.com");
+        dns::RDataNAPTR *rdata = new dns::RDataNAPTR();
+        rdata->setRegExp(std::string(100, 'x'));
+        rr->setRData(rdata);
+        large.addAnswer(dns::ResourceRecordPtr(rr));
+    }
+    std::vector<char> wire;
+    assert (!large.encode(wire, dns::EDNS_UDP_PAYLOAD_SIZE));
+    assert (wire.size() > dns::MAX_MSG_LEN);
+    dns::Message decoded;
+    decoded.decode(wire.data(), wire.size());
+    assert (decoded.getAnCount() == 10);
+    assert (decoded.hasEdns());
+
+    // OPT record is kept in truncated message
+    assert (large.encode(wire, dns::MAX_MSG_LEN));
+    decoded.decode(wire.data(), wire.size());
+    assert (decoded.getTC() == 1);
+    assert (decoded.getAnCount() == 0);
+    assert (decoded.hasEdns());
+
+    // duplicated OPT record
+    char twoOpts[] = "\x12\x34\x01\x00\x00\x00\x00\x00\x00\x00\x00\x02\x00\x00\x29\x10\x00\x00\x00\x00\x00\x00\x00\x00\x00\x29\x10\x00\x00\x00\x00\x00\x00\x00";
+    uint errorOffset;
+    assert (m.decode(twoOpts, sizeof(twoOpts) - 1, errorOffset) == dns::DECODE_BAD_OPT);
+}
+
+// check framing of messages for stream transport
+void testStream()
+{
+    // two pipelined messages in one buffer
+    dns::Message m1;
+    m1.setId(1);
+    m1.addQuery(dns::QuerySectionPtr(new dns::QuerySection("www.example.com")));
+    dns::Message m2;
+    m2.setId(2);
+    m2.addQuery(dns::QuerySectionPtr(new dns::QuerySection("mail.example.com")));
+    dns::StreamEncoder encoder;
+    assert (!encoder.add(m1));
+    assert (!encoder.add(m2));
+    const char* data = encoder.getData();
+    uint size = encoder.getSize();
+    assert (size == 2 + 33 + 2 + 34);
+    assert (data[0] == 0 && data[1] == 33);
+
+    // data is received byte by byte
+    dns::StreamDecoder decoder;
+    const char* mesg;
+    uint mesgSize;
+    uint count = 0;
+    for (uint i = 0; i < size; i++)
+    {
+        decoder.feed(data + i, 1);
+        while (decoder.next(mesg, mesgSize))
+        {
+            dns::Message m;
+            m.decode(mesg, mesgSize);
+            count++;
+            assert (m.getId() == count);
+        }
+    }
+    assert (count == 2);
+    assert (decoder.getPending() == 0);
+
+    // data is received directly to decoder in one chunk with partial message at the end
+    memcpy(decoder.prepare(size), data, size);
+    decoder.commit(size - 10);
+    assert (decoder.next(mesg, mesgSize));
+    assert (mesgSize == 33);
+    assert (!decoder.next(mesg, mesgSize));
+    assert (decoder.getPending() == 2 + 34 - 10);
+    decoder.feed(data + size - 10, 10);
+    assert (decoder.next(mesg, mesgSize));
+    assert (mesgSize == 34);
+
+    // partially written data is kept
+    encoder.consume(10);
+    assert (encoder.getSize() == size - 10);
+    assert (encoder.getData()[0] == data[10]);
+    encoder.consume(size);
+    assert (encoder.getSize() == 0);
+
+    // message which doesn't fit into length prefix is rejected, stream stays in sync
+    std::vector<char> large(0x10000, 0);
+    bool thrown = false;
+    try
+    {
+        encoder.add(large.data(), large.size());
+    }
+    catch (dns::Exception &e)
+    {
+        thrown = true;
+    }
+    assert (thrown);
+    assert (encoder.getSize() == 0);
+    encoder.add(large.data(), 0xFFFF);
+    assert (encoder.getSize() == 2 + 0xFFFF);
+    assert (encoder.getData()[0] == static_cast<char>(0xFF) && encoder.getData()[1] == static_cast<char>(0xFF));
+}
+
+// check reading of the first question without decoding of message
+void testPeekQuestion()
+{
+    char query[] = "\x12\x34\x01\x00\x00\x01\x00\x00\x00\x00\x00\x00\x03\x77\x77\x77\x06\x47\x6f\x6f\x67\x6c\x65\x03\x63\x6f\x6d\x00\x00\x23\x00\x01";
+    dns::QueryPeek q;
+    assert (dns::peekQuestion(query, sizeof(query) - 1, q) == dns::DECODE_OK);
+    assert (q.id == 0x1234);
+    assert (q.getRD() == 1);
+    assert (q.qname == query + 12);
+    assert (q.qnameSize == 16);
+    assert (q.qtype == dns::RDATA_NAPTR);
+    assert (q.qclass == dns::QCLASS_IN);
+    assert (q.qnameHash == dns::DomainName("www.google.com").hash());
+
+    // truncated question
+    for (uint i = 0; i < sizeof(query) - 1; i++)
+        assert (dns::peekQuestion(query, i, q) != dns::DECODE_OK);
+
+    // response, other opcode and wrong number of questions are rejected
+    query[2] = '\x81';
+    assert (dns::peekQuestion(query, sizeof(query) - 1, q) == dns::DECODE_NOT_QUERY);
+    query[2] = '\x11';
+    assert (dns::peekQuestion(query, sizeof(query) - 1, q) == dns::DECODE_NOT_QUERY);
+    query[2] = '\x01';
+    query[5] = '\x02';
+    assert (dns::peekQuestion(query, sizeof(query) - 1, q) == dns::DECODE_NOT_QUERY);
+    query[5] = '\x01';
+
+    // compression link in QNAME
+    query[12] = '\xc0';
+    assert (dns::peekQuestion(query, sizeof(query) - 1, q) == dns::DECODE_BAD_POINTER);
+}
+
+// check building of response directly in buffer with query
+void testResponseBuilder()
+{
+    // query with OPT record (udp size 1232)
+    char query[] = "\x12\x34\x01\x00\x00\x01\x00\x00\x00\x00\x00\x01\x03\x77\x77\x77\x06\x67\x6f\x6f\x67\x6c\x65\x03\x63\x6f\x6d\x00\x00\x01\x00\x01"
+        "\x00\x00\x29\x04\xd0\x00\x00\x00\x00\x00\x00";
+    uint querySize = sizeof(query) - 1;
+    char buffer[1500];
+    memcpy(buffer, query, querySize);
+
+    dns::ResponseBuilder builder(buffer, sizeof(buffer));
+    assert (builder.start(querySize) == dns::DECODE_OK);
+    assert (builder.hasQueryEdns());
+    assert (builder.getMaxUdpSize() == 1232);
+    builder.setEdns(dns::EDNS_UDP_PAYLOAD_SIZE);
+    builder.setAA(1);
+
+    dns::RDataA a;
+    a.setAddress("10.0.0.1");
+    assert (builder.addAnswer(dns::RDATA_A, 60, a));
+    a.setAddress("10.0.0.2");
+    assert (builder.addAnswer(dns::RDATA_A, 60, a));
+
+    // name of record is compressed against QNAME
+    dns::ResourceRecord ns;
+    ns.setName("google.com");
+    dns::RDataNS *nsData = new dns::RDataNS();
+    nsData->setName("ns1.google.com");
+    ns.setRData(nsData);
+    assert (builder.addRecord(dns::SECTION_AUTHORITY, ns));
+    // sections must be filled in order
+    assert (!builder.addAnswer(dns::RDATA_A, 60, a));
+
+    uint size = builder.finish();
+    // header, question, two answers (owner is link), NS record (2 + 10 + 6) and OPT
+    assert (size == 32 + 2 * 16 + 18 + 11);
+
+    dns::Message m;
+    m.decode(buffer, size);
+    assert (m.getId() == 0x1234);
+    assert (m.getQr() == dns::Message::typeResponse);
+    assert (m.getRD() == 1);
+    assert (m.getAA() == 1);
+    assert (m.getTC() == 0);
+    assert (m.getQueries()[0]->getName() == "www.google.com");
+    assert (m.getAnCount() == 2);
+    assert (m.getAnswers()[1]->getName() == "www.google.com");
+    assert (m.getAnswers()[1]->getRData()->asString() == "<<RData A addr=10.0.0.2");
+    assert (m.getNsCount() == 1);
+    assert (static_cast<dns::RDataNS*>(m.getAuthorities()[0]->getRData())->getName() == "ns1.google.com");
+    assert (m.hasEdns());
+    assert (m.getUdpPayloadSize() == dns::EDNS_UDP_PAYLOAD_SIZE);
+
+    // response is truncated if records don't fit
+    memcpy(buffer, query, querySize);
+    dns::ResponseBuilder small(buffer, sizeof(buffer));
+    assert (small.start(querySize) == dns::DECODE_OK);
+    small.setMaxSize(60);
+    assert (small.addAnswer(dns::RDATA_A, 60, a));
+    assert (!small.addAnswer(dns::RDATA_A, 60, a));
+    size = small.finish();
+    assert (size == 48);
+    m.decode(buffer, size);
+    assert (m.getTC() == 1);
+    assert (m.getAnCount() == 1);
+
+    // record with malformed lazily decoded rdata is dropped, nothing is thrown
+    char badMx[] = "\x00\x00\x0f\x00\x01\x00\x00\x00\x3c\x00\x04\x00\x0a\xc0\x20";
+    dns::Buffer badBuffer(badMx, sizeof(badMx) - 1);
+    dns::ResourceRecord badRecord;
+    badRecord.decode(badBuffer, NULL, true);
+    memcpy(buffer, query, querySize);
+    dns::ResponseBuilder lazy(buffer, sizeof(buffer));
+    assert (lazy.start(querySize) == dns::DECODE_OK);
+    assert (lazy.addAnswer(dns::RDATA_A, 60, a));
+    assert (!lazy.addRecord(dns::SECTION_ANSWER, badRecord));
+    assert (!lazy.addRecord(dns::SECTION_ADDITIONAL, ns));
+    size = lazy.finish();
+    assert (size == 48);
+    m.decode(buffer, size);
+    assert (m.getTC() == 1);
+    assert (m.getAnCount() == 1);
+
+    // malformed query
+    buffer[2] = '\x80';
+    dns::ResponseBuilder bad(buffer, sizeof(buffer));
+    assert (bad.start(querySize) == dns::DECODE_NOT_QUERY);
+}
+
+// check rendering of responses from pre-encoded template
+void testResponseTemplate()
+{
+    dns::Message response;
+    response.setAA(1);
+    response.addQuery(dns::QuerySectionPtr(new dns::QuerySection("template.example")));
+    // answer owned by question name, MX exchange is compressed against second record
+    dns::ResourceRecord *mx = new dns::ResourceRecord();
+    mx->setName("template.example");
+    mx->setTtl(60);
+    dns::RDataMX *mxData = new dns::RDataMX();
+    mxData->setPreference(10);
+    mxData->setExchange("mail.example.com");
+    mx->setRData(mxData);
+    dns::ResourceRecord *a = new dns::ResourceRecord();
+    a->setName("example.com");
+    a->setTtl(60);
+    dns::RDataA *aData = new dns::RDataA();
+    aData->setAddress("10.0.0.1");
+    a->setRData(aData);
+    response.addAuthority(dns::ResourceRecordPtr(a));
+    response.addAnswer(dns::ResourceRecordPtr(mx));
+
+    dns::ResponseTemplate tpl;
+    tpl.build(response);
+
+    // queries with shorter and longer names
+    const char* names[] = { "a.cz", "www.some-very-long-domain-name.example.org" };
+    for (uint i = 0; i < 2; i++)
+    {
+        dns::Message query;
+        query.setId(100 + i);
+        query.setRD(1);
+        dns::QuerySection *qs = new dns::QuerySection(names[i]);
+        qs->setType(dns::RDATA_MX);
+        query.addQuery(dns::QuerySectionPtr(qs));
+        char buffer[512];
+        uint size;
+        query.encode(buffer, sizeof(buffer), size);
+
+        dns::QueryPeek peek;
+        assert (dns::peekQuestion(buffer, size, peek) == dns::DECODE_OK);
+        size = tpl.render(buffer, sizeof(buffer), peek);
+        assert (size == 12 + peek.qnameSize + 4 + tpl.getRecordsSize());
+
+        dns::Message m;
+        m.decode(buffer, size);
+        assert (m.getId() == 100 + i);
+        assert (m.getQr() == 1);
+        assert (m.getAA() == 1);
+        assert (m.getRD() == 1);
+        assert (m.getQueries()[0]->getName() == names[i]);
+        assert (m.getAnCount() == 1);
+        assert (m.getAnswers()[0]->getName() == names[i]);
+        assert (static_cast<dns::RDataMX*>(m.getAnswers()[0]->getRData())->getExchange() == "mail.example.com");
+        assert (m.getAuthorities()[0]->getName() == "example.com");
+
+        // response doesn't fit
+        assert (tpl.render(buffer, size - 1, peek) == 0);
+    }
+}
+
+// custom rdata type used by registry test
+class RDataTest : public dns::RData {
+    public:
+        RDataTest() : mValue(0) { };
+        virtual dns::eRDataType getType() { return static_cast<dns::eRDataType>(0xFF00); };
+        virtual void decode(dns::Buffer &buffer, const uint) { mValue = buffer.get16bits(); };
+        virtual void encode(dns::Buffer &buffer) { buffer.put16bits(mValue); };
+        virtual std::string asString() { return "<<TEST"; };
+        uint mValue;
+};
+
+// check decoding of rdata by types registered in registry
+void testRDataRegistry()
+{
+    dns::RDataRegistry &registry = dns::RDataRegistry::instance();
+    assert (registry.get(dns::RDATA_A).fixedSize == 4);
+    assert (registry.get(dns::RDATA_MX).fixedSize == dns::RDataRegistry::VARIABLE_SIZE);
+
+    // WKS record is decoded as WKS
+    char wks[] = "\x00\x00\x0b\x00\x01\x00\x00\x00\x3c\x00\x06\x0a\x00\x00\x01\x06\x40";
+    dns::Buffer b1(wks, sizeof(wks) - 1);
+    dns::ResourceRecord rr1;
+    rr1.decode(b1);
+    assert (rr1.getRData()->getType() == dns::RDATA_WKS);
+    assert (static_cast<dns::RDataWKS*>(rr1.getRData())->getProtocol() == 6);
+
+    // A record with wrong length is rejected before rdata is created
+    char badA[] = "\x00\x00\x01\x00\x01\x00\x00\x00\x3c\x00\x05\x0a\x00\x00\x01\x00";
+    dns::Buffer b2(badA, sizeof(badA) - 1);
+    b2.setThrowing(false);
+    dns::ResourceRecord rr2;
+    rr2.decode(b2);
+    assert (b2.getError() == dns::DECODE_BAD_RDATA_LENGTH);
+    assert (rr2.getRData() == NULL);
+
+    // unknown types are decoded as raw data
+    char unknown[] = "\x00\xff\x00\x00\x01\x00\x00\x00\x3c\x00\x02\x12\x34";
+    dns::Buffer b3(unknown, sizeof(unknown) - 1);
+    dns::ResourceRecord rr3;
+    rr3.decode(b3);
+    assert (rr3.getRData()->getType() == dns::RDATA_NULL);
+
+    // custom type
+    registry.add<RDataTest>(0xFF00, 2);
+    dns::Buffer b4(unknown, sizeof(unknown) - 1);
+    dns::ResourceRecord rr4;
+    rr4.decode(b4);
+    assert (rr4.getRData()->getType() == 0xFF00);
+    assert (static_cast<RDataTest*>(rr4.getRData())->mValue == 0x1234);
+    dns::RData *created = registry.create(0xFF00);
+    assert (created->asString() == "<<TEST");
+    delete created;
+}
+
+// check lazy decoding of rdata and forwarding of raw rdata
+void testLazyRData()
+{
+    dns::Message m;
+    m.setId(9);
+    m.setQr(dns::Message::typeResponse);
+    m.addQuery(dns::QuerySectionPtr(new dns::QuerySection("example.com")));
+    m.addAnswer(createRecordA("www.example.com", "10.0.0.1"));
+    dns::ResourceRecord *rr = new dns::ResourceRecord();
+    rr->setName("example.com");
+    rr->setTtl(60);
+    dns::RDataMX *mx = new dns::RDataMX();
+    mx->setPreference(10);
+    mx->setExchange("mail.example.com");
+    rr->setRData(mx);
+    m.addAnswer(dns::ResourceRecordPtr(rr));
+    std::vector<char> wire;
+    m.encode(wire);
+    // exchange name is compressed (link to owner of MX record)
+    assert (wire.size() < 100);
+
+    dns::Message lazy;
+    lazy.setLazyRData(true);
+    lazy.decode(wire.data(), wire.size());
+    const dns::RecordList& answers = lazy.getAnswers();
+    assert (answers.size() == 2);
+    assert (answers[0]->isRDataRaw());
+    assert (answers[1]->isRDataRaw());
+
+    // forwarded message is equal to original (MX rdata is decoded because of links)
+    std::vector<char> forwarded;
+    lazy.encode(forwarded);
+    assert (forwarded == wire);
+    assert (answers[0]->isRDataRaw());
+    assert (!answers[1]->isRDataRaw());
+    assert (static_cast<dns::RDataMX*>(answers[1]->getRData())->getExchange() == "mail.example.com");
+
+    // rdata is decoded on first access
+    assert (static_cast<dns::RDataA*>(answers[0]->getRData())->getAddress()[3] == 1);
+    assert (!answers[0]->isRDataRaw());
+
+    // malformed rdata is detected on access
+    char badMx[] = "\x00\x00\x0f\x00\x01\x00\x00\x00\x3c\x00\x04\x00\x0a\xc0\x20";
+    dns::Buffer b1(badMx, sizeof(badMx) - 1);
+    dns::ResourceRecord rr1;
+    rr1.decode(b1, NULL, true);
+    assert (rr1.isRDataRaw());
+    bool thrown = false;
+    try
+    {
+        rr1.getRData();
+    }
+    catch (dns::Exception& e)
+    {
+        thrown = true;
+    }
+    assert (thrown);
+
+    // malformed rdata is left out of truncated message like RRset which doesn't fit
+    char badMessage[] = "\x00\x01\x81\x00\x00\x00\x00\x01\x00\x00\x00\x00"
+        "\x00\x00\x0f\x00\x01\x00\x00\x00\x3c\x00\x04\x00\x0a\xc0\x20";
+    dns::Message badLazy;
+    badLazy.setLazyRData(true);
+    badLazy.decode(badMessage, sizeof(badMessage) - 1);
+    assert (badLazy.getAnswers().size() == 1);
+    char buffer[512];
+    uint size;
+    assert (badLazy.encodeTruncated(buffer, sizeof(buffer), size));
+    dns::MessageView badView;
+    badView.parse(buffer, size);
+    assert (badView.getTC() == 1);
+    assert (badView.getAnCount() == 0);
+
+    // rdata which failed isn't returned half decoded by later calls
+    char longMx[] = "\x00\x00\x0f\x00\x01\x00\x00\x00\x3c\x00\x04\x00\x0a\x00\x00";
+    dns::Buffer b2(longMx, sizeof(longMx) - 1);
+    dns::ResourceRecord rr2;
+    rr2.decode(b2, NULL, true);
+    thrown = false;
+    try
+    {
+        rr2.getRData();
+    }
+    catch (dns::Exception& e)
+    {
+        thrown = true;
+    }
+    assert (thrown);
+    assert (rr2.getRData() == NULL);
+
+    // SRV target must not be compressed, but raw rdata is copied only if it has no link
+    dns::Message srvMessage;
+    srvMessage.setQr(dns::Message::typeResponse);
+    srvMessage.addQuery(dns::QuerySectionPtr(new dns::QuerySection("_sip._udp.example.com")));
+    dns::ResourceRecord *srvRecord = new dns::ResourceRecord();
+    srvRecord->setName("_sip._udp.example.com");
+    dns::RDataSRV *srv = new dns::RDataSRV();
+    srv->setPort(5060);
+    srv->setTarget("example.com");
+    srvRecord->setRData(srv);
+    srvMessage.addAnswer(dns::ResourceRecordPtr(srvRecord));
+    std::vector<char> srvWire;
+    srvMessage.encode(srvWire);
+    dns::Message lazySrv;
+    lazySrv.setLazyRData(true);
+    lazySrv.decode(srvWire.data(), srvWire.size());
+    forwarded.clear();
+    lazySrv.encode(forwarded);
+    assert (forwarded == srvWire);
+    assert (lazySrv.getAnswers()[0]->isRDataRaw());
+
+    // target compressed by older server (link to "example.com" in question)
+    char compressedSrv[] = "\x00\x01\x81\x00\x00\x01\x00\x01\x00\x00\x00\x00"
+        "\x04_sip\x04_udp\x07" "example\x03" "com\x00\x00\x21\x00\x01"
+        "\xc0\x0c\x00\x21\x00\x01\x00\x00\x00\x3c\x00\x08\x00\x00\x00\x00\x13\xc4\xc0\x16";
+    dns::Buffer b3(compressedSrv, sizeof(compressedSrv) - 1);
+    b3.setPos(12 + 23 + 4);
+    dns::ResourceRecord rr3;
+    rr3.decode(b3, NULL, true);
+    assert (rr3.isRDataRaw());
+    // record is decoded and target is written uncompressed
+    char out[512];
+    dns::Buffer b4(out, sizeof(out));
+    rr3.encode(b4);
+    assert (!rr3.isRDataRaw());
+    assert (static_cast<dns::RDataSRV*>(rr3.getRData())->getTarget() == "example.com");
+    assert (static_cast<dns::RDataSRV*>(rr3.getRData())->getPort() == 5060);
+    assert (b4.getPos() == 23 + 10 + 6 + 13);
+    assert (out[23 + 9] == 6 + 13);
+    assert (memcmp(out + 23 + 10 + 6, "\x07" "example\x03" "com", 13) == 0);
+}
+
+// check records with inline rdata
+void testRecord()
+{
+    // encode records of several types (MX and SOA are not stored inline)
+    std::vector<dns::ResourceRecord*> rrs;
+    rrs.push_back(createRecordA("www.example.com", "10.0.0.1").release());
+    dns::ResourceRecord *rr = new dns::ResourceRecord();
+    rr->setName("example.com");
+    dns::RDataMX *mx = new dns::RDataMX();
+    mx->setPreference(10);
+    mx->setExchange("mail.example.com");
+    rr->setRData(mx);
+    rrs.push_back(rr);
+    rr = new dns::ResourceRecord();
+    rr->setName("example.com");
+    dns::RDataSOA *soa = new dns::RDataSOA();
+    soa->setMName("ns.example.com");
+    soa->setRName("admin.example.com");
+    rr->setRData(soa);
+    rrs.push_back(rr);
+
+    char wire[512];
+    dns::Buffer b1(wire, sizeof(wire));
+    for (uint i = 0; i < rrs.size(); i++)
+    {
+        rrs[i]->encode(b1);
+        delete rrs[i];
+    }
+    uint wireSize = b1.getPos();
+
+    dns::Buffer b2(wire, wireSize);
+    std::vector<dns::Record> records;
+    dns::Record::decodeSection(b2, 3, records);
+    assert (b2.getPos() == wireSize);
+    assert (records.size() == 3);
+    assert (records[0].isInline());
+    assert (records[0].get<dns::RDataA>()->getAddress()[3] == 1);
+    assert (records[0].get<dns::RDataAAAA>() == NULL);
+    assert (!records[1].isInline());
+    assert (static_cast<dns::RDataMX*>(records[1].getRData())->getExchange() == "mail.example.com");
+    assert (!records[2].isInline());
+    assert (records[2].getRData()->getType() == dns::RDATA_SOA);
+    assert (records[2].getName() == "example.com");
+
+    // encoded records are equal to original ones
+    char wire2[512];
+    dns::Buffer b3(wire2, sizeof(wire2));
+    for (uint i = 0; i < records.size(); i++)
+        records[i].encode(b3);
+    assert (b3.getPos() == wireSize);
+    assert (memcmp(wire, wire2, wireSize) == 0);
+
+    // record created by value
+    dns::Record r;
+    dns::RDataAAAA aaaa;
+    const dns::uchar localhost[16] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1};
+    aaaa.setAddress(localhost);
+    r.setRData(aaaa);
+    assert (r.getType() == dns::RDATA_AAAA);
+    assert (r.get<dns::RDataAAAA>()->getAddress()[15] == 1);
+    assert (r.getRData()->getType() == dns::RDATA_AAAA);
+    assert (r.isInline());
+
+    // rdata of other types is kept on heap, given either by pointer or by value
+    dns::RDataNAPTR *naptr = new dns::RDataNAPTR();
+    naptr->setServices("E2U+sip");
+    r.setRData(naptr);
+    assert (r.getType() == dns::RDATA_NAPTR);
+    assert (!r.isInline());
+    assert (r.getRData() == naptr);
+    dns::RDataMX mxValue;
+    mxValue.setExchange("mx.example.com");
+    r.setRData(mxValue);
+    assert (r.getType() == dns::RDATA_MX);
+    assert (!r.isInline());
+    assert (static_cast<dns::RDataMX*>(r.getRData())->getExchange() == "mx.example.com");
+    assert (dns::Record::isInlineType<dns::RDataA>());
+    assert (!dns::Record::isInlineType<dns::RDataSRV>());
+}
+
+// check moving of messages (records allocated from arena are handed over)
+void testMessageMove()
+{
+    dns::Message m;
+    m.addQuery(dns::QuerySectionPtr(new dns::QuerySection("www.example.com")));
+    m.addAnswer(createRecordA("www.example.com", "10.0.0.1"));
+    std::vector<char> wire;
+    m.encode(wire);
+
+    dns::Arena arena;
+    dns::Message decoded;
+    decoded.setArena(&arena);
+    decoded.decode(wire.data(), wire.size());
+    const dns::ResourceRecord *rr = decoded.getAnswers()[0].get();
+
+    // records are not copied
+    dns::Message moved(std::move(decoded));
+    assert (decoded.getAnCount() == 0);
+    assert (decoded.getArena() == NULL);
+    assert (moved.getArena() == &arena);
+    assert (moved.getAnswers()[0].get() == rr);
+
+    // previous content of target is released
+    m = std::move(moved);
+    assert (m.getAnCount() == 1);
+    assert (m.getAnswers()[0].get() == rr);
+    assert (m.getQueries()[0]->getName() == "www.example.com");
+
+    dns::Message other;
+    other.swap(m);
+    assert (m.getAnCount() == 0);
+    assert (other.getAnswers()[0].get() == rr);
+}
+
+// check recycling of records by reset
+void testMessageReset()
+{
+    dns::Message m;
+    m.setId(5);
+    m.setQr(dns::Message::typeResponse);
+    m.addQuery(dns::QuerySectionPtr(new dns::QuerySection("www.example.com")));
+    m.addAnswer(createRecordA("www.example.com", "10.0.0.1"));
+    m.addAnswer(createRecordA("www.example.com", "10.0.0.2"));
+    m.setEdns(true);
+    std::vector<char> wire1;
+    m.encode(wire1);
+
+    dns::Message other;
+    other.addQuery(dns::QuerySectionPtr(new dns::QuerySection("mail.example.com")));
+    other.addAnswer(createRecordA("mail.example.com", "10.0.0.3"));
+    std::vector<char> wire2;
+    other.encode(wire2);
+
+    // header and sections are cleared
+    m.reset();
+    assert (m.getId() == 0);
+    assert (m.getQr() == dns::Message::typeQuery);
+    assert (!m.hasEdns());
+    assert (m.getQdCount() == 0 && m.getAnCount() == 0);
+
+    dns::Message d;
+    d.decode(wire1.data(), wire1.size());
+    const dns::QuerySection *qs = d.getQueries()[0].get();
+    const dns::ResourceRecord *rr0 = d.getAnswers()[0].get();
+    const dns::ResourceRecord *rr1 = d.getAnswers()[1].get();
+    const dns::RData *rdata0 = rr0->getRData();
+    const dns::RData *rdata1 = rr1->getRData();
+
+    // objects of the first message are reused
+    d.decode(wire2.data(), wire2.size());
+    assert (!d.hasEdns());
+    assert (d.getQueries()[0].get() == qs);
+    assert (d.getQueries()[0]->getName() == "mail.example.com");
+    assert (d.getAnCount() == 1);
+    const dns::ResourceRecord *rr = d.getAnswers()[0].get();
+    assert (rr == rr0 || rr == rr1);
+    assert (rr->getRData() == rdata0 || rr->getRData() == rdata1);
+    assert (static_cast<dns::RDataA*>(rr->getRData())->getAddress()[3] == 3);
+
+    d.decode(wire1.data(), wire1.size());
+    assert (d.hasEdns());
+    assert (d.getAnCount() == 2);
+    assert (static_cast<dns::RDataA*>(d.getAnswers()[1]->getRData())->getAddress()[3] == 2);
+    std::vector<char> wire3;
+    d.encode(wire3);
+    assert (wire3 == wire1);
+
+    // rdata with own memory is decoded again to the same object (memory is reused if it is sufficient)
+    const char wks[] = "\x0a\x00\x00\x01\x06\xff\x01\x80";
+    const uint wksSizes[] = { 8, 6, 8 };
+    dns::RDataWKS wksData;
+    dns::RDataNULL nullData;
+    for (uint i = 0; i < sizeof(wksSizes) / sizeof(wksSizes[0]); i++)
+    {
+        char in[8];
+        memcpy(in, wks, sizeof(in));
+        dns::Buffer wksBuffer(in, wksSizes[i]);
+        wksData.decode(wksBuffer, wksSizes[i]);
+        assert (wksData.getBitmapSize() == wksSizes[i] - 5);
+        dns::Buffer nullBuffer(in, wksSizes[i]);
+        nullData.decode(nullBuffer, wksSizes[i]);
+
+        char out[16];
+        dns::Buffer outBuffer(out, sizeof(out));
+        wksData.encode(outBuffer);
+        nullData.encode(outBuffer);
+        assert (outBuffer.getPos() == 2 * wksSizes[i]);
+        assert (memcmp(out, wks, wksSizes[i]) == 0);
+        assert (memcmp(out + wksSizes[i], wks, wksSizes[i]) == 0);
+    }
+
+    // length of WKS is checked before anything is read
+    char shortWks[] = "\x0a\x00\x00\x01";
+    dns::Buffer shortBuffer(shortWks, sizeof(shortWks) - 1);
+    shortBuffer.setThrowing(false);
+    wksData.decode(shortBuffer, 4);
+    assert (shortBuffer.getError() == dns::DECODE_BAD_RDATA_LENGTH);
+    assert (shortBuffer.getPos() == 0);
+    assert (wksData.getBitmapSize() == 0);
+}
+
+// answer query by policy, response is decoded to message
+// @return false if no rule matches query
+bool answerByPolicy(const dns::Policy &policy, const char* name, const uint qtype, dns::Message &response)
+{
+    dns::Message query;
+    dns::QuerySection *qs = new dns::QuerySection(name);
+    qs->setType(qtype);
+    query.addQuery(dns::QuerySectionPtr(qs));
+    char buffer[512];
+    uint size;
+    query.encode(buffer, sizeof(buffer), size);
+
+    dns::QueryPeek peek;
+    assert (dns::peekQuestion(buffer, size, peek) == dns::DECODE_OK);
+    const dns::ResponseTemplate *tpl = policy.find(peek);
+    if (tpl == NULL)
+        return false;
+    size = tpl->render(buffer, sizeof(buffer), peek);
+    assert (size > 0);
+    response.decode(buffer, size);
+    assert (response.getQueries()[0]->getName() == name);
+
+    return true;
+}
+
+void testPolicy()
+{
+    std::istringstream rules(
+        "# exact names\n"
+        "www.example.com   A      300 A 192.0.2.1\n"
+        "WWW.example.com   A      300 A 192.0.2.2   ; second record of RRset\n"
+        "www.example.com   MX     60 MX 10 mail.example.com\n"
+        "\n"
+        "*.example.com     NAPTR  60 NAPTR 100 10 \"u\" \"E2U+sip\" \"!^.*$!sip:info@example.com!\" .\n"
+        "*.example.com     *      NXDOMAIN\n"
+        "*.sub.example.com TXT    10 TXT \"a b\" c\n"
+        "gone.example.com  *      NODATA\n"
+        "esc.example.com   TXT    10 TXT \"a\\059b\" c\\;d   ; escaped comment characters\n"
+        "esc.example.com   HINFO  10 HINFO \"PC\" Linux\n"
+        "esc.example.com   TYPE999 10 TYPE999 \\# 2 abcd\n"
+        "*                 *      REFUSED\n");
+    dns::Policy policy;
+    policy.load(rules, "rules");
+    assert (policy.getRuleCount() == 10);
+
+    dns::Message m;
+    assert (answerByPolicy(policy, "www.Example.COM", dns::RDATA_A, m));
+    assert (m.getRCode() == dns::RCODE_NOERROR);
+    assert (m.getAA() == 1);
+    assert (m.getAnCount() == 2);
+    assert (m.getAnswers()[1]->getName() == "www.example.com");
+    assert (m.getAnswers()[1]->getRData()->asString().find("192.0.2.2") != std::string::npos);
+
+    assert (answerByPolicy(policy, "www.example.com", dns::RDATA_MX, m));
+    assert (m.getAnCount() == 1);
+    assert (m.getAnswers()[0]->getType() == dns::RDATA_MX);
+
+    // exact name without rule for query type
+    assert (answerByPolicy(policy, "www.example.com", dns::RDATA_TXT, m));
+    assert (m.getRCode() == dns::RCODE_NOERROR);
+    assert (m.getAnCount() == 0);
+
+    // wildcard, rule for query type takes precedence over rule for all types
+    assert (answerByPolicy(policy, "1.2.3.example.com", dns::RDATA_NAPTR, m));
+    assert (m.getAnCount() == 1);
+    assert (m.getAnswers()[0]->getName() == "1.2.3.example.com");
+    assert (answerByPolicy(policy, "foo.example.com", dns::RDATA_A, m));
+    assert (m.getRCode() == dns::RCODE_NXDOMAIN);
+    assert (m.getAnCount() == 0);
+
+    // wildcard doesn't match its suffix, the longest suffix wins
+    assert (answerByPolicy(policy, "example.com", dns::RDATA_NAPTR, m));
+    assert (m.getRCode() == dns::RCODE_REFUSED);
+    assert (answerByPolicy(policy, "x.sub.example.com", dns::RDATA_TXT, m));
+    assert (m.getAnCount() == 1);
+    assert (answerByPolicy(policy, "x.sub.example.com", dns::RDATA_NAPTR, m));
+    assert (m.getRCode() == dns::RCODE_NOERROR);
+    assert (m.getAnCount() == 0);
+
+    // RDATA in master file syntax
+    assert (answerByPolicy(policy, "esc.example.com", dns::RDATA_TXT, m));
+    assert (m.getAnCount() == 1);
+    assert (m.getAnswers()[0]->getRData()->asString() == "<<TXT items=2 'a;b' 'c;d'");
+    assert (answerByPolicy(policy, "esc.example.com", dns::RDATA_HINFO, m));
+    assert (m.getAnCount() == 1);
+    assert (m.getAnswers()[0]->getType() == dns::RDATA_HINFO);
+    assert (answerByPolicy(policy, "esc.example.com", 999, m));
+    assert (m.getAnCount() == 1);
+    assert (m.getAnswers()[0]->getType() == 999);
+
+    assert (answerByPolicy(policy, "gone.example.com", dns::RDATA_A, m));
+    assert (m.getRCode() == dns::RCODE_NOERROR);
+    assert (m.getAnCount() == 0);
+
+    assert (answerByPolicy(policy, "other.org", dns::RDATA_A, m));
+    assert (m.getRCode() == dns::RCODE_REFUSED);
+    assert (m.getAA() == 0);
+
+    // no catch-all rule, unmatched queries are refused
+    std::istringstream exact("www.example.com A 300 A 192.0.2.1\n");
+    policy.load(exact, "exact");
+    assert (policy.getRuleCount() == 1);
+    assert (answerByPolicy(policy, "other.org", dns::RDATA_A, m));
+    assert (m.getRCode() == dns::RCODE_REFUSED);
+    assert (m.getAA() == 0);
+    assert (m.getAnCount() == 0);
+    assert (answerByPolicy(policy, "example.com", dns::RDATA_A, m));
+    assert (m.getRCode() == dns::RCODE_REFUSED);
+
+    // queries are dropped only by explicit rule
+    std::istringstream drop(
+        "www.example.com A 300 A 192.0.2.1\n"
+        "www.example.com TXT DROP\n"
+        "*               *   DROP\n");
+    policy.load(drop, "drop");
+    assert (policy.getRuleCount() == 3);
+    assert (answerByPolicy(policy, "www.example.com", dns::RDATA_A, m));
+    assert (m.getAnCount() == 1);
+    assert (!answerByPolicy(policy, "www.example.com", dns::RDATA_TXT, m));
+    assert (!answerByPolicy(policy, "other.org", dns::RDATA_A, m));
+
+    std::istringstream exactAgain("www.example.com A 300 A 192.0.2.1\n");
+    policy.load(exactAgain, "exact");
+
+    // invalid rules are reported with line number, previous rules are kept
+    const char* invalid[] = {
+        "www.example.com A\n",
+        "\nwww.example.com A 300 A 192.0.2\n",
+        "www.example.com A 300 BOGUS x\n",
+        "www.example.com A NXDOMAIN\nwww.example.com A REFUSED\n",
+        "www.example.com A DROP now\n",
+        "www.example.com TXT 300 TXT \"unterminated\n"
+    };
+    for (uint i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+    {
+        std::istringstream input(invalid[i]);
+        bool thrown = false;
+        try
+        {
+            policy.load(input, "bad");
+        }
+        catch (dns::Exception &e)
+        {
+            thrown = std::string(e.what()).compare(0, 4, "bad:") == 0;
+        }
+        assert (thrown);
+    }
+    assert (policy.getRuleCount() == 1);
+}
+
+void testLabelTree()
+{
+    dns::LabelTree<uint> tree;
+    assert (tree.getSize() == 1);
+    assert (tree.getLabelsSize() == 1);
+
+    uint com = tree.addChild(0, "\003COM");
+    uint example = tree.addChild(com, "\007Example");
+    assert (tree.addChild(0, "\003com") == com);
+    assert (tree.findChild(com, "\007EXAMPLE") == example);
+    assert (tree.findChild(0, "\007example") == 0);
+    assert (tree.findChild(example, "\003com") == 0);
+    assert (tree.getParent(example) == com);
+    assert (std::string(tree.getLabel(example), 8) == "\007example");
+    // labels are stored one after another in order of nodes
+    assert (tree.getLabelsSize() == 1 + 4 + 8);
+    assert (tree.getLabel(example) == tree.getLabels() + 5);
+
+    // table of children grows, the same label is distinguished by parent
+    const uint count = 1000;
+    for (uint i = 0; i < count; i++)
+    {
+        char label[8];
+        label[0] = snprintf(label + 1, sizeof(label) - 1, "n%u", i);
+        tree[tree.addChild(i % 2 ? com : example, label)] = i;
+        tree[tree.addChild(0, label)] = i + count;
+    }
+    assert (tree.getSize() == 3 + 2 * count);
+    for (uint i = 0; i < count; i++)
+    {
+        char label[8];
+        label[0] = snprintf(label + 1, sizeof(label) - 1, "N%u", i);
+        assert (tree[tree.findChild(i % 2 ? com : example, label)] == i);
+        assert (tree.findChild(i % 2 ? example : com, label) == 0);
+        assert (tree[tree.findChild(0, label)] == i + count);
+    }
+
+    tree.clear();
+    assert (tree.getSize() == 1);
+    assert (tree.findChild(0, "\003com") == 0);
+}
+
+// add A record to zone
+void addZoneA(dns::Zone &zone, const char* owner, const char* addr)
+{
+    dns::RDataA rdata;
+    rdata.setAddress(addr);
+    zone.add(owner, 300, rdata);
+}
+
+// add record with name in rdata to zone
+void addZoneName(dns::Zone &zone, const char* owner, dns::RDataWithName *rdata, const char* name)
+{
+    rdata->setName(name);
+    zone.add(owner, 300, *rdata);
+    delete rdata;
+}
+
+void testZone()
+{
+    dns::Zone zone("example.com");
+    dns::RDataSOA soa;
+    soa.setMName("ns.example.com");
+    soa.setRName("hostmaster.example.com");
+    soa.setSerial(2024010101);
+    zone.add("example.com", 3600, soa);
+    addZoneName(zone, "example.com", new dns::RDataNS(), "ns.example.com");
+    dns::RDataMX mx;
+    mx.setPreference(10);
+    mx.setExchange("mail.example.com");
+    zone.add("Example.COM", 300, mx);
+    addZoneA(zone, "www.example.com", "10.0.0.1");
+    addZoneA(zone, "www.example.com", "10.0.0.2");
+    addZoneName(zone, "alias.example.com", new dns::RDataCNAME(), "www.example.com");
+    addZoneA(zone, "*.wild.example.com", "10.0.0.9");
+    addZoneName(zone, "sub.example.com", new dns::RDataNS(), "ns1.sub.example.com");
+    addZoneA(zone, "ns1.sub.example.com", "10.0.1.1");
+    dns::RDataTXT txt;
+    txt.addTxt("deep");
+    zone.add("a.b.example.com", 60, txt);
+
+    // origin, www, alias, wild, *.wild, sub, ns1.sub, b, a.b
+    assert (zone.getNodeCount() == 9);
+    assert (zone.find("www.example.com", dns::RDATA_A)->getCount() == 2);
+    assert (zone.find("www.example.com", dns::RDATA_MX) == NULL);
+    assert (zone.find("www.example.org", dns::RDATA_A) == NULL);
+    assert (zone.find("com", dns::RDATA_A) == NULL);
+
+    bool thrown = false;
+    try
+    {
+        addZoneA(zone, "www.example.org", "10.0.0.3");
+    }
+    catch (dns::Exception &e)
+    {
+        thrown = true;
+    }
+    assert (thrown);
+
+    dns::ZoneLookup lookup;
+    assert (zone.lookup(dns::DomainName("WWW.example.com"), dns::RDATA_A, lookup) == dns::ZONE_ANSWER);
+    assert (lookup.rrset->getCount() == 2);
+    assert (lookup.ownerOffset == 0);
+    assert (!lookup.wildcard);
+    assert (lookup.originOffset == 4);
+    assert (lookup.soa == zone.find("example.com", dns::RDATA_SOA));
+
+    assert (zone.lookup(dns::DomainName("www.example.com"), dns::RDATA_TXT, lookup) == dns::ZONE_NODATA);
+    assert (lookup.rrset == NULL);
+    assert (zone.lookup(dns::DomainName("alias.example.com"), dns::RDATA_A, lookup) == dns::ZONE_CNAME);
+    assert (lookup.rrset->getType() == dns::RDATA_CNAME);
+    assert (zone.lookup(dns::DomainName("alias.example.com"), dns::RDATA_CNAME, lookup) == dns::ZONE_ANSWER);
+
+    // empty non-terminal
+    assert (zone.lookup(dns::DomainName("b.example.com"), dns::RDATA_A, lookup) == dns::ZONE_NODATA);
+    assert (zone.lookup(dns::DomainName("c.b.example.com"), dns::RDATA_A, lookup) == dns::ZONE_NXDOMAIN);
+    assert (lookup.encloserOffset == 2);
+
+    // wildcard
+    assert (zone.lookup(dns::DomainName("x.y.wild.example.com"), dns::RDATA_A, lookup) == dns::ZONE_ANSWER);
+    assert (lookup.wildcard);
+    assert (lookup.ownerOffset == 0);
+    assert (lookup.encloserOffset == 4);
+    assert (zone.lookup(dns::DomainName("x.wild.example.com"), dns::RDATA_MX, lookup) == dns::ZONE_NODATA);
+    assert (lookup.wildcard);
+    assert (zone.lookup(dns::DomainName("wild.example.com"), dns::RDATA_A, lookup) == dns::ZONE_NODATA);
+    assert (!lookup.wildcard);
+
+    // delegation (names at and below zone cut)
+    assert (zone.lookup(dns::DomainName("host.ns1.sub.example.com"), dns::RDATA_A, lookup) == dns::ZONE_DELEGATION);
+    assert (lookup.rrset->getType() == dns::RDATA_NS);
+    assert (lookup.ownerOffset == 9);
+    assert (zone.lookup(dns::DomainName("sub.example.com"), dns::RDATA_A, lookup) == dns::ZONE_DELEGATION);
+    assert (lookup.ownerOffset == 0);
+    assert (zone.lookup(dns::DomainName("example.com"), dns::RDATA_NS, lookup) == dns::ZONE_ANSWER);
+
+    assert (zone.lookup(dns::DomainName("nothing.example.com"), dns::RDATA_A, lookup) == dns::ZONE_NXDOMAIN);
+    assert (lookup.encloserOffset == 8);
+    assert (lookup.soa != NULL);
+    assert (zone.lookup(dns::DomainName("example.org"), dns::RDATA_A, lookup) == dns::ZONE_NOT_AUTH);
+    assert (zone.lookup(dns::DomainName("com"), dns::RDATA_A, lookup) == dns::ZONE_NOT_AUTH);
+
+    // RRsets are spliced into response, SOA contains link to its MNAME
+    dns::Message query;
+    dns::QuerySection *qs = new dns::QuerySection("nothing.example.com");
+    qs->setType(dns::RDATA_MX);
+    query.addQuery(dns::QuerySectionPtr(qs));
+    char buffer[512];
+    uint size;
+    query.encode(buffer, sizeof(buffer), size);
+
+    dns::ResponseBuilder builder(buffer, sizeof(buffer));
+    assert (builder.start(size) == dns::DECODE_OK);
+    assert (zone.lookup(builder.getQuery().qname, builder.getQuery().qtype, lookup) == dns::ZONE_NXDOMAIN);
+    builder.setAA(1);
+    builder.setRCode(dns::RCODE_NXDOMAIN);
+    assert (builder.addRRset(dns::SECTION_AUTHORITY, *lookup.soa, 12 + lookup.originOffset));
+    assert (builder.addRRset(dns::SECTION_ADDITIONAL, *zone.find("example.com", dns::RDATA_MX), 12 + lookup.originOffset));
+    assert (builder.addRRset(dns::SECTION_ADDITIONAL, *zone.find("www.example.com", dns::RDATA_A), 12));
+    size = builder.finish();
+
+    dns::Message m;
+    m.decode(buffer, size);
+    assert (m.getRCode() == dns::RCODE_NXDOMAIN);
+    assert (m.getNsCount() == 1);
+    assert (m.getAuthorities()[0]->getName() == "example.com");
+    dns::RDataSOA *soaData = static_cast<dns::RDataSOA*>(m.getAuthorities()[0]->getRData());
+    assert (soaData->getMName() == "ns.example.com");
+    assert (soaData->getRName() == "hostmaster.example.com");
+    assert (m.getArCount() == 3);
+    assert (static_cast<dns::RDataMX*>(m.getAdditional()[0]->getRData())->getExchange() == "mail.example.com");
+    assert (m.getAdditional()[1]->getName() == "nothing.example.com");
+    assert (m.getAdditional()[2]->getTtl() == 300);
+
+    // RRset doesn't fit
+    query.encode(buffer, sizeof(buffer), size);
+    assert (builder.start(size) == dns::DECODE_OK);
+    builder.setMaxSize(12 + builder.getQuery().qnameSize + 4 + 10);
+    assert (!builder.addRRset(dns::SECTION_ANSWER, *zone.find("www.example.com", dns::RDATA_A), 12));
+    size = builder.finish();
+    m.decode(buffer, size);
+    assert (m.getTC() == 1);
+    assert (m.getAnCount() == 0);
+
+    // RRset is limited to size of message, records added before overflow are kept
+    dns::RRset big(dns::RDATA_A);
+    dns::RDataA a;
+    a.setAddress("10.0.0.1");
+    thrown = false;
+    while (!thrown)
+    {
+        try
+        {
+            big.add(300, a);
+        }
+        catch (dns::Exception &e)
+        {
+            thrown = true;
+        }
+    }
+    assert (big.getCount() == dns::RRset::MAX_SIZE / 16);
+    assert (big.getSize() == big.getCount() * 16);
+    const char* last = big.getData() + big.getSize() - 16;
+    assert (last[0] == static_cast<char>(0xc0) && last[11] == 4 && last[12] == 10 && last[15] == 1);
+    thrown = false;
+    try
+    {
+        big.add(300, "\x0a\x00\x00\x02", 4);
+    }
+    catch (dns::Exception &e)
+    {
+        thrown = true;
+    }
+    assert (thrown);
+    assert (big.getCount() == dns::RRset::MAX_SIZE / 16);
+
+    std::vector<char> bigMessage(12);
+    dns::Buffer bigBuffer(bigMessage, 0x10000);
+    bigBuffer.setPos(12);
+    assert (big.write(bigBuffer, 12));
+    assert (bigBuffer.getPos() == 12 + big.getSize());
+}
+
+// write records of master file as answer section of message
+void masterToMessage(const dns::MasterFile &file, std::vector<char> &wire)
+{
+    wire.assign(12, 0);
+    uint count = 0;
+    file.forEach([&](const dns::MasterRecord &rr) {
+        const char* end = rr.rdata + rr.rdataSize;
+        wire.insert(wire.end(), rr.owner, end);
+        count++;
+    });
+    wire[6] = count >> 8;
+    wire[7] = count & 0xFF;
+}
+
+// expect that parsing of master file fails at line
+void assertMasterError(const char* text, const uint line)
+{
+    dns::MasterFile file("example.com");
+    bool thrown = false;
+    try
+    {
+        file.parse(text, strlen(text), "bad.zone");
+    }
+    catch (dns::Exception &e)
+    {
+        std::ostringstream prefix;
+        prefix << "bad.zone:" << line << ": ";
+        thrown = std::string(e.what()).compare(0, prefix.str().size(), prefix.str()) == 0;
+    }
+    assert (thrown);
+}
+
+void testMasterFile()
+{
+    const char* text =
+        "$ORIGIN example.com.\n"
+        "$TTL 1h\n"
+        "@ IN SOA ns hostmaster (  ; multi-line SOA\n"
+        "        2024010101 ; serial\n"
+        "        3h 15m 1w 1d )\n"
+        "        NS ns\n"
+        "        NS ns.other.org.\n"
+        "        MX 10 mail\n"
+        "ns 300 IN A 192.0.2.1\n"
+        "www IN 60 AAAA 2001:db8::1\n"
+        "\n"
+        "; comment line\n"
+        "alias CNAME www\n"
+        "txt TXT \"a \\\"quoted\\\" text\" plain \\065\\066C\n"
+        "host HINFO \"PC 386\" Linux\n"
+        "box MINFO admin errors\n"
+        "mb MB www\n"
+        "md MD www\n"
+        "mf MF www\n"
+        "mg MG www\n"
+        "mr MR www\n"
+        "1 PTR host\n"
+        "_sip._udp SRV 10 60 5060 sip\n"
+        "enum NAPTR 100 10 \"u\" \"E2U+sip\" \"!^.*$!sip:info@example.com!\" .\n"
+        "wks WKS 192.0.2.2 tcp 25 80\n"
+        "null NULL \\# 3 0a0B0c\n"
+        "generic TYPE999 \\# 4 ( 0102\n"
+        "  0304 )\n"
+        "esc\\.aped CLASS1 A 192.0.2.3\n"
+        "$ORIGIN sub\n"
+        "deep A 192.0.2.4\n";
+
+    dns::MasterFile file("example.com");
+    file.parse(text, strlen(text));
+    assert (file.getRecordCount() == 23);
+
+    std::vector<char> wire;
+    masterToMessage(file, wire);
+    dns::Message m;
+    m.decode(wire.data(), wire.size());
+    const dns::RecordList &rrs = m.getAnswers();
+    assert (rrs.size() == 23);
+
+    dns::RDataSOA *soa = static_cast<dns::RDataSOA*>(rrs[0]->getRData());
+    assert (rrs[0]->getName() == "example.com");
+    assert (rrs[0]->getTtl() == 3600);
+    assert (soa->getMName() == "ns.example.com");
+    assert (soa->getRName() == "hostmaster.example.com");
+    assert (soa->getSerial() == 2024010101);
+    assert (soa->getRefresh() == 3 * 3600);
+    assert (soa->getExpire() == 7 * 86400);
+    assert (soa->getMinimum() == 86400);
+    assert (rrs[1]->getName() == "example.com");
+    assert (static_cast<dns::RDataNS*>(rrs[2]->getRData())->getName() == "ns.other.org");
+    assert (static_cast<dns::RDataMX*>(rrs[3]->getRData())->getExchange() == "mail.example.com");
+    assert (rrs[4]->getTtl() == 300);
+    assert (rrs[4]->getRData()->asString().find("192.0.2.1") != std::string::npos);
+    assert (rrs[5]->getType() == dns::RDATA_AAAA);
+    assert (rrs[5]->getTtl() == 60);
+    assert (static_cast<dns::RDataCNAME*>(rrs[6]->getRData())->getName() == "www.example.com");
+    assert (rrs[7]->getRData()->asString() == "<<TXT items=3 'a \"quoted\" text' 'plain' 'ABC'");
+    assert (static_cast<dns::RDataHINFO*>(rrs[8]->getRData())->getCpu() == "PC 386");
+    assert (static_cast<dns::RDataMINFO*>(rrs[9]->getRData())->getMailBx() == "errors.example.com");
+    for (uint i = 10; i < 15; i++)
+        assert (static_cast<dns::RDataWithName*>(rrs[i]->getRData())->getName() == "www.example.com");
+    assert (rrs[15]->getName() == "1.example.com");
+    dns::RDataSRV *srv = static_cast<dns::RDataSRV*>(rrs[16]->getRData());
+    assert (rrs[16]->getName() == "_sip._udp.example.com");
+    assert (srv->getPort() == 5060);
+    assert (srv->getTarget() == "sip.example.com");
+    dns::RDataNAPTR *naptr = static_cast<dns::RDataNAPTR*>(rrs[17]->getRData());
+    assert (naptr->getServices() == "E2U+sip");
+    assert (naptr->getRegExp() == "!^.*$!sip:info@example.com!");
+    assert (naptr->getReplacement().isRoot());
+    assert (rrs[18]->getType() == dns::RDATA_WKS);
+    assert (rrs[19]->getType() == dns::RDATA_NULL);
+    assert (rrs[20]->getType() == 999);
+    assert (rrs[21]->getName().getLabelCount() == 3);
+    assert (rrs[21]->getName().getWire()[0] == 8);
+    assert (rrs[22]->getName() == "deep.sub.example.com");
+
+    // records are counted by chunks of file
+    file.forEach([&](const dns::MasterRecord &rr) {
+        if (rr.type == dns::RDATA_WKS)
+        {
+            assert (rr.rdataSize == 4 + 1 + 11);
+            assert (rr.rdata[4] == 6);
+            assert (static_cast<dns::uchar>(rr.rdata[5 + 3]) == 0x40);
+            assert (static_cast<dns::uchar>(rr.rdata[5 + 10]) == 0x80);
+        }
+        if (rr.type == 999)
+            assert (rr.rdataSize == 4 && rr.rdata[3] == 4);
+    });
+
+    // many small chunks parsed by several threads, records without TTL take
+    // TTL of the last record of previous chunk
+    std::ostringstream big;
+    big << "first 100 A 10.0.0.0\n";
+    for (uint i = 1; i < 1000; i++)
+    {
+        big << "h" << i << " A 10.0." << i / 256 << "." << i % 256 << "\n";
+        big << "  TXT ( \"record\n" << i << "\" )\n";
+        if (i == 500)
+            big << "$TTL 50\n$ORIGIN half\n";
+    }
+    std::string bigText = big.str();
+    dns::MasterFile chunked("example.com");
+    chunked.setThreads(4);
+    chunked.setChunkSize(256);
+    chunked.parse(bigText.data(), bigText.size());
+    assert (chunked.getRecordCount() == 1 + 2 * 999);
+    uint n = 0;
+    chunked.forEach([&](const dns::MasterRecord &rr) {
+        uint i = (n + 1) / 2;
+        if (rr.type == dns::RDATA_A)
+        {
+            assert (static_cast<dns::uchar>(rr.rdata[2]) == i / 256);
+            assert (static_cast<dns::uchar>(rr.rdata[3]) == i % 256);
+        }
+        assert (rr.ttl == (i <= 500 ? 100u : 50u));
+        dns::DomainName owner;
+        owner.fromWire(rr.owner);
+        assert (owner.getLabelCount() == (i <= 500 ? 3u : 4u));
+        n++;
+    });
+    assert (n == 1 + 2 * 999);
+
+    // included file with own origin, origin of including file is kept
+    const char* includeName = "/tmp/dnslib-unittests-include.zone";
+    FILE *include = fopen(includeName, "w");
+    assert (include != NULL);
+    fputs("inc A 192.0.2.10\n$ORIGIN other\nx A 192.0.2.11\n", include);
+    fclose(include);
+    std::string withInclude = std::string("$TTL 10\na A 192.0.2.9\n$INCLUDE ") + includeName + " sub\nb A 192.0.2.12\n";
+    dns::MasterFile included("example.com");
+    included.parse(withInclude.data(), withInclude.size());
+    std::vector<std::string> owners;
+    included.forEach([&](const dns::MasterRecord &rr) {
+        dns::DomainName owner;
+        owner.fromWire(rr.owner);
+        owners.push_back(owner.toString());
+    });
+    assert (owners.size() == 4);
+    assert (owners[1] == "inc.sub.example.com");
+    assert (owners[2] == "x.other.sub.example.com");
+    assert (owners[3] == "b.example.com");
+    remove(includeName);
+
+    // records of master file are loaded to zone
+    dns::Zone zone("example.com");
+    file.forEach([&](const dns::MasterRecord &rr) {
+        dns::DomainName owner;
+        owner.fromWire(rr.owner);
+        zone.add(owner, rr.type, rr.ttl, rr.rdata, rr.rdataSize);
+    });
+    dns::ZoneLookup lookup;
+    assert (zone.lookup(dns::DomainName("enum.example.com"), dns::RDATA_NAPTR, lookup) == dns::ZONE_ANSWER);
+    assert (lookup.rrset->getCount() == 1);
+    assert (zone.lookup(dns::DomainName("example.com"), dns::RDATA_NS, lookup) == dns::ZONE_ANSWER);
+    assert (lookup.rrset->getCount() == 2);
+
+    assertMasterError("a A 192.0.2.1\n", 1);
+    assertMasterError("$TTL 1\n\na BOGUS x\n", 3);
+    assertMasterError("$TTL 1\na A 192.0.2\n", 2);
+    assertMasterError("$TTL 1\na A 192.0.2.1 extra\n", 2);
+    assertMasterError("$TTL 1\na SOA ( ns host 1 2 3 4 5\n", 2);
+    assertMasterError("$TTL 1\n  A 192.0.2.1\n", 2);
+    assertMasterError("$TTL 1\na CH A 192.0.2.1\n", 2);
+    assertMasterError("$TTL 1\na TXT \"unterminated\n", 2);
+    assertMasterError("$TTL 1\n$GENERATE 1-2 a A 192.0.2.$\n", 2);
+    assertMasterError("$TTL 1\na NULL 1234\n", 2);
+    assertMasterError("$TTL 1\na TYPE999 \\# 2 01\n", 2);
+}
+
+// write file with given content
+void writeFile(const char* fileName, const std::string &content)
+{
+    FILE *f = fopen(fileName, "wb");
+    assert (f != NULL);
+    assert (fwrite(content.data(), 1, content.size(), f) == content.size());
+    fclose(f);
+}
+
+// expect that snapshot file with given content is rejected
+void assertSnapshotError(const char* fileName, const std::string &content, const char* reason)
+{
+    writeFile(fileName, content);
+    dns::ZoneSnapshot snapshot;
+    bool thrown = false;
+    try
+    {
+        snapshot.open(fileName, true);
+    }
+    catch (dns::Exception &e)
+    {
+        thrown = std::string(e.what()).find(reason) != std::string::npos;
+    }
+    assert (thrown);
+    assert (!snapshot.isOpen());
+}
+
+// open damaged snapshot lazily, lookups must stay inside of file
+// @return result of lookup of name and type
+dns::eZoneResult lookupDamagedSnapshot(const char* fileName, const std::string &content, const char* name, const uint type)
+{
+    writeFile(fileName, content);
+    dns::ZoneSnapshot snapshot;
+    snapshot.open(fileName);
+
+    const char* names[] = { "example.com", "www.example.com", "alias.example.com", "a.b.example.com", "x.wild.example.com",
+        "host.sub.example.com" };
+    const uint types[] = { dns::RDATA_A, dns::RDATA_MX, dns::RDATA_SOA, dns::RDATA_TXT };
+    for (uint i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+    {
+        for (uint j = 0; j < sizeof(types) / sizeof(types[0]); j++)
+        {
+            dns::SnapshotLookup lookup;
+            snapshot.lookup(dns::DomainName(names[i]), types[j], lookup);
+            char buffer[512];
+            dns::Buffer buff(buffer, sizeof(buffer));
+            buff.setPos(12);
+            lookup.rrset.write(buff, 12);
+            lookup.soa.write(buff, 12);
+        }
+    }
+
+    dns::SnapshotLookup lookup;
+    return snapshot.lookup(dns::DomainName(name), type, lookup);
+}
+
+void testZoneSnapshot()
+{
+    dns::Zone zone("Example.com");
+    dns::RDataSOA soa;
+    soa.setMName("ns.example.com");
+    soa.setRName("hostmaster.example.com");
+    soa.setSerial(2024010101);
+    zone.add("example.com", 3600, soa);
+    addZoneName(zone, "example.com", new dns::RDataNS(), "ns.example.com");
+    dns::RDataMX mx;
+    mx.setPreference(10);
+    mx.setExchange("mail.example.com");
+    zone.add("example.com", 300, mx);
+    addZoneA(zone, "www.example.com", "10.0.0.1");
+    addZoneA(zone, "WWW.example.com", "10.0.0.2");
+    addZoneName(zone, "alias.example.com", new dns::RDataCNAME(), "www.example.com");
+    addZoneA(zone, "*.wild.example.com", "10.0.0.9");
+    addZoneName(zone, "sub.example.com", new dns::RDataNS(), "ns1.sub.example.com");
+    addZoneA(zone, "ns1.sub.example.com", "10.0.1.1");
+    dns::RDataTXT txt;
+    txt.addTxt("deep");
+    zone.add("a.b.example.com", 60, txt);
+
+    const char* fileName = "/tmp/dnslib-unittests.snap";
+    dns::ZoneSnapshot::write(zone, fileName);
+
+    dns::ZoneSnapshot snapshot;
+    assert (!snapshot.isOpen());
+    snapshot.open(fileName);
+    assert (snapshot.isOpen());
+    assert (snapshot.getOrigin() == "example.com");
+    assert (snapshot.getClass() == dns::CLASS_IN);
+    assert (snapshot.getNodeCount() == zone.getNodeCount());
+    assert (snapshot.getRRsetCount() == 9);
+    assert (snapshot.find("www.EXAMPLE.com", dns::RDATA_A).getCount() == 2);
+    assert (snapshot.find("www.example.com", dns::RDATA_MX).isEmpty());
+    assert (snapshot.find("www.example.org", dns::RDATA_A).isEmpty());
+    assert (snapshot.find("com", dns::RDATA_A).isEmpty());
+
+    // lookups give the same answers as zone
+    const char* names[] = { "example.com", "www.example.com", "WWW.Example.COM", "alias.example.com", "b.example.com",
+        "c.b.example.com", "a.b.example.com", "x.y.wild.example.com", "wild.example.com", "sub.example.com",
+        "host.ns1.sub.example.com", "nothing.example.com", "example.org", "com", "." };
+    const uint types[] = { dns::RDATA_A, dns::RDATA_MX, dns::RDATA_NS, dns::RDATA_SOA, dns::RDATA_TXT, dns::RDATA_CNAME };
+    for (uint i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+    {
+        for (uint j = 0; j < sizeof(types) / sizeof(types[0]); j++)
+        {
+            dns::DomainName qname(names[i]);
+            dns::ZoneLookup expected;
+            dns::SnapshotLookup lookup;
+            assert (snapshot.lookup(qname, types[j], lookup) == zone.lookup(qname, types[j], expected));
+            assert (lookup.ownerOffset == expected.ownerOffset);
+            assert (lookup.wildcard == expected.wildcard);
+            assert (lookup.encloserOffset == expected.encloserOffset);
+            assert (lookup.originOffset == expected.originOffset);
+            assert (lookup.soa.isEmpty() == (expected.soa == NULL));
+            assert (lookup.rrset.isEmpty() == (expected.rrset == NULL));
+            if (expected.rrset != NULL)
+            {
+                assert (lookup.rrset.getType() == expected.rrset->getType());
+                assert (lookup.rrset.getCount() == expected.rrset->getCount());
+                assert (lookup.rrset.getSize() == expected.rrset->getSize());
+                assert (memcmp(lookup.rrset.getData(), expected.rrset->getData(), expected.rrset->getSize()) == 0);
+            }
+        }
+    }
+
+    // RRsets are written from mapped file, links inside of SOA and MX are moved
+    dns::Message query;
+    dns::QuerySection *qs = new dns::QuerySection("nothing.example.com");
+    qs->setType(dns::RDATA_MX);
+    query.addQuery(dns::QuerySectionPtr(qs));
+    char buffer[512];
+    uint size;
+    query.encode(buffer, sizeof(buffer), size);
+
+    dns::ResponseBuilder builder(buffer, sizeof(buffer));
+    assert (builder.start(size) == dns::DECODE_OK);
+    dns::SnapshotLookup lookup;
+    assert (snapshot.lookup(builder.getQuery().qname, builder.getQuery().qtype, lookup) == dns::ZONE_NXDOMAIN);
+    builder.setRCode(dns::RCODE_NXDOMAIN);
+    assert (builder.addRRset(dns::SECTION_AUTHORITY, lookup.soa, 12 + lookup.originOffset));
+    assert (builder.addRRset(dns::SECTION_ADDITIONAL, snapshot.find("example.com", dns::RDATA_MX), 12 + lookup.originOffset));
+    size = builder.finish();
+
+    dns::Message m;
+    m.decode(buffer, size);
+    assert (m.getNsCount() == 1);
+    assert (static_cast<dns::RDataSOA*>(m.getAuthorities()[0]->getRData())->getMName() == "ns.example.com");
+    assert (static_cast<dns::RDataSOA*>(m.getAuthorities()[0]->getRData())->getSerial() == 2024010101);
+    assert (static_cast<dns::RDataMX*>(m.getAdditional()[0]->getRData())->getExchange() == "mail.example.com");
+
+    // snapshot of empty zone
+    const char* emptyFileName = "/tmp/dnslib-unittests-empty.snap";
+    dns::ZoneSnapshot::write(dns::Zone("example.org"), emptyFileName);
+    dns::ZoneSnapshot empty;
+    empty.open(emptyFileName);
+    assert (empty.getNodeCount() == 1);
+    assert (empty.lookup(dns::DomainName("www.example.org"), dns::RDATA_A, lookup) == dns::ZONE_NXDOMAIN);
+    assert (lookup.soa.isEmpty());
+    assert (empty.lookup(dns::DomainName("www.example.com"), dns::RDATA_A, lookup) == dns::ZONE_NOT_AUTH);
+    empty.close();
+    remove(emptyFileName);
+
+    // stale or damaged files are rejected
+    std::string content;
+    FILE *f = fopen(fileName, "rb");
+    assert (f != NULL);
+    char block[1024];
+    size_t n;
+    while ((n = fread(block, 1, sizeof(block), f)) > 0)
+        content.append(block, n);
+    fclose(f);
+    snapshot.close();
+    assert (!snapshot.isOpen());
+    assert (snapshot.lookup(dns::DomainName("www.example.com"), dns::RDATA_A, lookup) == dns::ZONE_NOT_AUTH);
+
+    const char* badFileName = "/tmp/dnslib-unittests-bad.snap";
+    std::string stale = content;
+    stale[8]++;
+    assertSnapshotError(badFileName, stale, "version");
+    std::string damaged = content;
+    damaged[damaged.size() - 20] ^= 1;
+    assertSnapshotError(badFileName, damaged, "checksum");
+    // damaged data is not detected without verification (it is the default)
+    snapshot.open(badFileName);
+    assert (snapshot.isOpen());
+    snapshot.close();
+
+    // offsets and indexes taken from damaged tables are checked by lookups
+    auto get64 = [&content](const size_t offset) { uint64_t value; memcpy(&value, content.data() + offset, sizeof(value)); return value; };
+    auto get32 = [&content](const size_t offset) { uint32_t value; memcpy(&value, content.data() + offset, sizeof(value)); return value; };
+    auto set64 = [](std::string &data, const size_t offset, const uint64_t value) { memcpy(&data[offset], &value, sizeof(value)); };
+    auto set32 = [](std::string &data, const size_t offset, const uint32_t value) { memcpy(&data[offset], &value, sizeof(value)); };
+    const uint nodeCount = get32(36);
+    const uint rrsetCount = get32(40);
+    const uint slotCount = get32(44) + 1;
+    const size_t nodes = get64(56);
+    const size_t slots = get64(64);
+    const size_t rrsets = get64(72);
+    assert (lookupDamagedSnapshot(badFileName, content, "www.example.com", dns::RDATA_A) == dns::ZONE_ANSWER);
+
+    damaged = content;
+    for (uint i = 1; i < nodeCount; i++)
+        set64(damaged, nodes + i * 24, 0xFFFFFFFFFFFF0000ULL);
+    assert (lookupDamagedSnapshot(badFileName, damaged, "www.example.com", dns::RDATA_A) == dns::ZONE_NXDOMAIN);
+
+    damaged = content;
+    for (uint i = 0; i < nodeCount; i++)
+        set32(damaged, nodes + i * 24 + 12, 0xFFFFFFF0);
+    assert (lookupDamagedSnapshot(badFileName, damaged, "www.example.com", dns::RDATA_A) == dns::ZONE_NODATA);
+
+    damaged = content;
+    for (uint i = 0; i < slotCount; i++)
+        if (get32(slots + i * 4) != 0)
+            set32(damaged, slots + i * 4, 0xFFFFFFFF);
+    assert (lookupDamagedSnapshot(badFileName, damaged, "www.example.com", dns::RDATA_A) == dns::ZONE_NXDOMAIN);
+
+    // table of children without free slot
+    damaged = content;
+    for (uint i = 0; i < slotCount; i++)
+        set32(damaged, slots + i * 4, 1);
+    lookupDamagedSnapshot(badFileName, damaged, "www.example.com", dns::RDATA_A);
+
+    damaged = content;
+    for (uint i = 0; i < rrsetCount; i++)
+        set64(damaged, rrsets + i * 32, 0xFFFFFFFFFFFF0000ULL);
+    assert (lookupDamagedSnapshot(badFileName, damaged, "www.example.com", dns::RDATA_A) == dns::ZONE_NODATA);
+
+    damaged = content;
+    for (uint i = 0; i < rrsetCount; i++)
+        set32(damaged, rrsets + i * 32 + 16, 0x40000000);
+    assert (lookupDamagedSnapshot(badFileName, damaged, "www.example.com", dns::RDATA_A) == dns::ZONE_NODATA);
+
+    // positions of records and links are checked when RRset is written
+    const char data[] = { 0, 0, 0, 1, 0, 1, 0, 0, 0, 60, 0, 4, 10, 0, 0, 1 };
+    const uint badRecords[] = { 16 };
+    const uint records[] = { 0 };
+    const uint badLinks[] = { 15 };
+    const uint links[] = { 12 };
+    char buffer2[64];
+    dns::Buffer buff(buffer2, sizeof(buffer2));
+    buff.setPos(12);
+    assert (!dns::RRsetView(dns::RDATA_A, dns::CLASS_IN, 1, data, sizeof(data), badRecords, NULL, 0, 0).write(buff, 12));
+    assert (!dns::RRsetView(dns::RDATA_A, dns::CLASS_IN, 1, data, sizeof(data), records, badLinks, 1, 0xFFFF).write(buff, 12));
+    assert (!dns::RRsetView(dns::RDATA_A, dns::CLASS_IN, 1, data, sizeof(data), records, links, 1, 0).write(buff, 12));
+    assert (buff.getPos() == 12);
+    assert (dns::RRsetView(dns::RDATA_A, dns::CLASS_IN, 1, data, sizeof(data), records, NULL, 0, 0).write(buff, 12));
+    assert (buff.getPos() == 12 + sizeof(data));
+    assertSnapshotError(badFileName, content.substr(0, content.size() - 8), "truncated");
+    assertSnapshotError(badFileName, content.substr(0, 40), "not zone snapshot");
+    assertSnapshotError(badFileName, "$ORIGIN example.com.\n", "not zone snapshot");
+    remove(badFileName);
+    assertSnapshotError(badFileName, "", "not zone snapshot");
+    remove(badFileName);
+
+    bool thrown = false;
+    try
+    {
+        snapshot.open(badFileName);
+    }
+    catch (dns::Exception &e)
+    {
+        thrown = true;
+    }
+    assert (thrown);
+
+    remove(fileName);
+}
+
 void testCreatePacket()
 {
     dns::Message answer;
@@ -401,7 +2403,7 @@ void testCreatePacket()
     rdata->setReplacement("_sip._tcp.icscf.brn56.iit.ims");
     rr->setRData(rdata);
 
-    answer.addAnswer(rr);
+    answer.addAnswer(dns::ResourceRecordPtr(rr));
 
     dns::uint mesgSize;
     char mesg[2000];
@@ -415,6 +2417,9 @@ int main()
     cout << "testBuffer" << endl;
     testBuffer();
 
+    cout << "testBufferDomainNameLinks" << endl;
+    testBufferDomainNameLinks();
+
     cout << "testBufferEmptyDomainName" << endl;
     testBufferEmptyDomainName();
 
@@ -424,6 +2429,12 @@ int main()
     cout << "testBufferDotEndedDomainName" << endl;
     testBufferDotEndedDomainName();
 
+    cout << "testBufferNameCompression" << endl;
+    testBufferNameCompression();
+
+    cout << "testDomainName" << endl;
+    testDomainName();
+
     cout << "testBufferCharacterString" << endl;
     testBufferCharacterString();
 
@@ -469,6 +2480,62 @@ int main()
     cout << "testPacketInvalid" << endl;
     testPacketInvalid();
 
+    cout << "testMessageView" << endl;
+    testMessageView();
+
+    cout << "testArena" << endl;
+    testArena();
+
+    cout << "testDecodeErrors" << endl;
+    testDecodeErrors();
+
+    cout << "testEncodeTruncated" << endl;
+    testEncodeTruncated();
+
+    cout << "testEdns" << endl;
+    testEdns();
+
+    cout << "testStream" << endl;
+    testStream();
+
+    cout << "testPeekQuestion" << endl;
+    testPeekQuestion();
+
+    cout << "testResponseBuilder" << endl;
+    testResponseBuilder();
+
+    cout << "testResponseTemplate" << endl;
+    testResponseTemplate();
+
+    cout << "testRDataRegistry" << endl;
+    testRDataRegistry();
+
+    cout << "testLazyRData" << endl;
+    testLazyRData();
+
+    cout << "testRecord" << endl;
+    testRecord();
+
+    cout << "testMessageMove" << endl;
+    testMessageMove();
+
+    cout << "testMessageReset" << endl;
+    testMessageReset();
+
+    cout << "testLabelTree" << endl;
+    testLabelTree();
+        cout << "testPolicy" << endl;
+    testPolicy();
+
+    cout << "testZone" << endl;
+    testZone();
+
+    cout << "testMasterFile" << endl;
+    testMasterFile();
+
+    cout << "testZoneSnapshot" << endl;
+    testZoneSnapshot();
+
     cout << "testCreatePacket" << endl;
     testCreatePacket();
 
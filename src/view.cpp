@@ -0,0 +1,277 @@
+/**
+ * DNS Message View
+ *
+ * Copyright (c) 2014 Michal Nezerka
+ * All rights reserved.
+ *
+ * Developed by: Michal Nezerka
+ *               https://github.com/mnezerka/
+ *               mailto:michal.nezerka@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal with the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimers.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimers in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Michal Nezerka, nor the names of its contributors
+ *    may be used to endorse or promote products derived from this Software
+ *    without specific prior written permission. 
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ */
+
+#include "view.h"
+#include "buffer.h"
+#include "exception.h"
+
+using namespace dns;
+using namespace std;
+
+/////////// QuestionView ///////////
+
+uint QuestionView::getType() const
+{
+    const uchar* p = reinterpret_cast<const uchar*>(mBuffer + mOffset + mNameSize);
+    return (p[0] << 8) + p[1];
+}
+
+uint QuestionView::getClass() const
+{
+    const uchar* p = reinterpret_cast<const uchar*>(mBuffer + mOffset + mNameSize + 2);
+    return (p[0] << 8) + p[1];
+}
+
+/////////// RecordView ///////////
+
+uint RecordView::getType() const
+{
+    const uchar* p = reinterpret_cast<const uchar*>(mBuffer + mOffset + mNameSize);
+    return (p[0] << 8) + p[1];
+}
+
+uint RecordView::getClass() const
+{
+    const uchar* p = reinterpret_cast<const uchar*>(mBuffer + mOffset + mNameSize + 2);
+    return (p[0] << 8) + p[1];
+}
+
+uint RecordView::getTtl() const
+{
+    const uchar* p = reinterpret_cast<const uchar*>(mBuffer + mOffset + mNameSize + 4);
+    return (p[0] << 24) + (p[1] << 16) + (p[2] << 8) + p[3];
+}
+
+uint RecordView::getRDataLength() const
+{
+    const uchar* p = reinterpret_cast<const uchar*>(mBuffer + mOffset + mNameSize + 8);
+    return (p[0] << 8) + p[1];
+}
+
+/////////// MessageView ///////////
+
+void MessageView::parse(const char* buffer, const uint size)
+{
+    uint errorOffset;
+    eDecodeError error = parse(buffer, size, errorOffset);
+    if (error != DECODE_OK)
+        throw(Exception(getDecodeErrorText(error)));
+}
+
+eDecodeError MessageView::parse(const char* buffer, const uint size, uint &errorOffset)
+{
+    mBuffer = buffer;
+    mSize = size;
+    errorOffset = 0;
+
+    if (mSize < HDR_OFFSET)
+        return DECODE_TRUNCATED;
+
+    // questions
+    char name[MAX_DOMAIN_LEN];
+    uint offset = HDR_OFFSET;
+    for (uint i = getQdCount(); i > 0; i--)
+    {
+        uint nameSize;
+        eDecodeError error = readName(offset, name, nameSize, errorOffset);
+        if (error != DECODE_OK)
+            return error;
+        offset += nameSize + 4;
+        if (offset > mSize)
+        {
+            errorOffset = mSize;
+            return DECODE_TRUNCATED;
+        }
+    }
+
+    // resource records
+    mAnOffset = offset;
+    eDecodeError error = checkRecords(offset, getAnCount(), errorOffset);
+    mNsOffset = offset;
+    if (error == DECODE_OK)
+        error = checkRecords(offset, getNsCount(), errorOffset);
+    mArOffset = offset;
+    if (error == DECODE_OK)
+        error = checkRecords(offset, getArCount(), errorOffset);
+    if (error != DECODE_OK)
+        return error;
+
+    // check that buffer is consumed
+    if (offset != mSize)
+    {
+        errorOffset = offset;
+        return DECODE_TRAILING_BYTES;
+    }
+
+    return DECODE_OK;
+}
+
+eDecodeError MessageView::checkRecords(uint &offset, const uint count, uint &errorOffset) const
+{
+    char name[MAX_DOMAIN_LEN];
+    for (uint i = count; i > 0; i--)
+    {
+        uint nameSize;
+        eDecodeError error = readName(offset, name, nameSize, errorOffset);
+        if (error != DECODE_OK)
+            return error;
+        offset += nameSize;
+        // type, class, ttl and rdlength fields
+        if (offset + 10 <= mSize)
+            offset += 10 + get16bits(offset + 8);
+        else
+            offset += 10;
+        if (offset > mSize)
+        {
+            errorOffset = mSize;
+            return DECODE_TRUNCATED;
+        }
+    }
+
+    return DECODE_OK;
+}
+
+uint MessageView::get16bits(const uint offset) const
+{
+    const uchar* p = reinterpret_cast<const uchar*>(mBuffer + offset);
+    return (p[0] << 8) + p[1];
+}
+
+eDecodeError MessageView::readName(const uint offset, char* name, uint &size, uint &errorOffset) const
+{
+    if (offset >= mSize)
+    {
+        errorOffset = offset;
+        return DECODE_TRUNCATED;
+    }
+
+    Buffer buffer(const_cast<char*>(mBuffer), mSize);
+    buffer.setThrowing(false);
+    buffer.setPos(offset);
+    buffer.getDnsDomainName(name, true);
+
+    size = buffer.getPos() - offset;
+    errorOffset = buffer.getErrorPos();
+
+    return buffer.getError();
+}
+
+uint MessageView::getName(const uint offset, char* name) const
+{
+    char wireName[MAX_DOMAIN_LEN];
+    uint nameSize, errorOffset;
+    eDecodeError error = readName(offset, wireName, nameSize, errorOffset);
+    if (error != DECODE_OK)
+        throw(Exception(getDecodeErrorText(error)));
+
+    return Buffer::domainNameToText(wireName, name);
+}
+
+std::string MessageView::getName(const uint offset) const
+{
+    char name[MAX_DOMAIN_LEN + 1];
+    uint nameLen = getName(offset, name);
+
+    return std::string(name, nameLen);
+}
+
+uint MessageView::skipName(const char* buffer, uint offset)
+{
+    uint start = offset;
+    while (true)
+    {
+        uint ctrlCode = static_cast<uchar>(buffer[offset]);
+        if (ctrlCode == 0)
+            return offset + 1 - start;
+        if (ctrlCode >> 6 == 3)
+            return offset + 2 - start;
+        offset += ctrlCode + 1;
+    }
+}
+
+/////////// peekQuestion ///////////
+
+eDecodeError dns::peekQuestion(const char* buffer, const uint size, QueryPeek &query)
+{
+    const uchar* p = reinterpret_cast<const uchar*>(buffer);
+
+    // header and at least root name, QTYPE and QCLASS
+    if (size < 17)
+        return DECODE_TRUNCATED;
+
+    query.id = (p[0] << 8) + p[1];
+    query.flags = (p[2] << 8) + p[3];
+    // QR must be 0 and OPCODE must be 0 (standard query), QDCOUNT must be 1
+    if ((query.flags & 0xF800) != 0 || p[4] != 0 || p[5] != 1)
+        return DECODE_NOT_QUERY;
+
+    // walk labels of QNAME and compute its hash (FNV-1a like DomainName::hash)
+    size_t h = 2166136261u;
+    uint pos = 12;
+    while (true)
+    {
+        uint labelLen = p[pos];
+        if (labelLen > MAX_LABEL_LEN)
+            return labelLen >> 6 == 3 ? DECODE_BAD_POINTER : DECODE_LABEL_TOO_LONG;
+        if (pos + labelLen + 5 > size)
+            return DECODE_TRUNCATED;
+        h = (h ^ labelLen) * 16777619u;
+        if (labelLen == 0)
+            break;
+        // one octet is reserved for terminating zero
+        if (pos - 12 + labelLen + 2 > MAX_DOMAIN_LEN)
+            return DECODE_NAME_TOO_LONG;
+        for (uint i = 1; i <= labelLen; i++)
+            h = (h ^ lowerChar(p[pos + i])) * 16777619u;
+        pos += labelLen + 1;
+    }
+    pos++;
+
+    query.qname = buffer + 12;
+    query.qnameSize = pos - 12;
+    query.qnameHash = h;
+    query.qtype = (p[pos] << 8) + p[pos + 1];
+    query.qclass = (p[pos + 2] << 8) + p[pos + 3];
+
+    // OPT record (root owner, TYPE 41) as the only record behind question
+    pos += 4;
+    query.edns = p[6] == 0 && p[7] == 0 && p[8] == 0 && p[9] == 0 && p[10] == 0 && p[11] == 1
+        && pos + 11 <= size && p[pos] == 0 && p[pos + 1] == 0 && p[pos + 2] == RDATA_OPT;
+    query.udpPayloadSize = query.edns ? (p[pos + 3] << 8) + p[pos + 4] : 0;
+
+    return DECODE_OK;
+}
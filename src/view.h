@@ -0,0 +1,295 @@
+/**
+ * DNS Message View
+ *
+ * Copyright (c) 2014 Michal Nezerka
+ * All rights reserved.
+ *
+ * Developed by: Michal Nezerka
+ *               https://github.com/mnezerka/
+ *               mailto:michal.nezerka@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal with the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimers.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimers in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Michal Nezerka, nor the names of its contributors
+ *    may be used to endorse or promote products derived from this Software
+ *    without specific prior written permission. 
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ */
+
+#ifndef _DNS_VIEW_H
+#define	_DNS_VIEW_H
+
+#include <string>
+#include <cstddef>
+
+#include "dns.h"
+
+namespace dns {
+
+/**
+ * Question section entry inside of message wire data
+ */
+class QuestionView
+{
+    public:
+        QuestionView(const char* buffer, const uint offset, const uint nameSize) : mBuffer(buffer), mOffset(offset), mNameSize(nameSize) { }
+
+        // offset of QNAME in message
+        uint getNameOffset() const { return mOffset; }
+
+        // number of octets QNAME occupies in message (compressed size)
+        uint getNameSize() const { return mNameSize; }
+
+        uint getType() const;
+        uint getClass() const;
+
+        // size of the whole entry in message
+        uint getSize() const { return mNameSize + 4; }
+
+    private:
+        const char* mBuffer;
+        uint mOffset;
+        uint mNameSize;
+};
+
+/**
+ * Resource record inside of message wire data
+ */
+class RecordView
+{
+    public:
+        RecordView(const char* buffer, const uint offset, const uint nameSize) : mBuffer(buffer), mOffset(offset), mNameSize(nameSize) { }
+
+        // offset of NAME in message
+        uint getNameOffset() const { return mOffset; }
+
+        // number of octets NAME occupies in message (compressed size)
+        uint getNameSize() const { return mNameSize; }
+
+        uint getType() const;
+        uint getClass() const;
+        uint getTtl() const;
+
+        // offset of RDATA in message
+        uint getRDataOffset() const { return mOffset + mNameSize + 10; }
+
+        // RDATA bytes (points to original message, RDATA could contain compression links)
+        const char* getRData() const { return mBuffer + getRDataOffset(); }
+        uint getRDataLength() const;
+
+        // size of the whole record in message
+        uint getSize() const { return mNameSize + 10 + getRDataLength(); }
+
+    private:
+        const char* mBuffer;
+        uint mOffset;
+        uint mNameSize;
+};
+
+/**
+ * Forward iterator over entries of one message section
+ *
+ * Entries are located on the fly by skipping names, no memory is allocated.
+ */
+template<class T>
+class SectionIterator
+{
+    public:
+        SectionIterator(const char* buffer, const uint offset, const uint count) : mBuffer(buffer), mOffset(offset), mCount(count) { }
+
+        T operator*() const;
+        SectionIterator& operator++();
+        bool operator==(const SectionIterator& other) const { return mCount == other.mCount; }
+        bool operator!=(const SectionIterator& other) const { return mCount != other.mCount; }
+
+    private:
+        const char* mBuffer;
+        // offset of current entry
+        uint mOffset;
+        // number of entries left (including current one)
+        uint mCount;
+};
+
+/**
+ * Range of entries of one message section (usable in range based for loops)
+ */
+template<class T>
+class SectionRange
+{
+    public:
+        SectionRange(const char* buffer, const uint offset, const uint count) : mBuffer(buffer), mOffset(offset), mCount(count) { }
+
+        SectionIterator<T> begin() const { return SectionIterator<T>(mBuffer, mOffset, mCount); }
+        SectionIterator<T> end() const { return SectionIterator<T>(mBuffer, 0, 0); }
+
+        uint size() const { return mCount; }
+        bool empty() const { return mCount == 0; }
+
+    private:
+        const char* mBuffer;
+        uint mOffset;
+        uint mCount;
+};
+
+typedef SectionRange<QuestionView> QuestionRange;
+typedef SectionRange<RecordView> RecordRange;
+
+/**
+ * Read-only view of DNS message in wire format
+ *
+ * The view doesn't copy the message. Message is checked once by parse()
+ * (bounds of all names, compression links and records) and then header fields,
+ * questions and resource records are read directly from the original buffer.
+ * Domain names are expanded (compression links are followed) only when
+ * requested. Buffer must stay valid as long as the view is used.
+ */
+class MessageView
+{
+    public:
+        MessageView() : mBuffer(NULL), mSize(0), mAnOffset(0), mNsOffset(0), mArOffset(0) { }
+
+        // Check message in buffer and make it accessible through the view
+        // (exception is thrown if message is malformed)
+        // @param buffer The buffer with message wire data.
+        // @param size - size of message
+        void parse(const char* buffer, const uint size);
+
+        // Check message in buffer and make it accessible through the view without throwing exceptions
+        // @param buffer The buffer with message wire data.
+        // @param size - size of message
+        // @param errorOffset - position in buffer where error was detected
+        // @return DECODE_OK or code of the first detected error
+        eDecodeError parse(const char* buffer, const uint size, uint &errorOffset);
+
+        // raw message data
+        const char* getData() const { return mBuffer; }
+        uint getSize() const { return mSize; }
+
+        uint getId() const { return get16bits(0); }
+        uint getQr() const { return (get16bits(2) >> 15) & 1; }
+        uint getOpCode() const { return (get16bits(2) >> 11) & 15; }
+        uint getAA() const { return (get16bits(2) >> 10) & 1; }
+        uint getTC() const { return (get16bits(2) >> 9) & 1; }
+        uint getRD() const { return (get16bits(2) >> 8) & 1; }
+        uint getRA() const { return (get16bits(2) >> 7) & 1; }
+        uint getRCode() const { return get16bits(2) & 15; }
+
+        uint getQdCount() const { return get16bits(4); }
+        uint getAnCount() const { return get16bits(6); }
+        uint getNsCount() const { return get16bits(8); }
+        uint getArCount() const { return get16bits(10); }
+
+        QuestionRange getQuestions() const { return QuestionRange(mBuffer, HDR_OFFSET, getQdCount()); }
+        RecordRange getAnswers() const { return RecordRange(mBuffer, mAnOffset, getAnCount()); }
+        RecordRange getAuthorities() const { return RecordRange(mBuffer, mNsOffset, getNsCount()); }
+        RecordRange getAdditional() const { return RecordRange(mBuffer, mArOffset, getArCount()); }
+
+        // Expand domain name stored at offset (compression links are followed)
+        // @param offset - offset of name in message
+        // @param name - buffer for zero terminated name in text form (at least MAX_DOMAIN_LEN + 1 bytes)
+        // @return length of name
+        uint getName(const uint offset, char* name) const;
+
+        // Expand domain name stored at offset to string
+        std::string getName(const uint offset) const;
+
+        // Get number of octets occupied by name at offset (name must be already checked)
+        static uint skipName(const char* buffer, uint offset);
+
+    private:
+        static const uint HDR_OFFSET = 12;
+
+        // message wire data
+        const char* mBuffer;
+        // size of message
+        uint mSize;
+        // offsets of sections
+        uint mAnOffset;
+        uint mNsOffset;
+        uint mArOffset;
+
+        uint get16bits(const uint offset) const;
+
+        // check and expand name at offset
+        // @param name - buffer for name in wire format (at least MAX_DOMAIN_LEN bytes)
+        // @param size - number of octets name occupies at offset
+        // @param errorOffset - position where error was detected
+        eDecodeError readName(const uint offset, char* name, uint &size, uint &errorOffset) const;
+
+        // check resource records of one section, offset is moved to next section
+        eDecodeError checkRecords(uint &offset, const uint count, uint &errorOffset) const;
+};
+
+/**
+ * Header fields and the first question of query read directly from wire data
+ * (see peekQuestion)
+ */
+struct QueryPeek
+{
+    uint id;
+    // second 16 bit word of header (QR, OPCODE, AA, TC, RD, RA, Z, RCODE)
+    uint flags;
+    // QNAME in wire format (points to original message, no compression links)
+    const char* qname;
+    // number of octets of QNAME (including terminating zero octet)
+    uint qnameSize;
+    // case-insensitive hash of QNAME (equal to DomainName::hash())
+    size_t qnameHash;
+    uint qtype;
+    uint qclass;
+    // query contains OPT record (recognized only if it is the only record behind question)
+    bool edns;
+    // UDP payload size advertised by OPT record
+    uint udpPayloadSize;
+
+    uint getRD() const { return (flags >> 8) & 1; }
+
+    // Maximal size of UDP response to query (advertised UDP payload size, at least 512 bytes)
+    uint getMaxUdpSize() const { return edns && udpPayloadSize > MAX_MSG_LEN ? udpPayloadSize : MAX_MSG_LEN; }
+};
+
+// Read ID, flags and the first question of query without decoding the whole
+// message. Only standard queries are accepted (QR is 0, OPCODE is QUERY,
+// QDCOUNT is 1, QNAME doesn't contain compression links), other records
+// of message are not checked.
+// @param buffer - message wire data
+// @param size - size of message
+// @param query - fields of query (valid only if DECODE_OK is returned)
+// @return DECODE_OK or code of detected error
+eDecodeError peekQuestion(const char* buffer, const uint size, QueryPeek &query);
+
+template<class T>
+T SectionIterator<T>::operator*() const
+{
+    return T(mBuffer, mOffset, MessageView::skipName(mBuffer, mOffset));
+}
+
+template<class T>
+SectionIterator<T>& SectionIterator<T>::operator++()
+{
+    mOffset += (**this).getSize();
+    mCount--;
+    return *this;
+}
+
+} // namespace
+#endif	/* _DNS_VIEW_H */
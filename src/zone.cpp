@@ -0,0 +1,323 @@
+/**
+ * DNS Zone
+ *
+ * Copyright (c) 2014 Michal Nezerka
+ * All rights reserved.
+ *
+ * Developed by: Michal Nezerka
+ *               https://github.com/mnezerka/
+ *               mailto:michal.nezerka@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal with the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimers.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimers in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Michal Nezerka, nor the names of its contributors
+ *    may be used to endorse or promote products derived from this Software
+ *    without specific prior written permission. 
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ */
+
+#include "zone.h"
+#include "exception.h"
+
+using namespace dns;
+using namespace std;
+
+/////////// RRsetView ///////////
+
+bool RRsetView::write(Buffer& buffer, const uint ownerOffset) const
+{
+    uint pos = buffer.getPos();
+    if (ownerOffset > 0x3FFF || (mLinkCount > 0 && pos + mMaxLinkTarget > 0x3FFF))
+        return false;
+
+    buffer.putBytes(mData, mSize);
+    if (buffer.getError() != DECODE_OK)
+        return false;
+    uint end = buffer.getPos();
+
+    // positions are checked, so records of damaged RRset (e.g. from mapped file) are never read outside of its data
+    for (uint i = 0; i < mCount; i++)
+    {
+        if (mSize < 2 || mRecords[i] > mSize - 2)
+        {
+            buffer.setPos(pos);
+            return false;
+        }
+        buffer.setPos(pos + mRecords[i]);
+        buffer.put16bits(0xc000 + ownerOffset);
+    }
+
+    // links to names inside of records are moved together with records
+    for (uint i = 0; i < mLinkCount; i++)
+    {
+        if (mSize < 2 || mLinks[i] > mSize - 2)
+        {
+            buffer.setPos(pos);
+            return false;
+        }
+        uint target = ((static_cast<uchar>(mData[mLinks[i]]) & 0x3F) << 8) + static_cast<uchar>(mData[mLinks[i] + 1]);
+        if (target > mMaxLinkTarget)
+        {
+            buffer.setPos(pos);
+            return false;
+        }
+        buffer.setPos(pos + mLinks[i]);
+        buffer.put16bits(0xc000 + pos + target);
+    }
+    buffer.setPos(end);
+
+    return true;
+}
+
+/////////// RRset ///////////
+
+void RRset::add(const uint ttl, RData& rdata)
+{
+    uint start = mData.size();
+    if (start >= MAX_SIZE)
+        throw(Exception("RRset is too large"));
+
+    vector<uint> links;
+    Buffer buff(mData, MAX_SIZE);
+    buff.setLinkLog(&links);
+    try
+    {
+        buff.setPos(start);
+        // owner link is set when RRset is written
+        buff.put16bits(0xc000);
+        buff.put16bits(mType);
+        buff.put16bits(mClass);
+        buff.put32bits(ttl);
+        buff.put16bits(0);
+        uint rdataPos = buff.getPos();
+        rdata.encode(buff);
+        uint end = buff.getPos();
+        buff.setPos(rdataPos - 2);
+        buff.put16bits(end - rdataPos);
+        buff.setPos(end);
+    }
+    catch (Exception &e)
+    {
+        mData.resize(start);
+        throw;
+    }
+    mData.resize(buff.getPos());
+
+    mRecords.push_back(start);
+    for (vector<uint>::iterator it = links.begin(); it != links.end(); ++it)
+    {
+        mLinks.push_back(*it);
+        uint target = ((static_cast<uchar>(mData[*it]) & 0x3F) << 8) + static_cast<uchar>(mData[*it + 1]);
+        if (target > mMaxLinkTarget)
+            mMaxLinkTarget = target;
+    }
+    mCount++;
+}
+
+void RRset::add(const uint ttl, const char* rdata, const uint rdataSize)
+{
+    if (rdataSize > 0xFFFF || mData.size() + 12 + rdataSize > MAX_SIZE)
+        throw(Exception("RRset is too large"));
+
+    mRecords.push_back(mData.size());
+    mData.push_back(0xc0);
+    mData.push_back(0);
+    char fields[10] = {
+        static_cast<char>(mType >> 8), static_cast<char>(mType), static_cast<char>(mClass >> 8), static_cast<char>(mClass),
+        static_cast<char>(ttl >> 24), static_cast<char>(ttl >> 16), static_cast<char>(ttl >> 8), static_cast<char>(ttl),
+        static_cast<char>(rdataSize >> 8), static_cast<char>(rdataSize)
+    };
+    mData.insert(mData.end(), fields, fields + sizeof(fields));
+    mData.insert(mData.end(), rdata, rdata + rdataSize);
+    mCount++;
+}
+
+/////////// Zone ///////////
+
+void Zone::add(const DomainName& owner, const uint ttl, RData& rdata)
+{
+    addRRset(owner, rdata.getType()).add(ttl, rdata);
+}
+
+void Zone::add(const ResourceRecord& rr)
+{
+    RData *rdata = rr.getRData();
+    if (rdata == NULL)
+        throw(Exception("Record without RDATA can't be added to zone"));
+
+    addRRset(rr.getName(), rr.getType()).add(rr.getTtl(), *rdata);
+}
+
+void Zone::add(const DomainName& owner, const uint type, const uint ttl, const char* rdata, const uint rdataSize)
+{
+    addRRset(owner, type).add(ttl, rdata, rdataSize);
+}
+
+RRset& Zone::addRRset(const DomainName& owner, const uint type)
+{
+    uint node = addNode(owner);
+    Node &n = mTree[node];
+    if (type == RDATA_NS && node != 0)
+        n.cut = true;
+
+    // new RRset is appended to the end of chain
+    uint *link = &n.firstRRset;
+    for (; *link != NO_RRSET; link = &mNextRRset[*link])
+        if (mRRsets[*link].getType() == type)
+            return mRRsets[*link];
+    *link = mRRsets.size();
+    mRRsets.push_back(RRset(type, mClass));
+    mNextRRset.push_back(NO_RRSET);
+
+    return mRRsets.back();
+}
+
+const RRset* Zone::find(const DomainName& owner, const uint type) const
+{
+    uint originLabels = mOrigin.getLabelCount();
+    if (!isInside(owner.getWire(), owner.getLabelCount(), owner.getLabelOffset(owner.getLabelCount() - originLabels)))
+        return NULL;
+
+    uint node = 0;
+    for (uint i = owner.getLabelCount() - originLabels; i-- > 0; )
+    {
+        node = mTree.findChild(node, owner.getLabel(i));
+        if (node == 0)
+            return NULL;
+    }
+
+    return findRRset(node, type);
+}
+
+eZoneResult Zone::lookup(const char* qname, const uint qtype, ZoneLookup& lookup) const
+{
+    // offsets of labels, the last one is offset of root label
+    uint labels[DomainName::MAX_LABELS + 1];
+    uint labelCount = 0;
+    uint pos = 0;
+    while (qname[pos] != 0 && labelCount < DomainName::MAX_LABELS)
+    {
+        labels[labelCount++] = pos;
+        pos += static_cast<uchar>(qname[pos]) + 1;
+    }
+    labels[labelCount] = pos;
+
+    lookup.rrset = NULL;
+    lookup.ownerOffset = 0;
+    lookup.wildcard = false;
+    lookup.encloserOffset = 0;
+    lookup.soa = NULL;
+    lookup.originOffset = 0;
+
+    uint originLabels = mOrigin.getLabelCount();
+    if (labelCount < originLabels || !isInside(qname, labelCount, labels[labelCount - originLabels]))
+        return lookup.result = ZONE_NOT_AUTH;
+    lookup.originOffset = labels[labelCount - originLabels];
+    lookup.soa = findRRset(0, RDATA_SOA);
+
+    // labels below origin are walked from the top one, the walk stops at zone
+    // cut or at the closest encloser
+    uint node = 0;
+    uint i = labelCount - originLabels;
+    while (i > 0)
+    {
+        uint child = mTree.findChild(node, qname + labels[i - 1]);
+        if (child == 0)
+            break;
+        node = child;
+        i--;
+
+        if (mTree[node].cut)
+        {
+            lookup.rrset = findRRset(node, RDATA_NS);
+            lookup.ownerOffset = labels[i];
+            lookup.encloserOffset = labels[i];
+            return lookup.result = ZONE_DELEGATION;
+        }
+    }
+    lookup.encloserOffset = labels[i];
+
+    // exact match
+    if (i == 0)
+        return answer(node, qtype, lookup);
+
+    // answer is synthesized from wildcard child of the closest encloser
+    uint wildcard = mTree.findChild(node, "\001*");
+    if (wildcard == 0)
+        return lookup.result = ZONE_NXDOMAIN;
+    lookup.wildcard = true;
+
+    return answer(wildcard, qtype, lookup);
+}
+
+eZoneResult Zone::answer(const uint node, const uint qtype, ZoneLookup& lookup) const
+{
+    lookup.ownerOffset = 0;
+    lookup.rrset = findRRset(node, qtype);
+    if (lookup.rrset != NULL)
+        return lookup.result = ZONE_ANSWER;
+
+    if (qtype != RDATA_CNAME)
+    {
+        lookup.rrset = findRRset(node, RDATA_CNAME);
+        if (lookup.rrset != NULL)
+            return lookup.result = ZONE_CNAME;
+    }
+
+    // name without RRsets is empty non-terminal, it exists as well
+    return lookup.result = ZONE_NODATA;
+}
+
+uint Zone::addNode(const DomainName& name)
+{
+    uint originLabels = mOrigin.getLabelCount();
+    if (!isInside(name.getWire(), name.getLabelCount(), name.getLabelOffset(name.getLabelCount() - originLabels)))
+        throw(Exception("Name " + name.toString() + " is outside of zone " + mOrigin.toString()));
+
+    uint node = 0;
+    for (uint i = name.getLabelCount() - originLabels; i-- > 0; )
+        node = mTree.addChild(node, name.getLabel(i));
+
+    return node;
+}
+
+bool Zone::isInside(const char* name, const uint labelCount, const uint suffixOffset) const
+{
+    if (labelCount < mOrigin.getLabelCount())
+        return false;
+
+    const char* origin = mOrigin.getWire();
+    for (uint i = 0; i < mOrigin.getWireLen(); i++)
+        if (lowerChar(name[suffixOffset + i]) != lowerChar(origin[i]))
+            return false;
+
+    return true;
+}
+
+const RRset* Zone::findRRset(const uint node, const uint type) const
+{
+    for (uint rrset = mTree[node].firstRRset; rrset != NO_RRSET; rrset = mNextRRset[rrset])
+        if (mRRsets[rrset].getType() == type)
+            return &mRRsets[rrset];
+
+    return NULL;
+}
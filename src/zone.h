@@ -0,0 +1,278 @@
+/**
+ * DNS Zone
+ *
+ * Copyright (c) 2014 Michal Nezerka
+ * All rights reserved.
+ *
+ * Developed by: Michal Nezerka
+ *               https://github.com/mnezerka/
+ *               mailto:michal.nezerka@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal with the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimers.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimers in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Michal Nezerka, nor the names of its contributors
+ *    may be used to endorse or promote products derived from this Software
+ *    without specific prior written permission. 
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ */
+
+#ifndef _DNS_ZONE_H
+#define	_DNS_ZONE_H
+
+#include <vector>
+
+#include "dns.h"
+#include "name.h"
+#include "buffer.h"
+#include "rr.h"
+#include "labeltree.h"
+
+namespace dns {
+
+/**
+ * Pre-encoded RRset referred by pointers (see RRset)
+ *
+ * View doesn't own data, it is used to write RRsets stored outside of RRset
+ * objects (e.g. in mapped ZoneSnapshot).
+ */
+class RRsetView
+{
+    public:
+        RRsetView() : mType(0), mClass(0), mCount(0), mData(NULL), mSize(0), mRecords(NULL), mLinks(NULL), mLinkCount(0), mMaxLinkTarget(0) { }
+
+        // @param records - positions of records (owner links), count items
+        // @param links - positions of links inside of RDATA, linkCount items
+        // @param maxLinkTarget - the highest offset referred by links
+        RRsetView(const uint type, const uint rrClass, const uint count, const char* data, const uint size, const uint* records, const uint* links, const uint linkCount, const uint maxLinkTarget)
+            : mType(type), mClass(rrClass), mCount(count), mData(data), mSize(size), mRecords(records), mLinks(links), mLinkCount(linkCount), mMaxLinkTarget(maxLinkTarget) { }
+
+        uint getType() const { return mType; }
+        uint getClass() const { return mClass; }
+        uint getCount() const { return mCount; }
+        const char* getData() const { return mData; }
+        uint getSize() const { return mSize; }
+        const uint* getRecords() const { return mRecords; }
+        const uint* getLinks() const { return mLinks; }
+        uint getLinkCount() const { return mLinkCount; }
+        uint getMaxLinkTarget() const { return mMaxLinkTarget; }
+
+        // view doesn't refer to any RRset
+        bool isEmpty() const { return mCount == 0; }
+
+        // Write records to buffer (see RRset::write), false is returned also if positions are outside of data
+        bool write(Buffer& buffer, const uint ownerOffset) const;
+
+    private:
+        uint mType;
+        uint mClass;
+        uint mCount;
+        const char* mData;
+        uint mSize;
+        const uint* mRecords;
+        const uint* mLinks;
+        uint mLinkCount;
+        uint mMaxLinkTarget;
+};
+
+/**
+ * Resource record set pre-encoded in wire format
+ *
+ * Records are stored as they are written to message. Owner of each record is
+ * a compression link which is pointed to the owner name when RRset is written
+ * to response. Names inside of RDATA are compressed only against names of the
+ * same record, positions of these links are kept and links are shifted when
+ * records are copied to message.
+ */
+class RRset
+{
+    public:
+        // maximal size of records (RRset must fit into message)
+        static constexpr uint MAX_SIZE = 0xFFFF;
+
+        RRset(const uint type = 0, const uint rrClass = CLASS_IN) : mType(type), mClass(rrClass), mCount(0), mMaxLinkTarget(0) { }
+
+        uint getType() const { return mType; }
+        uint getClass() const { return mClass; }
+
+        // number of records
+        uint getCount() const { return mCount; }
+
+        // encoded records
+        const char* getData() const { return mData.data(); }
+        uint getSize() const { return mData.size(); }
+
+        // Add record (exception is thrown if it can't be encoded or RRset would exceed MAX_SIZE)
+        void add(const uint ttl, RData& rdata);
+
+        // Add record with RDATA in wire format (RDATA must not contain compression links)
+        void add(const uint ttl, const char* rdata, const uint rdataSize);
+
+        // Write records to buffer
+        // @param ownerOffset - offset of owner name in message
+        // @return false if records don't fit into buffer or their links can't reach targets
+        bool write(Buffer& buffer, const uint ownerOffset) const { return getView().write(buffer, ownerOffset); }
+
+        // view of records (valid until RRset is modified)
+        RRsetView getView() const { return RRsetView(mType, mClass, mCount, mData.data(), mData.size(), mRecords.data(), mLinks.data(), mLinks.size(), mMaxLinkTarget); }
+
+    private:
+        uint mType;
+        uint mClass;
+        uint mCount;
+        std::vector<char> mData;
+        // positions of records (owner links)
+        std::vector<uint> mRecords;
+        // positions of links inside of RDATA
+        std::vector<uint> mLinks;
+        // the highest offset referred by links (relative to start of RRset)
+        uint mMaxLinkTarget;
+};
+
+// Result of zone lookup
+enum eZoneResult {
+    // RRset of query type was found
+    ZONE_ANSWER = 0,
+    // name is an alias (CNAME RRset is returned)
+    ZONE_CNAME,
+    // name exists, but it has no RRset of query type
+    ZONE_NODATA,
+    // name doesn't exist
+    ZONE_NXDOMAIN,
+    // name is at or below zone cut (NS RRset of cut is returned)
+    ZONE_DELEGATION,
+    // name is not inside of zone
+    ZONE_NOT_AUTH
+};
+
+/**
+ * Answer found in zone for query name and type
+ *
+ * Owners are suffixes of QNAME, they are given by offsets in QNAME wire format,
+ * so links to them are QNAME offset in message plus owner offset.
+ */
+struct ZoneLookup
+{
+    eZoneResult result;
+    // RRset of answer, CNAME or NS RRset of zone cut (NULL for other results)
+    const RRset* rrset;
+    // owner of rrset (QNAME for answer synthesized from wildcard)
+    uint ownerOffset;
+    // answer was synthesized from wildcard
+    bool wildcard;
+    // the closest encloser (the longest existing ancestor of QNAME)
+    uint encloserOffset;
+    // SOA RRset of zone (used in negative responses, NULL if zone has no SOA)
+    const RRset* soa;
+    // zone origin
+    uint originOffset;
+};
+
+/**
+ * Authoritative zone held in memory
+ *
+ * Names are kept in tree rooted at zone origin (see LabelTree) and RRsets of
+ * all names in one array referred from nodes of the tree, so lookup is one
+ * walk over labels of QNAME which finds exact match, the closest encloser,
+ * wildcard (RFC 4592) and zone cut on the way. RRsets are pre-encoded, answer
+ * is written to response by copying them.
+ *
+ *     Zone zone("example.com");
+ *     zone.add("www.example.com", 300, aRData);
+ *     ZoneLookup lookup;
+ *     if (zone.lookup(query.qname, query.qtype, lookup) == ZONE_ANSWER)
+ *         lookup.rrset->write(buffer, 12 + lookup.ownerOffset);
+ *
+ * RRsets returned by lookup are valid until zone is modified.
+ */
+class Zone
+{
+    friend class ZoneSnapshot;
+
+    public:
+        Zone(const DomainName& origin, const uint zoneClass = CLASS_IN) : mOrigin(origin), mClass(zoneClass) { }
+
+        const DomainName& getOrigin() const { return mOrigin; }
+
+        // Add record to RRset of its owner and type (exception is thrown if owner is outside of zone)
+        void add(const DomainName& owner, const uint ttl, RData& rdata);
+
+        // Add resource record (owner, TTL and RDATA are taken)
+        void add(const ResourceRecord& rr);
+
+        // Add record with RDATA in wire format without compression links (e.g. MasterRecord)
+        void add(const DomainName& owner, const uint type, const uint ttl, const char* rdata, const uint rdataSize);
+
+        // Find RRset by owner and type (no wildcard or delegation processing)
+        // @return RRset or NULL if it doesn't exist
+        const RRset* find(const DomainName& owner, const uint type) const;
+
+        // Look up query name and type
+        // @param qname - name in wire format without compression links (e.g. QueryPeek::qname)
+        // @param lookup - found RRsets and owners
+        eZoneResult lookup(const char* qname, const uint qtype, ZoneLookup& lookup) const;
+
+        eZoneResult lookup(const DomainName& qname, const uint qtype, ZoneLookup& lookup) const { return this->lookup(qname.getWire(), qtype, lookup); }
+
+        // number of names in zone (including empty non-terminals and origin)
+        uint getNodeCount() const { return mTree.getSize(); }
+
+    private:
+        // end of chain of RRsets
+        static constexpr uint NO_RRSET = 0xFFFFFFFF;
+
+        struct Node
+        {
+            // index of the first RRset of node in mRRsets
+            uint firstRRset;
+            // node is zone cut (it has NS RRset and it is not origin)
+            bool cut;
+
+            Node() : firstRRset(NO_RRSET), cut(false) { }
+        };
+
+        DomainName mOrigin;
+        uint mClass;
+        // node 0 is zone origin
+        LabelTree<Node> mTree;
+        // RRsets of all nodes, RRsets of one node are chained by mNextRRset
+        std::vector<RRset> mRRsets;
+        std::vector<uint> mNextRRset;
+
+        // find RRset of node by type
+        const RRset* findRRset(const uint node, const uint type) const;
+
+        // get node of name (nodes are created on the way)
+        uint addNode(const DomainName& name);
+
+        // get RRset of owner and type (it is created if it doesn't exist)
+        RRset& addRRset(const DomainName& owner, const uint type);
+
+        // check if name ends with zone origin
+        // @param suffixOffset - offset of label where origin should start
+        bool isInside(const char* name, const uint labelCount, const uint suffixOffset) const;
+
+        // find RRset of node for query type
+        eZoneResult answer(const uint node, const uint qtype, ZoneLookup& lookup) const;
+};
+
+} // namespace
+#endif	/* _DNS_ZONE_H */